@@ -28,19 +28,96 @@ uniform float ks;
 uniform float shininess;
 uniform vec4 cSpecular;
 
-uniform float lightTypes[8];
-uniform vec3 lightColors[8];
-uniform vec3 lightDirections[8];
-uniform vec3 lightPositions[8];
-uniform float lightAngles[8];
-uniform float lightPenumbras[8];
-uniform vec3 lightFunctions[8];
+// Directional scene lights, shared with the other lit programs through a uniform buffer; the
+// layout must match LightBuffer::LightBlock
+struct Light {
+    vec4 color;     // rgb, with the type in w: 0 directional, 1 point, 2 spot, -1 unused
+    vec4 position;  // xyz, with the spot angle in w
+    vec4 direction; // xyz, with the spot penumbra in w
+    vec4 function;  // Attenuation coefficients in xyz
+};
+layout(std140) uniform Lights {
+    Light lights[8];
+    vec4 sunColor;
+    vec4 sunDirection;
+};
+
+// Point and spot lights, binned into clusters by LightClusters
+uniform samplerBuffer clusterLights;  // Four texels per light, laid out like Light
+uniform usamplerBuffer clusterTable;  // Offset and count into clusterIndices per cluster
+uniform usamplerBuffer clusterIndices;
+layout(std140) uniform Clusters {
+    vec4 viewDepth;    // Dotted with a world position, gives its depth in front of the camera
+    vec4 clusterScale; // Clusters per pixel in xy; slice = log(depth) * z + w
+    ivec4 clusterGrid;
+};
 
 // Timers
 uniform int snowTimer;
 uniform int rainTimer;
 uniform int sunTimer;
 
+// The fragment's cluster, as an index into clusterTable
+int clusterIndex() {
+    float depth = dot(viewDepth, vec4(vertexWorldSpacePos, 1.0));
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * clusterScale.xy), int(floor(log(max(depth, 1e-4)) * clusterScale.z + clusterScale.w)));
+    cluster = clamp(cluster, ivec3(0), clusterGrid.xyz - 1);
+    return (cluster.z * clusterGrid.y + cluster.y) * clusterGrid.x + cluster.x;
+}
+
+// Diffuse and specular light from one light; surfaceDiffuse is the diffuse color before N.L
+vec3 shadeLight(float lightType, vec3 lightColor, vec3 lightPosition, vec3 lightDirection,
+                float lightAngle, float lightPenumbra, vec3 lightFunction, vec3 surfaceDiffuse) {
+    float att;
+    vec3 surfaceToLight;
+    float falloff = 0;
+
+    if (lightType == 0) {
+        att = 1.0;
+        surfaceToLight = normalize(-lightDirection);
+    }
+    if (lightType == 1) {
+        float distanceToLight = length(vertexWorldSpacePos - lightPosition);
+        att = min(1.0, 1.0 / (lightFunction.x + lightFunction.y * distanceToLight + lightFunction.z * distanceToLight * distanceToLight));
+        surfaceToLight = normalize(lightPosition - vertexWorldSpacePos);
+    }
+    if (lightType == 2) {
+        float distanceToLight = length(vertexWorldSpacePos - lightPosition);
+        att = min(1.0, 1.0 / (lightFunction.x + lightFunction.y * distanceToLight + lightFunction.z * distanceToLight * distanceToLight));
+        surfaceToLight = normalize(lightPosition - vertexWorldSpacePos);
+
+        vec3 l_out = normalize(vertexWorldSpacePos - lightPosition);
+        vec3 l_dir = normalize(lightDirection);
+        float xAngle = acos(clamp(dot(l_out,l_dir), 0.0f, 1.0f));
+        float innerAngle = lightAngle - lightPenumbra;
+        if (xAngle > innerAngle && xAngle < lightAngle) {
+            falloff = -2 * pow((xAngle - innerAngle) / lightPenumbra, 3) + 3 * pow((xAngle - innerAngle) / lightPenumbra, 2);
+        }
+        if (xAngle >= lightAngle) {
+            falloff = 1;
+        }
+    }
+
+    // Diffuse component
+    float NdotL = dot(normalize(vertexWorldSpaceNormal), normalize(surfaceToLight));
+    NdotL = clamp(NdotL, 0.0f, 1.0f);
+    vec3 diffuseColor = surfaceDiffuse * NdotL;
+
+    // Specular component
+    vec3 reflect = normalize(-surfaceToLight) + 2 * NdotL * normalize(vertexWorldSpaceNormal);
+    float specularDot = dot(normalize(reflect), normalize(cameraWorldSpacePos.xyz - vertexWorldSpacePos));
+    specularDot = clamp(specularDot, 0.0f, 1.0f);
+    vec3 specularColor;
+    if (shininess == 0.0) {
+        specularColor = ks * 1 * vec3(cSpecular);
+    }
+    else{
+        specularColor = ks * pow(specularDot, shininess) * vec3(cSpecular);
+    }
+
+    return att * lightColor * (diffuseColor + specularColor) * (1-falloff);
+}
+
 void main() {
     // Need to renormalize vectors here if you want them to be normalized
 
@@ -50,65 +127,28 @@ void main() {
     fragColor.y += ka * cAmbient.y;
     fragColor.z += ka * cAmbient.z;
 
-    for (int i = 0; i < 8; i++) {
-        float att;
-        vec3 surfaceToLight;
-        float falloff = 0;
-
-        if (lightTypes[i] == 0) {
-            att = 1.0;
-            surfaceToLight = normalize(-lightDirections[i]);
-        }
-        if (lightTypes[i] == 1) {
-            float distanceToLight = length(vertexWorldSpacePos - lightPositions[i]);
-            att = min(1.0, 1.0 / (lightFunctions[i].x + lightFunctions[i].y * distanceToLight + lightFunctions[i].z * distanceToLight * distanceToLight));
-            surfaceToLight = normalize(lightPositions[i] - vertexWorldSpacePos);
-        }
-        if (lightTypes[i] == 2) {
-            float distanceToLight = length(vertexWorldSpacePos - lightPositions[i]);
-            att = min(1.0, 1.0 / (lightFunctions[i].x + lightFunctions[i].y * distanceToLight + lightFunctions[i].z * distanceToLight * distanceToLight));
-            surfaceToLight = normalize(lightPositions[i] - vertexWorldSpacePos);
-
-            vec3 l_out = normalize(vertexWorldSpacePos - lightPositions[i]);
-            vec3 l_dir = normalize(lightDirections[i]);
-            float xAngle = acos(clamp(dot(l_out,l_dir), 0.0f, 1.0f));
-            float innerAngle = lightAngles[i] - lightPenumbras[i];
-            if (xAngle > innerAngle && xAngle < lightAngles[i]) {
-                falloff = -2 * pow((xAngle - innerAngle) / lightPenumbras[i], 3) + 3 * pow((xAngle - innerAngle) / lightPenumbras[i], 2);
-            }
-            if (xAngle >= lightAngles[i]) {
-                falloff = 1;
-            }
-        }
-
-        // Add diffuse component to output color
-        float NdotL = dot(normalize(vertexWorldSpaceNormal), normalize(surfaceToLight));
-        NdotL = clamp(NdotL, 0.0f, 1.0f);
-        vec3 diffuseColor = kd * NdotL * vec3(cDiffuse);
-
-        // Texture
-        if (isTexture > 0) {
-            vec4 textureColor = vec4(1);
-            textureColor = texture(textureImgMapping, textureUV);
-            fragColor.a = textureColor.a;
-            diffuseColor = (materialBlend * vec3(textureColor) + (1.0 - materialBlend) * kd * vec3(cDiffuse)) * NdotL;
-        }
+    // Texture
+    vec3 surfaceDiffuse = kd * vec3(cDiffuse);
+    if (isTexture > 0) {
+        vec4 textureColor = texture(textureImgMapping, textureUV);
+        fragColor.a = textureColor.a;
+        surfaceDiffuse = materialBlend * vec3(textureColor) + (1.0 - materialBlend) * kd * vec3(cDiffuse);
+    }
 
-        // Add specular component to output color
-        vec3 reflect = normalize(-surfaceToLight) + 2 * NdotL * normalize(vertexWorldSpaceNormal);
-        float specularDot = dot(normalize(reflect), normalize(cameraWorldSpacePos.xyz - vertexWorldSpacePos));
-        specularDot = clamp(specularDot, 0.0f, 1.0f);
-        vec3 specularColor;
-        if (shininess == 0.0) {
-            specularColor = ks * 1 * vec3(cSpecular);
-        }
-        else{
-            specularColor = ks * pow(specularDot, shininess) * vec3(cSpecular);
-        }
+    // Directional lights fill the slots from the front
+    for (int i = 0; i < 8 && lights[i].color.w >= 0; i++) {
+        fragColor.rgb += shadeLight(0.0, lights[i].color.rgb, vec3(0), lights[i].direction.xyz, 0.0, 0.0, vec3(0), surfaceDiffuse);
+    }
 
-        fragColor.x += att * lightColors[i].x * (diffuseColor.x + specularColor.x) * (1-falloff);
-        fragColor.y += att * lightColors[i].y * (diffuseColor.y + specularColor.y) * (1-falloff);
-        fragColor.z += att * lightColors[i].z * (diffuseColor.z + specularColor.z) * (1-falloff);
+    // Only the point and spot lights that reach this fragment's cluster
+    uvec2 cluster = texelFetch(clusterTable, clusterIndex()).xy;
+    for (uint i = 0u; i < cluster.y; i++) {
+        int light = int(texelFetch(clusterIndices, int(cluster.x + i)).r) * 4;
+        vec4 color = texelFetch(clusterLights, light);
+        vec4 position = texelFetch(clusterLights, light + 1);
+        vec4 direction = texelFetch(clusterLights, light + 2);
+        vec4 coefficients = texelFetch(clusterLights, light + 3);
+        fragColor.rgb += shadeLight(color.w, color.rgb, position.xyz, direction.xyz, position.w, direction.w, coefficients.xyz, surfaceDiffuse);
     }
 
     fragColor.x =1.0f; /*clamp(fragColor.x, 0.0f, 1.0f);*/
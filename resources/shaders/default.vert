@@ -6,16 +6,16 @@ layout(location = 0) in vec3 vertexObjectsSpacePos;
 layout(location = 1) in vec3 vertexObjectSpaceNormal;
 layout(location = 2) in vec2 vertexTexture;
 
+// Per-instance model matrix and the inverse transpose of its upper 3x3, for normals
+layout(location = 3) in mat4 modelMatrix;
+layout(location = 7) in mat3 normalMatrix;
+
 // Declare `out` variables for the world-space position and normal,
 //         to be passed to the fragment shader
 out vec3 vertexWorldSpacePos;
 out vec3 vertexWorldSpaceNormal;
 out vec2 textureUV;
 
-// Declare a uniform mat4 to store model matrix
-uniform mat4 modelMatrix;
-uniform mat3 normalMatrix;
-
 // Declare uniform mat4's for the view and projection matrix
 uniform mat4 viewMatrix;
 uniform mat4 projectMatrix;
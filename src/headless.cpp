@@ -0,0 +1,107 @@
+#include "headless.h"
+#include "realtime.h"
+#include "settings.h"
+#include "render/texturemanager.h"
+
+#include <QDir>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+int runHeadless(const HeadlessOptions &options) {
+    if (options.sceneFilePath.empty()) {
+        std::cerr << "Headless runs need a scene file (--scene)." << std::endl;
+        return 1;
+    }
+    if (options.frames <= 0 || options.width <= 0 || options.height <= 0) {
+        std::cerr << "Headless runs need a positive frame count and size." << std::endl;
+        return 1;
+    }
+
+    QOffscreenSurface surface;
+    surface.setFormat(QSurfaceFormat::defaultFormat());
+    surface.create();
+    QOpenGLContext context;
+    context.setFormat(QSurfaceFormat::defaultFormat());
+    if (!context.create() || !context.makeCurrent(&surface)) {
+        std::cerr << "Failed to create an offscreen OpenGL context." << std::endl;
+        if (qEnvironmentVariableIsEmpty("DISPLAY")) {
+            std::cerr << "The offscreen platform gets its context through GLX and no X display is set; "
+                         "run under Xvfb, e.g. xvfb-run -s \"-screen 0 1024x768x24\" "
+                         "final_project --headless ..." << std::endl;
+        }
+        return 1;
+    }
+
+    // The same starting values MainWindow sets up
+    settings.sceneFilePath = options.sceneFilePath;
+    settings.heightMapPath = options.heightMapPath;
+    settings.nearPlane = 0.1f;
+    settings.farPlane = 10.f;
+    settings.bumpiness = 1;
+    settings.intensity = 50;
+    settings.frameTimings = !options.timingsPath.empty();
+
+    Realtime realtime;
+    if (!realtime.initializeOffscreen(options.width, options.height)) {
+        return 1;
+    }
+    realtime.sceneChanged();
+    realtime.settingsChanged();
+    // Every frame should look the same from run to run, so textures mustn't pop in part way through
+    TextureManager::instance().waitForDecodes();
+
+    if (!options.captureFrames.empty() && !QDir().mkpath(QString::fromStdString(options.outputDir))) {
+        std::cerr << "Failed to create output directory \"" << options.outputDir << "\"" << std::endl;
+        return 1;
+    }
+
+    // Simulation steps at the widget's timer rate, whatever the frame actually took
+    const float deltaTime = 1.f / 30.f;
+    std::vector<double> frameTimes;
+    frameTimes.reserve(options.frames);
+    for (int frame = 0; frame < options.frames; frame++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        realtime.renderOffscreenFrame(float(frame) / options.frames, deltaTime);
+        // Wait for the GPU so the frame's time includes its draws
+        glFinish();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        frameTimes.push_back(elapsed.count());
+
+        if (std::find(options.captureFrames.begin(), options.captureFrames.end(), frame) != options.captureFrames.end()) {
+            char fileName[32];
+            std::snprintf(fileName, sizeof(fileName), "frame_%04d.png", frame);
+            QString filePath = QDir(QString::fromStdString(options.outputDir)).filePath(fileName);
+            if (!realtime.grabOffscreenFrame().save(filePath)) {
+                std::cerr << "Failed to save image to " << filePath.toStdString() << std::endl;
+            }
+            else {
+                std::cout << "Saved frame " << frame << " to \"" << filePath.toStdString() << "\"" << std::endl;
+            }
+        }
+    }
+
+    std::vector<double> sorted = frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (double time : sorted) {
+        sum += time;
+    }
+    double average = sum / sorted.size();
+    double p99 = sorted[size_t(std::ceil(0.99 * sorted.size())) - 1];
+    std::printf("Rendered %d frames at %dx%d: min %.3f ms, avg %.3f ms, p99 %.3f ms, max %.3f ms (%.1f fps)\n",
+                options.frames, options.width, options.height, sorted.front(), average, p99, sorted.back(), 1000.0 / average);
+
+    if (!options.timingsPath.empty()) {
+        realtime.saveFrameTimings(options.timingsPath);
+    }
+
+    realtime.finish();
+    context.doneCurrent();
+    return 0;
+}
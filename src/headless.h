@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// A scripted run without a window: the renderer draws into an offscreen surface for a fixed number
+// of frames along the benchmark camera path, saves the requested frames as PNGs and prints frame
+// time statistics. Works with any GL 4.1 driver, including Mesa's llvmpipe on machines without a GPU.
+// The context still comes from GLX, so an X display is needed; Xvfb serves on machines without one.
+struct HeadlessOptions {
+    std::string sceneFilePath;
+    std::string heightMapPath;
+    int width = 1024;
+    int height = 768;
+    int frames = 300;
+    std::vector<int> captureFrames; // Frame indices to save, as frame_NNNN.png in outputDir
+    std::string outputDir = ".";
+    std::string timingsPath; // Per-stage frame timings CSV; the profiler stays off if empty
+};
+
+// Returns the process exit code
+int runHeadless(const HeadlessOptions &options);
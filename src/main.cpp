@@ -1,11 +1,24 @@
 #include "mainwindow.h"
+#include "headless.h"
+#include "shapes/primitivebench.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QScreen>
+#include <cstring>
 #include <iostream>
 #include <QSettings>
 
 int main(int argc, char *argv[]) {
+    // Headless runs and benchmarks have no window to show, so unless told otherwise use Qt's platform that opens none.
+    // It still takes its GL context from GLX, so headless runs need an X display (Xvfb will do).
+    for (int i = 1; i < argc; i++) {
+        bool windowless = std::strcmp(argv[i], "--headless") == 0 || std::strcmp(argv[i], "--bench-primitives") == 0;
+        if (windowless && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+    }
+
     QApplication a(argc, argv);
 
     QCoreApplication::setApplicationName("Projects 5 & 6: Lights, Camera & Action!");
@@ -17,6 +30,50 @@ int main(int argc, char *argv[]) {
     fmt.setProfile(QSurfaceFormat::CoreProfile);
     QSurfaceFormat::setDefaultFormat(fmt);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption headlessOption("headless", "Render offscreen for a fixed number of frames, then exit.");
+    QCommandLineOption sceneOption("scene", "Scene file to load.", "file");
+    QCommandLineOption heightMapOption("heightmap", "Height map image for the terrain.", "file");
+    QCommandLineOption framesOption("frames", "Number of frames to render (default 300).", "count", "300");
+    QCommandLineOption sizeOption("size", "Frame size (default 1024x768).", "WxH", "1024x768");
+    QCommandLineOption captureOption("capture", "Comma-separated frame indices to save as PNG.", "frames");
+    QCommandLineOption outputOption("output", "Directory for saved frames (default current).", "dir", ".");
+    QCommandLineOption timingsOption("timings", "Write per-stage frame timings to this CSV file.", "file");
+    QCommandLineOption benchPrimitivesOption("bench-primitives", "Time the baked primitive tables against their generators, then exit.");
+    QCommandLineOption repetitionsOption("repetitions", "Repetitions per primitive for --bench-primitives (default 1000).", "count", "1000");
+    for (const QCommandLineOption &option : {headlessOption, sceneOption, heightMapOption, framesOption,
+                                             sizeOption, captureOption, outputOption, timingsOption,
+                                             benchPrimitivesOption, repetitionsOption}) {
+        parser.addOption(option);
+    }
+    parser.process(a);
+
+    if (parser.isSet(benchPrimitivesOption)) {
+        return runPrimitiveBenchmark(parser.value(repetitionsOption).toInt());
+    }
+
+    if (parser.isSet(headlessOption)) {
+        HeadlessOptions options;
+        options.sceneFilePath = parser.value(sceneOption).toStdString();
+        options.heightMapPath = parser.value(heightMapOption).toStdString();
+        options.frames = parser.value(framesOption).toInt();
+        QStringList size = parser.value(sizeOption).split('x');
+        if (size.size() == 2) {
+            options.width = size[0].toInt();
+            options.height = size[1].toInt();
+        }
+        else {
+            std::cerr << "Ignoring malformed --size, expected WxH." << std::endl;
+        }
+        for (const QString &frame : parser.value(captureOption).split(',', Qt::SkipEmptyParts)) {
+            options.captureFrames.push_back(frame.toInt());
+        }
+        options.outputDir = parser.value(outputOption).toStdString();
+        options.timingsPath = parser.value(timingsOption).toStdString();
+        return runHeadless(options);
+    }
+
     MainWindow w;
     w.initialize();
     w.resize(800, 600);
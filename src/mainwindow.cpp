@@ -75,6 +75,25 @@ void MainWindow::initialize() {
     saveImage = new QPushButton();
     saveImage->setText(QStringLiteral("Save image"));
 
+    recordFrames = new QCheckBox();
+    recordFrames->setText(QStringLiteral("Record Frames"));
+    recordFrames->setChecked(false);
+
+    watchScene = new QCheckBox();
+    watchScene->setText(QStringLiteral("Reload Scene on Change"));
+    watchScene->setChecked(false);
+
+    frustumCulling = new QCheckBox();
+    frustumCulling->setText(QStringLiteral("Frustum Culling"));
+    frustumCulling->setChecked(true);
+
+    frameTimings = new QCheckBox();
+    frameTimings->setText(QStringLiteral("Show Frame Timings"));
+    frameTimings->setChecked(false);
+
+    saveFrameTimings = new QPushButton();
+    saveFrameTimings->setText(QStringLiteral("Save Frame Timings"));
+
     // Creates the boxes containing the parameter sliders and number boxes
     QGroupBox *bumpinessLayout = new QGroupBox();
     QHBoxLayout *l1 = new QHBoxLayout();
@@ -230,6 +249,11 @@ void MainWindow::initialize() {
     vLayout->addWidget(uploadFile);
     vLayout->addWidget(uploadHeightMap);
     vLayout->addWidget(saveImage);
+    vLayout->addWidget(recordFrames);
+    vLayout->addWidget(watchScene);
+    vLayout->addWidget(frustumCulling);
+    vLayout->addWidget(frameTimings);
+    vLayout->addWidget(saveFrameTimings);
 
     //Weather
     vLayout->addWidget(weather_label);
@@ -286,6 +310,11 @@ void MainWindow::connectUIElements() {
     connectUploadFile();
     connectUploadHeightMap();
     connectSaveImage();
+    connectRecordFrames();
+    connectWatchScene();
+    connectFrustumCulling();
+    connectFrameTimings();
+    connectSaveFrameTimings();
     connectParam1();
     connectTime();
     connectSpeed();
@@ -320,6 +349,26 @@ void MainWindow::connectSaveImage() {
     connect(saveImage, &QPushButton::clicked, this, &MainWindow::onSaveImage);
 }
 
+void MainWindow::connectRecordFrames() {
+    connect(recordFrames, &QCheckBox::clicked, this, &MainWindow::onRecordFrames);
+}
+
+void MainWindow::connectWatchScene() {
+    connect(watchScene, &QCheckBox::clicked, this, &MainWindow::onWatchScene);
+}
+
+void MainWindow::connectFrustumCulling() {
+    connect(frustumCulling, &QCheckBox::clicked, this, &MainWindow::onFrustumCulling);
+}
+
+void MainWindow::connectFrameTimings() {
+    connect(frameTimings, &QCheckBox::clicked, this, &MainWindow::onFrameTimings);
+}
+
+void MainWindow::connectSaveFrameTimings() {
+    connect(saveFrameTimings, &QPushButton::clicked, this, &MainWindow::onSaveFrameTimings);
+}
+
 void MainWindow::connectSpeed() {
     connect(speedSlider, &QSlider::valueChanged, this, &MainWindow::onValChangeSpeed);
     connect(speedBox, static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged),
@@ -450,6 +499,49 @@ void MainWindow::onSaveImage() {
     realtime->saveViewportImage(filePath.toStdString());
 }
 
+void MainWindow::onRecordFrames() {
+    if (!recordFrames->isChecked()) {
+        realtime->setRecordingDirectory("");
+        return;
+    }
+    QString directory = QFileDialog::getExistingDirectory(this, tr("Record Frames To"), QDir::currentPath());
+    if (directory.isEmpty()) {
+        recordFrames->setChecked(false);
+        return;
+    }
+    realtime->setRecordingDirectory(directory.toStdString());
+}
+
+void MainWindow::onWatchScene() {
+    settings.watchScene = !settings.watchScene;
+    realtime->settingsChanged();
+}
+
+void MainWindow::onFrustumCulling() {
+    settings.frustumCulling = !settings.frustumCulling;
+    realtime->settingsChanged();
+}
+
+void MainWindow::onFrameTimings() {
+    settings.frameTimings = !settings.frameTimings;
+    realtime->settingsChanged();
+}
+
+void MainWindow::onSaveFrameTimings() {
+    if (!settings.frameTimings) {
+        std::cout << "Frame timings are off." << std::endl;
+        return;
+    }
+    QString filePath = QFileDialog::getSaveFileName(this, tr("Save Frame Timings"),
+                                                    QDir::currentPath()
+                                                        .append(QDir::separator())
+                                                        .append("frame_timings.csv"), tr("CSV Files (*.csv)"));
+    if (filePath.isNull()) {
+        return;
+    }
+    realtime->saveFrameTimings(filePath.toStdString());
+}
+
 void MainWindow::onValChangeSpeed(int newValue) {
     speedSlider->setValue(newValue);
     speedBox->setValue(newValue);
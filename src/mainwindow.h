@@ -29,6 +29,11 @@ private:
     void connectUploadFile();
     void connectUploadHeightMap();
     void connectSaveImage();
+    void connectRecordFrames();
+    void connectWatchScene();
+    void connectFrustumCulling();
+    void connectFrameTimings();
+    void connectSaveFrameTimings();
     void connectExtraCredit();
 
     //Weather
@@ -46,6 +51,11 @@ private:
     QPushButton *uploadFile;
     QPushButton *uploadHeightMap;
     QPushButton *saveImage;
+    QCheckBox *recordFrames;
+    QCheckBox *watchScene;
+    QCheckBox *frustumCulling;
+    QCheckBox *frameTimings;
+    QPushButton *saveFrameTimings;
     QSlider *speedSlider;
     QSpinBox *speedBox;
     QSlider *bumpinessSlider;
@@ -77,6 +87,11 @@ private slots:
     void onUploadFile();
     void onUploadHeightMap();
     void onSaveImage();
+    void onRecordFrames();
+    void onWatchScene();
+    void onFrustumCulling();
+    void onFrameTimings();
+    void onSaveFrameTimings();
     void onValChangeSpeed(int newValue);
     void onValChangeBumpiness(int newValue);
     void onValChangeNearSlider(int newValue);
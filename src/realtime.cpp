@@ -3,12 +3,16 @@
 #include <QCoreApplication>
 #include <QMouseEvent>
 #include <QKeyEvent>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <QDir>
 #include <QDebug>
+#include <QFontDatabase>
 #include "settings.h"
 #include <QtConcurrent>
 #include "utils/shaderloader.h"
+#include "render/texturemanager.h"
 #include "glm/gtc/constants.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtx/transform.hpp"
@@ -34,6 +38,25 @@ Realtime::Realtime(QWidget *parent)
     m_keyMap[Qt::Key_D]       = false;
     m_keyMap[Qt::Key_Control] = false;
     m_keyMap[Qt::Key_Space]   = false;
+
+    // Scene hot reload. Editors often save by writing or replacing the file in several steps,
+    // so a reload only happens once the change signals have been quiet for a moment.
+    sceneReloadTimer.setSingleShot(true);
+    sceneReloadTimer.setInterval(100);
+    connect(&sceneWatcher, &QFileSystemWatcher::fileChanged, this, [this]() {
+        sceneReloadTimer.start();
+    });
+    connect(&sceneReloadTimer, &QTimer::timeout, this, [this]() {
+        reloadScene();
+    });
+
+    // Frame timings overlay, shown while settings.frameTimings is on
+    profilerOverlay = new QLabel(this);
+    profilerOverlay->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    profilerOverlay->setStyleSheet("QLabel { background-color: rgba(0, 0, 0, 160); color: white; padding: 4px; }");
+    profilerOverlay->move(8, 8);
+    profilerOverlay->hide();
+    profilerOverlayTimer.start();
 }
 
 void Realtime::finish() {
@@ -44,9 +67,10 @@ void Realtime::finish() {
     glDeleteTextures(1, &m_fbo_texture);
     glDeleteRenderbuffers(1, &m_fbo_renderbuffer);
     glDeleteFramebuffers(1, &m_fbo);
+    glDeleteRenderbuffers(2, m_offscreen_renderbuffers);
+    glDeleteFramebuffers(1, &m_offscreen_fbo);
 
     // Delete terrain-related resources
-    glDeleteTextures(1, &m_terrain_texture);
     glDeleteBuffers(1, &m_terrain_vbo);
     glDeleteVertexArrays(1, &m_terrain_vao);
 
@@ -55,10 +79,20 @@ void Realtime::finish() {
     glDeleteBuffers(1, &m_particle_vbo);
     glDeleteVertexArrays(1, &m_particle_vao);
 
-    // Delete other textures and buffers if any
-    glDeleteTextures(1, &m_texture);
+    // Delete image textures and other buffers if any
+    TextureManager::instance().clear();
     glDeleteBuffers(1, &m_vbo);
+    glDeleteBuffers(1, &m_ebo);
+    glDeleteBuffers(1, &m_instance_vbo);
+    glDeleteBuffers(1, &m_accumulated_vbo);
+    glDeleteBuffers(1, &m_indirect_buffer);
+    snowflakeStream.destroy();
     glDeleteVertexArrays(1, &m_vao);
+    lightBuffer.destroy();
+    lightClusters.destroy();
+    frameProfiler.destroy();
+    // Saves any capture still in flight first
+    viewportCapture.destroy();
 
     // Delete shaders
     glDeleteProgram(m_shader);
@@ -78,7 +112,7 @@ void Realtime::initializeGL() {
     m_devicePixelRatio = this->devicePixelRatio();
 
     // Texture and FBO related
-    m_defaultFBO = 2;
+    m_defaultFBO = m_offscreen_fbo != 0 ? m_offscreen_fbo : 2;
     m_screen_width = size().width() * m_devicePixelRatio;
     m_screen_height = size().height() * m_devicePixelRatio;
     m_fbo_width = m_screen_width;
@@ -100,6 +134,8 @@ void Realtime::initializeGL() {
     glEnable(GL_DEPTH_TEST);
     // Tells OpenGL to only draw the front face
     glEnable(GL_CULL_FACE);
+    // Blending is switched on for the shapes and snowflakes, always with this function
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     // Tells OpenGL how big the screen is
     glViewport(0, 0, size().width() * m_devicePixelRatio, size().height() * m_devicePixelRatio);
 
@@ -107,29 +143,37 @@ void Realtime::initializeGL() {
     m_shader = ShaderLoader::createShaderProgram("resources/shaders/default.vert", "resources/shaders/default.frag");
     // Generate VBO
     glGenBuffers(1, &m_vbo);
+    // Generate index buffer. initializeGL reruns on every scene change, so buffers this class owns for
+    // the whole session are released first; deleting the initial 0 names is a no-op
+    glDeleteBuffers(1, &m_ebo);
+    glGenBuffers(1, &m_ebo);
     // Generate VAO
     glGenVertexArrays(1, &m_vao);
-
-    // Generate texture image
-    glGenTextures(1, &m_texture);
-    glActiveTexture(GL_TEXTURE3); // Use texture slot 3!!!
-    glBindTexture(GL_TEXTURE_2D, m_texture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // Generate the per-instance matrix buffer; its attributes are enabled once and re-pointed for every batch
+    glDeleteBuffers(1, &m_instance_vbo);
+    glGenBuffers(1, &m_instance_vbo);
+    glBindVertexArray(m_vao);
+    InstanceBatcher::enableInstanceAttributes();
+    glBindVertexArray(0);
+    // Multi-draw indirect needs GL 4.3 or its extensions, which a 4.1 context may still expose
+    glDeleteBuffers(1, &m_indirect_buffer);
+    glGenBuffers(1, &m_indirect_buffer);
+    indirectDraws = IndirectDrawList();
+    useIndirectDraws = IndirectDrawList::supported();
+    // Snowflake instances: a ring sized for the current intensity, and an append-only buffer
+    snowflakeStream.create(size_t(std::max(settings.intensity, 1)) * sizeof(InstanceData));
+    glDeleteBuffers(1, &m_accumulated_vbo);
+    glGenBuffers(1, &m_accumulated_vbo);
+    accumulatedInstances.clear();
+    accumulatedUploadedBytes = 0;
+    accumulatedCapacityBytes = 0;
+
+    // Textures decode on the worker pool; paintGL picks them up once they're ready
     QString currentDir = QDir::currentPath();
-
-    QString texture_filepath = currentDir + QString::fromStdString("/scenefiles/textures/snowflake.png");
-    m_image = QImage(texture_filepath);
-    if (m_image.isNull()) {
-        // Handle error: Image didn't load
-        std::cerr << "Failed to load texture image: " << texture_filepath.toStdString() << std::endl;
-        std::cerr << "Continue with no texture image." << std::endl;
-        glUniform1f(glGetUniformLocation(m_shader, "isTexture"), -1.0);
-    }
-    // Format image to fit OpenGL
-    m_image = m_image.convertToFormat(QImage::Format_RGBA8888).mirrored();
-    texture_filepath_saved = texture_filepath;
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_image.width(), m_image.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, m_image.bits());
+    m_shape_texture_path = currentDir + QString::fromStdString("/scenefiles/textures/snowflake.png");
+    m_terrain_texture_path = currentDir + QString::fromStdString("/scenefiles/textures/mountain_3.png");
+    TextureManager::instance().request(m_shape_texture_path);
+    TextureManager::instance().request(m_terrain_texture_path);
 
     // ====== Generate Terrain-related stuff
     //Generate Particle-related stuff
@@ -144,32 +188,8 @@ void Realtime::initializeGL() {
     glGenBuffers(1, &m_terrain_vbo);
     // Generate terrain VAO
     glGenVertexArrays(1, &m_terrain_vao);
-    // Generate texture image
-    glGenTextures(1, &m_terrain_texture);
     matrixData = std::vector<GLuint>(100 * 100, 0);
 
-    glGenTextures(1, &m_terrain_texture); // Use texture slot 1!!!
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, m_terrain_texture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    currentDir = QDir::currentPath();
-    texture_filepath = currentDir + QString::fromStdString("/scenefiles/textures/mountain_3.png");
-    m_terrain_image = QImage(texture_filepath);
-    if (m_terrain_image.isNull()) {
-        // Handle error: Image didn't load
-        std::cerr << "Failed to load texture image: " << texture_filepath.toStdString() << std::endl;
-        std::cerr << "Continue with no texture image." << std::endl;
-        glUniform1f(glGetUniformLocation(m_terrain_shader, "isTexture"), -1.0);
-    }
-    // Format image to fit OpenGL
-    m_terrain_image = m_terrain_image.convertToFormat(QImage::Format_RGBA8888).mirrored();
-    texture_filepath_saved = texture_filepath;
-    // Bind texture
-    glBindTexture(GL_TEXTURE_2D, m_terrain_texture);
-    // Load image into texture
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_terrain_image.width(), m_terrain_image.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, m_terrain_image.bits());
-
     glGenTextures(1, &m_collision_texture);
     glActiveTexture(GL_TEXTURE2); // Use texture slot 2!!!
     glBindTexture(GL_TEXTURE_2D, m_collision_texture);
@@ -181,6 +201,74 @@ void Realtime::initializeGL() {
     // Generate screen mesh
     generateScreen();
     makeFBO();
+
+    // ====== Uniform locations and the shared light buffer
+    setupUniforms();
+    lightBuffer.create();
+    lightClusters.create();
+}
+
+void Realtime::setupUniforms() {
+    // Locations don't change until a program is relinked, so they're looked up once here rather
+    // than by name every frame. Uniforms whose values never change are set here as well.
+    glUseProgram(m_shader);
+    m_shader_uniforms.viewMatrix = glGetUniformLocation(m_shader, "viewMatrix");
+    m_shader_uniforms.projectMatrix = glGetUniformLocation(m_shader, "projectMatrix");
+    m_shader_uniforms.ka = glGetUniformLocation(m_shader, "ka");
+    m_shader_uniforms.kd = glGetUniformLocation(m_shader, "kd");
+    m_shader_uniforms.ks = glGetUniformLocation(m_shader, "ks");
+    m_shader_uniforms.shininess = glGetUniformLocation(m_shader, "shininess");
+    m_shader_uniforms.cAmbient = glGetUniformLocation(m_shader, "cAmbient");
+    m_shader_uniforms.cDiffuse = glGetUniformLocation(m_shader, "cDiffuse");
+    m_shader_uniforms.cSpecular = glGetUniformLocation(m_shader, "cSpecular");
+    m_shader_uniforms.isTexture = glGetUniformLocation(m_shader, "isTexture");
+    m_shader_uniforms.cameraWorldSpacePos = glGetUniformLocation(m_shader, "cameraWorldSpacePos");
+    m_shader_uniforms.snowTimer = glGetUniformLocation(m_shader, "snowTimer");
+    m_shader_uniforms.sunTimer = glGetUniformLocation(m_shader, "sunTimer");
+    glUniform1i(glGetUniformLocation(m_shader, "textureImgMapping"), 3); // Shape texture is in slot 3
+    glUniform1f(glGetUniformLocation(m_shader, "materialBlend"), 0.4);
+    LightBuffer::bindProgram(m_shader);
+    LightClusters::bindProgram(m_shader);
+
+    glUseProgram(m_terrain_shader);
+    m_terrain_uniforms.modelMatrix = glGetUniformLocation(m_terrain_shader, "modelMatrix");
+    m_terrain_uniforms.normalMatrix = glGetUniformLocation(m_terrain_shader, "normalMatrix");
+    m_terrain_uniforms.viewMatrix = glGetUniformLocation(m_terrain_shader, "viewMatrix");
+    m_terrain_uniforms.projectMatrix = glGetUniformLocation(m_terrain_shader, "projectMatrix");
+    m_terrain_uniforms.ka = glGetUniformLocation(m_terrain_shader, "ka");
+    m_terrain_uniforms.kd = glGetUniformLocation(m_terrain_shader, "kd");
+    m_terrain_uniforms.ks = glGetUniformLocation(m_terrain_shader, "ks");
+    m_terrain_uniforms.isTexture = glGetUniformLocation(m_terrain_shader, "isTexture");
+    m_terrain_uniforms.cameraWorldSpacePos = glGetUniformLocation(m_terrain_shader, "cameraWorldSpacePos");
+    m_terrain_uniforms.isIncrease = glGetUniformLocation(m_terrain_shader, "isIncrease");
+    m_terrain_uniforms.accumulateRate = glGetUniformLocation(m_terrain_shader, "accumulateRate");
+    m_terrain_uniforms.snowTimer = glGetUniformLocation(m_terrain_shader, "snowTimer");
+    m_terrain_uniforms.sunTimer = glGetUniformLocation(m_terrain_shader, "sunTimer");
+    // Terrain Phong settings
+    glm::vec4 terrainCAmbient = glm::vec4(0.2, 0.2, 0.2, 1);
+    glm::vec4 terrainCDiffuse = glm::vec4(0.5, 0.5, 0.5, 1);
+    glm::vec4 terrainCSpecular = glm::vec4(0.1, 0.1, 0.1, 1);
+    glUniform4fv(glGetUniformLocation(m_terrain_shader, "cAmbient"), 1, &terrainCAmbient[0]);
+    glUniform4fv(glGetUniformLocation(m_terrain_shader, "cDiffuse"), 1, &terrainCDiffuse[0]);
+    glUniform4fv(glGetUniformLocation(m_terrain_shader, "cSpecular"), 1, &terrainCSpecular[0]);
+    glUniform1f(glGetUniformLocation(m_terrain_shader, "shininess"), 10);
+    glUniform1f(glGetUniformLocation(m_terrain_shader, "materialBlend"), 0.5);
+    glUniform1i(glGetUniformLocation(m_terrain_shader, "textureImgMapping"), 1); // Terrain texture is in slot 1
+    glUniform1i(glGetUniformLocation(m_terrain_shader, "textureCollisionMapping"), 2); // Collision map is in slot 2
+    LightBuffer::bindProgram(m_terrain_shader);
+    LightClusters::bindProgram(m_terrain_shader);
+
+    glUseProgram(m_frame_shader);
+    m_frame_uniforms.gradientStartColor = glGetUniformLocation(m_frame_shader, "gradientStartColor");
+    m_frame_uniforms.gradientEndColor = glGetUniformLocation(m_frame_shader, "gradientEndColor");
+    m_frame_uniforms.isPerPixelFilter = glGetUniformLocation(m_frame_shader, "isPerPixelFilter");
+    m_frame_uniforms.isKernelFilter = glGetUniformLocation(m_frame_shader, "isKernelFilter");
+    m_frame_uniforms.isFXAA = glGetUniformLocation(m_frame_shader, "isFXAA");
+    m_frame_uniforms.screenWidth = glGetUniformLocation(m_frame_shader, "screenWidth");
+    m_frame_uniforms.screenHeight = glGetUniformLocation(m_frame_shader, "screenHeight");
+    glUniform2f(glGetUniformLocation(m_frame_shader, "gradientDirection"), 0.0f, 1.0f); // Top to bottom
+
+    glUseProgram(0);
 }
 
 void Realtime::generateScreen() {
@@ -244,6 +332,7 @@ void Realtime::makeFBO(){
 }
 
 void Realtime::paintGL() {
+    FrameProfiler::CpuScope frameScope(frameProfiler, "paintGL");
     // Anything requiring OpenGL calls every frame should be done here
     // Update timers
     timeTracker += 1;
@@ -252,8 +341,9 @@ void Realtime::paintGL() {
 
     if (settings.heightMapPath != heightMapPathSaved) {
         staticParticleNum = 0;
-        staticShapeDataList.clear();
         staticMatrixList.clear();
+        accumulatedInstances.clear();
+        accumulatedUploadedBytes = 0;
 
         m_view = glm::mat4(1.0f);
         m_proj = glm::mat4(1.0f);
@@ -274,6 +364,32 @@ void Realtime::paintGL() {
         heightMapPathSaved = settings.heightMapPath;
     }
 
+    if (!settings.sceneFilePath.empty()) {
+        if (settings.sun) {
+            updateSunlight(sunlightOriginalDirection);
+        }
+        // Tessellation follows the camera distance when distance LOD is on, so it's redone every frame then
+        if (shapeDataStale || settings.extraCredit2) {
+            FrameProfiler::CpuScope scope(frameProfiler, "shape data");
+            setupShapesGL();
+        }
+        {
+            // Uploads only when a light or the sun actually changed
+            FrameProfiler::CpuScope scope(frameProfiler, "lights");
+            lightBuffer.update(renderScene.sceneMetaData.lights, sunlightColor, sunlightDirection);
+            // Point and spot lights are rebinned for the current view; this binds texture units
+            // directly, so it has to come before the state cache is reset
+            lightClusters.update(renderScene.sceneMetaData.lights, m_view, m_proj, settings.nearPlane, settings.farPlane,
+                                 m_screen_width, m_screen_height);
+        }
+        FrameProfiler::CpuScope scope(frameProfiler, "queue");
+        queueDraws();
+    }
+
+    // Everything above may bind state directly, so the cache starts from scratch for the draws below
+    stateCache.reset();
+    stateCache.resetCounters();
+
     // Bind FBO
     glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 
@@ -283,16 +399,9 @@ void Realtime::paintGL() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     if (!settings.sceneFilePath.empty()) {
-        // ====== Draw with terrain shader
-        if (settings.sun) {
-            updateSunlight(sunlightOriginalDirection);
-        }
-        paintTerrain();
-
-        // ====== Draw with default shader
-        if (settings.snow) {
-            paintGeometry();
-        }
+        // ====== Draw the terrain, scene shapes and snowflakes in state order
+        FrameProfiler::CpuScope scope(frameProfiler, "submit");
+        submitDraws();
     }
 
     // ====== Draw with frame shader
@@ -300,14 +409,52 @@ void Realtime::paintGL() {
     glBindFramebuffer(GL_FRAMEBUFFER, m_defaultFBO);
     glViewport(0, 0, m_screen_width, m_screen_height);
     // Call paintFrame to draw our FBO color attachment texture
+    frameProfiler.beginGpu("frame");
     paintFrame(m_fbo_texture);
+    frameProfiler.endGpu();
+
+    if (!recordingDirectory.isEmpty()) {
+        QString fileName = QString("frame_%1.png").arg(recordedFrames++, 5, 10, QChar('0'));
+        viewportCapture.capture(m_defaultFBO, m_screen_width, m_screen_height, m_screen_width, m_screen_height,
+                                QDir(recordingDirectory).filePath(fileName));
+    }
+    // Encodes the captures the GPU has finished reading back
+    viewportCapture.poll();
+
+    if (frameProfiler.enabled()) {
+        updateProfilerOverlay();
+    }
 }
 
-void Realtime::paintFrame(GLuint texture) {
-    glUseProgram(m_frame_shader);
+// Refreshes the timings overlay a couple of times a second, so it stays readable
+void Realtime::updateProfilerOverlay() {
+    frameProfiler.setCounter("draws", renderQueue.items().size());
+    // Stays at zero when the scene batches fall back to one call each
+    frameProfiler.setCounter("indirect commands", indirectDraws.commandCount());
+    frameProfiler.setCounter("state changes", stateCache.changes());
+    frameProfiler.setCounter("state skipped", stateCache.skipped());
+    frameProfiler.setCounter("shapes visible", shapeCullStats.visible);
+    frameProfiler.setCounter("shapes culled", shapeCullStats.culled);
+    frameProfiler.setCounter("BVH nodes", shapeCullStats.nodesVisited);
+    frameProfiler.setCounter("clustered lights", lightClusters.lightCount());
+    frameProfiler.setCounter("light indices", lightClusters.indexCount());
+    if (profilerOverlayTimer.elapsed() < 500) {
+        return;
+    }
+    profilerOverlayTimer.restart();
+    profilerOverlay->setText(QString::fromStdString(frameProfiler.summary()));
+    profilerOverlay->adjustSize();
+}
 
-    // Define gradient colors and direction
-    glm::vec2 gradientDirection = glm::vec2(0.0f, 1.0f); // Direction from top to bottom
+void Realtime::saveFrameTimings(std::string filePath) {
+    if (frameProfiler.writeCsv(filePath)) {
+        std::cout << "Saved frame timings to \"" << filePath << "\"" << std::endl;
+    }
+}
+
+void Realtime::paintFrame(GLuint texture) {
+    useProgram(m_frame_shader);
+    stateCache.setBlend(false);
 
     // Normalize the light direction
     glm::vec3 normalizedLightDirection = glm::normalize(sunlightDirection);
@@ -335,323 +482,221 @@ void Realtime::paintFrame(GLuint texture) {
         gradientEndColor = glm::mix(baseCoolGradientColor, sunlightColor, 0.3f) * nightTransitionFactor;
     }
 
-    // Set the gradient uniforms
-    glUniform3f(glGetUniformLocation(m_frame_shader, "gradientStartColor"), gradientStartColor.r, gradientStartColor.g, gradientStartColor.b);
-    glUniform3f(glGetUniformLocation(m_frame_shader, "gradientEndColor"), gradientEndColor.r, gradientEndColor.g, gradientEndColor.b);
-    glUniform2f(glGetUniformLocation(m_frame_shader, "gradientDirection"), gradientDirection.x, gradientDirection.y);
+    // Set the gradient uniforms; the direction is fixed in setupUniforms
+    glUniform3f(m_frame_uniforms.gradientStartColor, gradientStartColor.r, gradientStartColor.g, gradientStartColor.b);
+    glUniform3f(m_frame_uniforms.gradientEndColor, gradientEndColor.r, gradientEndColor.g, gradientEndColor.b);
 
     // Set bool uniform on whether or not to filter the texture drawn
-    glUniform1i(glGetUniformLocation(m_frame_shader, "isPerPixelFilter"), settings.perPixelFilter);
-    glUniform1i(glGetUniformLocation(m_frame_shader, "isKernelFilter"), settings.kernelBasedFilter);
+    glUniform1i(m_frame_uniforms.isPerPixelFilter, settings.perPixelFilter);
+    glUniform1i(m_frame_uniforms.isKernelFilter, settings.kernelBasedFilter);
 
-    glUniform1i(glGetUniformLocation(m_frame_shader, "isFXAA"), settings.extraCredit3);
+    glUniform1i(m_frame_uniforms.isFXAA, settings.extraCredit3);
 
-    glUniform1f(glGetUniformLocation(m_frame_shader, "screenWidth"), m_screen_width);
-    glUniform1f(glGetUniformLocation(m_frame_shader, "screenHeight"), m_screen_height);
+    glUniform1f(m_frame_uniforms.screenWidth, m_screen_width);
+    glUniform1f(m_frame_uniforms.screenHeight, m_screen_height);
 
-    glBindVertexArray(m_fullscreen_vao);
-
-    // Bind "texture" to slot 0
-    glActiveTexture(GL_TEXTURE0);           // Activate texture slot 0
-    glBindTexture(GL_TEXTURE_2D, texture);  // Bind the texture to the active texture slot
+    stateCache.bindVertexArray(m_fullscreen_vao);
 
-    // Note that the textureImg uniform is implicitly set to use texture slot 0
-    // because GL_TEXTURE0 is active when the texture is bound.
+    // Bind "texture" to slot 0, which the textureImg uniform uses by default
+    stateCache.bindTexture(0, texture);
 
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glBindVertexArray(0);
-    glUseProgram(0);
+    // Unbind the FBO texture so it isn't still bound for sampling while the next frame renders into it
+    stateCache.bindTexture(0, 0);
 }
 
-void Realtime::paintGeometry() {
-    //    paintParticle();
-    // Bind Vertex Data
-    glBindVertexArray(m_vao);
-
-    // Activate the shader program by calling glUseProgram with `m_shader`
-    glUseProgram(m_shader);
-
-    glUniform1i(glGetUniformLocation(m_shader, "snowTimer"), snowTimer);
-    glUniform1i(glGetUniformLocation(m_shader, "sunTimer"), sunTimer);
-
-    // Pass m_ka, m_kd, m_ks into the fragment shader as a uniform
-    glUniform1f(glGetUniformLocation(m_shader, "ka"), renderScene.getGlobalData().ka);
-    glUniform1f(glGetUniformLocation(m_shader, "kd"), renderScene.getGlobalData().kd);
-    glUniform1f(glGetUniformLocation(m_shader, "ks"), renderScene.getGlobalData().ks);
-
-    // Pass light info
-    int lightCounter = 0;
-    for (SceneLightData &light : renderScene.sceneMetaData.lights) {
-        if (light.type == LightType::LIGHT_DIRECTIONAL) {
-            GLint loc1 = glGetUniformLocation(m_shader, ("lightTypes[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform1f(loc1, 0);
-
-            GLint loc2 = glGetUniformLocation(m_shader, ("lightColors[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc2, light.color.x, light.color.y, light.color.z);
-
-            GLint loc3 = glGetUniformLocation(m_shader, ("lightDirections[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc3, light.dir.x, light.dir.y, light.dir.z);
-        }
-        if (light.type == LightType::LIGHT_POINT) {
-            GLint loc1 = glGetUniformLocation(m_shader, ("lightTypes[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform1f(loc1, 1);
-
-            GLint loc2 = glGetUniformLocation(m_shader, ("lightColors[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc2, light.color.x, light.color.y, light.color.z);
-
-            GLint loc4 = glGetUniformLocation(m_shader, ("lightPositions[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc4, light.pos.x, light.pos.y, light.pos.z);
-
-            GLint loc7 = glGetUniformLocation(m_shader, ("lightFunctions[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc7, light.function.x, light.function.y, light.function.z);
-        }
-        if (light.type == LightType::LIGHT_SPOT) {
-            GLint loc1 = glGetUniformLocation(m_shader, ("lightTypes[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform1f(loc1, 2);
-
-            GLint loc2 = glGetUniformLocation(m_shader, ("lightColors[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc2, light.color.x, light.color.y, light.color.z);
-
-            GLint loc3 = glGetUniformLocation(m_shader, ("lightDirections[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc3, light.dir.x, light.dir.y, light.dir.z);
-
-            GLint loc4 = glGetUniformLocation(m_shader, ("lightPositions[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc4, light.pos.x, light.pos.y, light.pos.z);
+// Builds this frame's render queue. Texture lookups and instance uploads happen here, before the
+// state cache is reset, since they bind things behind its back.
+void Realtime::queueDraws() {
+    renderQueue.clear();
+    frameTerrainTexture = TextureManager::instance().texture(m_terrain_texture_path);
+    frameShapeTexture = TextureManager::instance().texture(m_shape_texture_path);
 
-            GLint loc5 = glGetUniformLocation(m_shader, ("lightAngles[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform1f(loc5, light.angle);
+    renderQueue.push(makeSortKey(RenderPass::Opaque, TerrainProgramId, 0, TerrainTextureId, 0.f), std::uint32_t(DrawKind::Terrain), 0);
 
-            GLint loc6 = glGetUniformLocation(m_shader, ("lightPenumbras[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform1f(loc6, light.penumbra);
-
-            GLint loc7 = glGetUniformLocation(m_shader, ("lightFunctions[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc7, light.function.x, light.function.y, light.function.z);
+    if (settings.snow) {
+        // One item per batch of visible shapes sharing geometry and material, at the depth of its farthest instance
+        cullShapes();
+        const std::vector<InstanceBatch> &batches = instanceBatcher.batches();
+        const std::vector<InstanceData> &instances = instanceBatcher.instances();
+        for (size_t b = 0; b < batches.size(); b++) {
+            float depth = 0.f;
+            for (GLint i = batches[b].firstInstance; i < batches[b].firstInstance + batches[b].instanceCount; i++) {
+                depth = std::max(depth, -(m_view * instances[i].modelMatrix[3]).z);
+            }
+            std::uint64_t key = makeSortKey(RenderPass::Blended, ShapeProgramId, std::uint32_t(batches[b].materialId), ShapeTextureId, depth);
+            renderQueue.push(key, std::uint32_t(DrawKind::ShapeBatch), std::uint32_t(b));
         }
 
-        lightCounter ++;
-        if (lightCounter >= 8) {
-            break;
+        // Snowflakes have no scene material and come after every scene shape
+        std::uint64_t snowflakeKey = makeSortKey(RenderPass::Blended, ShapeProgramId, SnowflakeMaterialId, ShapeTextureId, 0.f);
+        renderQueue.push(snowflakeKey, std::uint32_t(DrawKind::Snowflakes), 0);
+        if (settings.accumulate) {
+            renderQueue.push(snowflakeKey, std::uint32_t(DrawKind::AccumulatedSnowflakes), 0);
         }
     }
+    renderQueue.sort();
+}
 
-    // Reset remaining lights if the current scene has fewer than 8 lights
-    for (int i = lightCounter; i < 8; i++) {
-        glUniform1f(glGetUniformLocation(m_shader, ("lightTypes[" + std::to_string(i) + "]").c_str()), -1); // Set to an invalid type
-        glUniform3f(glGetUniformLocation(m_shader, ("lightColors[" + std::to_string(i) + "]").c_str()), 0.0f, 0.0f, 0.0f);
-        glUniform3f(glGetUniformLocation(m_shader, ("lightDirections[" + std::to_string(i) + "]").c_str()), 0.0f, 0.0f, 0.0f);
-        glUniform3f(glGetUniformLocation(m_shader, ("lightPositions[" + std::to_string(i) + "]").c_str()), 0.0f, 0.0f, 0.0f);
-    }
-
-    // Pass shape info and draw shape
-    for (int i = 1; i < shapeStartIndices.size(); i++) {
-        // Pass in model matrix for shape i as a uniform into the shader program
-        glUniformMatrix4fv(glGetUniformLocation(m_shader, "modelMatrix"), 1, GL_FALSE, &modelMatrixList[i][0][0]);
-        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrixList[i])));
-        glUniformMatrix3fv(glGetUniformLocation(m_shader, "normalMatrix"), 1, GL_FALSE, &normalMatrix[0][0]);
-
-        // Pass in m_view and m_proj
-        glUniformMatrix4fv(glGetUniformLocation(m_shader, "viewMatrix"), 1, GL_FALSE, &m_view[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(m_shader, "projectMatrix"), 1, GL_FALSE, &m_proj[0][0]);
-        //        glUniform4fv(glGetUniformLocation(m_shader, "cAmbient"), 1, &renderScene.sceneMetaData.shapes[i].primitive.material.cAmbient[0]);
-        //        glUniform4fv(glGetUniformLocation(m_shader, "cDiffuse"), 1, &renderScene.sceneMetaData.shapes[i].primitive.material.cDiffuse[0]);
-        //        glUniform4fv(glGetUniformLocation(m_shader, "cSpecular"), 1, &renderScene.sceneMetaData.shapes[i].primitive.material.cSpecular[0]);
-        glUniform4fv(glGetUniformLocation(m_shader, "cAmbient"), 1, &renderScene.sceneMetaData.shapes[0].primitive.material.cAmbient[0]);
-        glUniform4fv(glGetUniformLocation(m_shader, "cDiffuse"), 1, &renderScene.sceneMetaData.shapes[0].primitive.material.cDiffuse[0]);
-        glUniform4fv(glGetUniformLocation(m_shader, "cSpecular"), 1, &renderScene.sceneMetaData.shapes[0].primitive.material.cSpecular[0]);
-
-        bool isShapeTexture = true;
-        if (isShapeTexture) {
-            glUniform1f(glGetUniformLocation(m_shader, "isTexture"), 1.0);
-
-            if (m_image.isNull()) {
-                // Handle error: Image didn't load
-                glUniform1f(glGetUniformLocation(m_shader, "isTexture"), -1.0);
+void Realtime::submitDraws() {
+    const std::vector<RenderItem> &items = renderQueue.items();
+    for (size_t i = 0; i < items.size(); i++) {
+        switch (DrawKind(items[i].kind)) {
+        case DrawKind::Terrain:
+            frameProfiler.beginGpu("terrain");
+            paintTerrain();
+            frameProfiler.endGpu();
+            break;
+        case DrawKind::ShapeBatch: {
+            // Runs of batches go out together, as one multi-draw when that's available
+            size_t end = i + 1;
+            while (end < items.size() && DrawKind(items[end].kind) == DrawKind::ShapeBatch) {
+                end++;
             }
-
-            // Set the texture.frag uniform for our texture
-            GLint textureUniform = glGetUniformLocation(m_shader, "textureImgMapping");
-            glUniform1i(textureUniform, 3);  // Set the sampler uniform to use texture unit 3
+            frameProfiler.beginGpu("shapes");
+            paintShapeBatches(items.data() + i, items.data() + end);
+            frameProfiler.endGpu();
+            i = end - 1;
+            break;
         }
-        else {
-            glUniform1f(glGetUniformLocation(m_shader, "isTexture"), -1.0);
+        case DrawKind::Snowflakes:
+            frameProfiler.beginGpu("snowflakes");
+            paintSnowflakes();
+            frameProfiler.endGpu();
+            break;
+        case DrawKind::AccumulatedSnowflakes:
+            frameProfiler.beginGpu("accumulated");
+            paintAccumulatedSnowflakes();
+            frameProfiler.endGpu();
+            break;
         }
-        glUniform1f(glGetUniformLocation(m_shader, "materialBlend"), 0.4);
-
-        // Pass shininess and world-space camera position
-        glUniform1f(glGetUniformLocation(m_shader, "shininess"), renderScene.sceneMetaData.shapes[0].primitive.material.shininess);
-        glm::vec4 cameraWorldSpacePos = renderScene.sceneCamera.cameraPos;
-        glUniform4fv(glGetUniformLocation(m_shader, "cameraWorldSpacePos"), 1, &cameraWorldSpacePos[0]);
-        // Blend Commend
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        // Draw Command
-        glDrawArrays(GL_TRIANGLES, shapeStartIndices[i], shapeSizes[i]);
-        glDisable(GL_BLEND);
     }
-
-    // Unbind Vertex Array
-    glBindVertexArray(0);
-
-    // Unbind texture
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    // Deactivate the shader program by passing 0 into glUseProgram
-    glUseProgram(0);
+    snowflakeStream.endFrame();
 }
 
-void Realtime::paintTerrain() {
-    // Bind Vertex Data
-    glBindVertexArray(m_terrain_vao);
-
-    // Activate the shader program by calling glUseProgram with `m_terrain_shader`
-    glUseProgram(m_terrain_shader);
-
-    // ====== Pass m_ka, m_kd, m_ks into the fragment shader as a uniform
-    glUniform1f(glGetUniformLocation(m_terrain_shader, "ka"), renderScene.getGlobalData().ka);
-    glUniform1f(glGetUniformLocation(m_terrain_shader, "kd"), renderScene.getGlobalData().kd);
-    glUniform1f(glGetUniformLocation(m_terrain_shader, "ks"), renderScene.getGlobalData().ks);
-
-    // ====== Pass light info
-    int lightCounter = 0;
-    for (SceneLightData &light : renderScene.sceneMetaData.lights) {
-        if (light.type == LightType::LIGHT_DIRECTIONAL) {
-            GLint loc1 = glGetUniformLocation(m_terrain_shader, ("lightTypes[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform1f(loc1, 0);
-
-            GLint loc2 = glGetUniformLocation(m_terrain_shader, ("lightColors[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc2, sunlightColor.x, sunlightColor.y, sunlightColor.z);
-
-            GLint loc3 = glGetUniformLocation(m_terrain_shader, ("lightDirections[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc3, sunlightDirection.x, sunlightDirection.y, sunlightDirection.z); // rotate the sun light
-        }
-        if (light.type == LightType::LIGHT_POINT) {
-            GLint loc1 = glGetUniformLocation(m_terrain_shader, ("lightTypes[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform1f(loc1, 1);
-
-            GLint loc2 = glGetUniformLocation(m_terrain_shader, ("lightColors[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc2, light.color.x, light.color.y, light.color.z);
-
-            GLint loc4 = glGetUniformLocation(m_terrain_shader, ("lightPositions[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc4, light.pos.x, light.pos.y, light.pos.z);
-
-            GLint loc7 = glGetUniformLocation(m_terrain_shader, ("lightFunctions[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc7, light.function.x, light.function.y, light.function.z);
-        }
-        if (light.type == LightType::LIGHT_SPOT) {
-            GLint loc1 = glGetUniformLocation(m_terrain_shader, ("lightTypes[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform1f(loc1, 2);
+// Switches program through the state cache. The first time a program is used in a frame, its
+// per-frame uniforms are set too.
+void Realtime::useProgram(GLuint program) {
+    if (!stateCache.useProgram(program)) {
+        return;
+    }
+    if (program == m_terrain_shader) {
+        setTerrainUniforms();
+    }
+    else if (program == m_shader) {
+        setShapeUniforms();
+    }
+}
 
-            GLint loc2 = glGetUniformLocation(m_terrain_shader, ("lightColors[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc2, light.color.x, light.color.y, light.color.z);
+void Realtime::setShapeUniforms() {
+    glUniform1i(m_shader_uniforms.snowTimer, snowTimer);
+    glUniform1i(m_shader_uniforms.sunTimer, sunTimer);
 
-            GLint loc3 = glGetUniformLocation(m_terrain_shader, ("lightDirections[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc3, light.dir.x, light.dir.y, light.dir.z);
+    // Pass m_ka, m_kd, m_ks into the fragment shader as a uniform
+    glUniform1f(m_shader_uniforms.ka, renderScene.getGlobalData().ka);
+    glUniform1f(m_shader_uniforms.kd, renderScene.getGlobalData().kd);
+    glUniform1f(m_shader_uniforms.ks, renderScene.getGlobalData().ks);
 
-            GLint loc4 = glGetUniformLocation(m_terrain_shader, ("lightPositions[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc4, light.pos.x, light.pos.y, light.pos.z);
+    // Light info comes from the shared light buffer, updated in paintGL
 
-            GLint loc5 = glGetUniformLocation(m_terrain_shader, ("lightAngles[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform1f(loc5, light.angle);
+    // Pass in m_view and m_proj
+    glUniformMatrix4fv(m_shader_uniforms.viewMatrix, 1, GL_FALSE, &m_view[0][0]);
+    glUniformMatrix4fv(m_shader_uniforms.projectMatrix, 1, GL_FALSE, &m_proj[0][0]);
+    const SceneMaterial &material = renderScene.sceneMetaData.shapes[0].primitive.material;
+    glUniform4fv(m_shader_uniforms.cAmbient, 1, &material.cAmbient[0]);
+    glUniform4fv(m_shader_uniforms.cDiffuse, 1, &material.cDiffuse[0]);
+    glUniform4fv(m_shader_uniforms.cSpecular, 1, &material.cSpecular[0]);
 
-            GLint loc6 = glGetUniformLocation(m_terrain_shader, ("lightPenumbras[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform1f(loc6, light.penumbra);
+    // The sampler and material blend are fixed in setupUniforms; -1 until the image has decoded
+    glUniform1f(m_shader_uniforms.isTexture, frameShapeTexture != 0 ? 1.0 : -1.0);
 
-            GLint loc7 = glGetUniformLocation(m_terrain_shader, ("lightFunctions[" + std::to_string(lightCounter) + "]").c_str());
-            glUniform3f(loc7, light.function.x, light.function.y, light.function.z);
-        }
+    // Pass shininess and world-space camera position
+    glUniform1f(m_shader_uniforms.shininess, material.shininess);
+    glm::vec4 cameraWorldSpacePos = renderScene.sceneCamera.cameraPos;
+    glUniform4fv(m_shader_uniforms.cameraWorldSpacePos, 1, &cameraWorldSpacePos[0]);
+}
 
-        lightCounter ++;
-        if (lightCounter >= 8) {
-            break;
-        }
-    }
+void Realtime::setTerrainUniforms() {
+    // ====== Pass m_ka, m_kd, m_ks into the fragment shader as a uniform
+    glUniform1f(m_terrain_uniforms.ka, renderScene.getGlobalData().ka);
+    glUniform1f(m_terrain_uniforms.kd, renderScene.getGlobalData().kd);
+    glUniform1f(m_terrain_uniforms.ks, renderScene.getGlobalData().ks);
 
-    // ====== Reset remaining lights if the current scene has fewer than 8 lights
-    for (int i = lightCounter; i < 8; i++) {
-        glUniform1f(glGetUniformLocation(m_terrain_shader, ("lightTypes[" + std::to_string(i) + "]").c_str()), -1); // Set to an invalid type
-        glUniform3f(glGetUniformLocation(m_terrain_shader, ("lightColors[" + std::to_string(i) + "]").c_str()), 0.0f, 0.0f, 0.0f);
-        glUniform3f(glGetUniformLocation(m_terrain_shader, ("lightDirections[" + std::to_string(i) + "]").c_str()), 0.0f, 0.0f, 0.0f);
-        glUniform3f(glGetUniformLocation(m_terrain_shader, ("lightPositions[" + std::to_string(i) + "]").c_str()), 0.0f, 0.0f, 0.0f);
-    }
+    // ====== Light info comes from the shared light buffer, updated in paintGL
 
     // ====== Pass shape info and draw shape
     // Pass in model matrix for shape i as a uniform into the shader program
-    glUniformMatrix4fv(glGetUniformLocation(m_terrain_shader, "modelMatrix"), 1, GL_FALSE, &terrainModelMatrix[0][0]);
+    glUniformMatrix4fv(m_terrain_uniforms.modelMatrix, 1, GL_FALSE, &terrainModelMatrix[0][0]);
     glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(terrainModelMatrix)));
-    glUniformMatrix3fv(glGetUniformLocation(m_terrain_shader, "normalMatrix"), 1, GL_FALSE, &normalMatrix[0][0]);
+    glUniformMatrix3fv(m_terrain_uniforms.normalMatrix, 1, GL_FALSE, &normalMatrix[0][0]);
 
     // ====== Pass in camera data - m_view and m_proj
-    glUniformMatrix4fv(glGetUniformLocation(m_terrain_shader, "viewMatrix"), 1, GL_FALSE, &m_view[0][0]);
-    glUniformMatrix4fv(glGetUniformLocation(m_terrain_shader, "projectMatrix"), 1, GL_FALSE, &m_proj[0][0]);
-    // Pass shininess and world-space camera position
-    float terrainShininess = 10;
-    glUniform1f(glGetUniformLocation(m_terrain_shader, "shininess"), terrainShininess);
+    glUniformMatrix4fv(m_terrain_uniforms.viewMatrix, 1, GL_FALSE, &m_view[0][0]);
+    glUniformMatrix4fv(m_terrain_uniforms.projectMatrix, 1, GL_FALSE, &m_proj[0][0]);
+    // Pass world-space camera position; shininess and the Phong colors are fixed in setupUniforms
     glm::vec4 cameraWorldSpacePos = renderScene.sceneCamera.cameraPos;
-    glUniform4fv(glGetUniformLocation(m_terrain_shader, "cameraWorldSpacePos"), 1, &cameraWorldSpacePos[0]);
+    glUniform4fv(m_terrain_uniforms.cameraWorldSpacePos, 1, &cameraWorldSpacePos[0]);
 
-    // ====== Terrain Phong settings
-    glm::vec4 terrainCAmbient = glm::vec4(0.2, 0.2, 0.2, 1);
-    glm::vec4 terrainCDiffuse = glm::vec4(0.5, 0.5, 0.5, 1);
-    glm::vec4 terrainCSpecular = glm::vec4(0.1, 0.1, 0.1, 1);
-    glUniform4fv(glGetUniformLocation(m_terrain_shader, "cAmbient"), 1, &terrainCAmbient[0]);
-    glUniform4fv(glGetUniformLocation(m_terrain_shader, "cDiffuse"), 1, &terrainCDiffuse[0]);
-    glUniform4fv(glGetUniformLocation(m_terrain_shader, "cSpecular"), 1, &terrainCSpecular[0]);
+    // ====== Terrain texture; -1 while the image is still decoding or if it didn't load
+    glUniform1f(m_terrain_uniforms.isTexture, frameTerrainTexture != 0 ? 1.0 : -1.0);
 
-    // ====== Terrain texture
-    bool isTerrainTexture = true; // Currently hardcoded it to be true
-    if (isTerrainTexture) {
-        glUniform1f(glGetUniformLocation(m_terrain_shader, "isTexture"), 1.0);
+    glUniform1f(m_terrain_uniforms.isIncrease, settings.increase ? 1.0f : 0.0f);
+    glUniform1f(m_terrain_uniforms.accumulateRate, accumulateRate);
 
-        if (m_terrain_image.isNull()) {
-            // Handle error: Image didn't load
-            glUniform1f(glGetUniformLocation(m_terrain_shader, "isTexture"), -1.0);
-        }
+    // ====== Accumulation timers
+    glUniform1i(m_terrain_uniforms.snowTimer, snowTimer);
+    glUniform1i(m_terrain_uniforms.sunTimer, sunTimer);
+}
 
-        // Set the texture.frag uniform for our texture
-        GLint textureUniform = glGetUniformLocation(m_terrain_shader, "textureImgMapping");
-        glUniform1i(textureUniform, 1);  // Set the sampler uniform to use texture unit 1
-    }
-    else {
-        glUniform1f(glGetUniformLocation(m_terrain_shader, "isTexture"), -1.0);
-    }
-    float terrainMaterialBlend = 0.5;
-    glUniform1f(glGetUniformLocation(m_terrain_shader, "materialBlend"), terrainMaterialBlend);
+void Realtime::paintTerrain() {
+    useProgram(m_terrain_shader);
+    stateCache.bindVertexArray(m_terrain_vao);
+    stateCache.setBlend(false);
+    stateCache.bindTexture(1, frameTerrainTexture); // Use texture slot 1!!!
 
-    // ====== Pass collision map as a texture
-    // Bind texture
-    glBindTexture(GL_TEXTURE_2D, m_collision_texture);
+    // ====== Pass collision map as a texture, in slot 2
+    stateCache.bindTexture(2, m_collision_texture);
     // Update collision map
-    updateTerrainCollisionMap();
+    {
+        FrameProfiler::CpuScope scope(frameProfiler, "collision");
+        updateTerrainCollisionMap();
+    }
     // Upload the data to the texture
     glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, 100, 100, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, matrixData.data());
-    // Set the texture.frag uniform for our texture
-    GLint textureUniform = glGetUniformLocation(m_terrain_shader, "textureCollisionMapping");
-    glUniform1i(textureUniform, 2);  // Set the sampler uniform to use texture unit 2
-
-    if (settings.increase) {
-        glUniform1f(glGetUniformLocation(m_terrain_shader, "isIncrease"), 1.0f);
-    }
-    else {
-        glUniform1f(glGetUniformLocation(m_terrain_shader, "isIncrease"), 0.0f);
-    }
-    glUniform1f(glGetUniformLocation(m_terrain_shader, "accumulateRate"), accumulateRate);
-
-    // ====== Accumulation timers
-    glUniform1i(glGetUniformLocation(m_terrain_shader, "snowTimer"), snowTimer);
-    glUniform1i(glGetUniformLocation(m_terrain_shader, "sunTimer"), sunTimer);
 
     // Draw Command
     glDrawArrays(GL_TRIANGLES, terrainStartIndex, terrainSize);
+}
 
-    // Unbind Vertex Array
-    glBindVertexArray(0);
-
-    // Unbind texture
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    // Deactivate the shader program by passing 0 into glUseProgram
-    glUseProgram(0);
+// Draws the scene batches of a run of queue items. Model and normal matrices come from the instance buffer.
+void Realtime::paintShapeBatches(const RenderItem *first, const RenderItem *last) {
+    useProgram(m_shader);
+    stateCache.bindVertexArray(m_vao);
+    stateCache.setBlend(true);
+    // Every shape samples the same image from texture slot 3
+    stateCache.bindTexture(3, frameShapeTexture);
+
+    const std::vector<InstanceBatch> &batches = instanceBatcher.batches();
+    if (useIndirectDraws) {
+        // Every batch goes out in queue order in a few multi-draws, each reading its instances from its base instance on
+        indirectDraws.clear();
+        for (const RenderItem *item = first; item != last; item++) {
+            const InstanceBatch &batch = batches[item->index];
+            indirectDraws.add(batch.range, batchLodLevel(batch), batch.instanceCount, GLuint(batch.firstInstance));
+        }
+        indirectDraws.upload(m_indirect_buffer);
+        InstanceBatcher::bindInstances(m_instance_vbo, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect_buffer);
+        indirectDraws.draw();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    else {
+        for (const RenderItem *item = first; item != last; item++) {
+            const InstanceBatch &batch = batches[item->index];
+            InstanceBatcher::bindInstances(m_instance_vbo, batch.firstInstance);
+            drawGeometryRange(batch.range, batchLodLevel(batch), batch.instanceCount);
+        }
+    }
 }
 
 void Realtime::updateSunlight(glm::vec4 originalDirection) {
@@ -698,10 +743,6 @@ void Realtime::updateTerrainCollisionMap() {
                 if (x >=0 && x <= 1 && z >=0 && z <= 1) {
                     // Add shape info to static list
                     if (settings.accumulate) {
-                        QString temp_imagePath = "/scenefiles/textures/snowflake.png";
-                        Square squareShape;
-                        squareShape.updateParams(true, 1, 1, temp_imagePath);
-                        staticShapeDataList.push_back(squareShape.generateShape());
                         particle.position.y = terrainHeight + 0.001;
                         if (settings.increase) {
                             particle.position.y += accumulateHeight;
@@ -745,10 +786,8 @@ void Realtime::resizeGL(int w, int h) {
     // Regenerate FBOs
     makeFBO();
 
-    shapeDataList.clear();
-    vboData.clear();
-    shapeStartIndices.clear();
-    shapeSizes.clear();
+    modelMatrixList.clear();
+    shapeRanges.clear();
     m_view = glm::mat4(1.0f);
     m_proj = glm::mat4(1.0f);
 
@@ -780,6 +819,8 @@ void Realtime::sceneChanged() {
     if (!success) {
         std::cerr << "Error loading scene: \"" << settings.sceneFilePath << "\"" << std::endl;
     }
+    loadedScene = metaData;
+    watchSceneFile();
 
     // Create scene
     renderScene = RenderScene(size().width() * m_devicePixelRatio,
@@ -799,16 +840,97 @@ void Realtime::sceneChanged() {
     update(); // asks for a PaintGL() call to occur
 }
 
+void Realtime::watchSceneFile() {
+    QStringList watched = sceneWatcher.files();
+    if (!watched.isEmpty()) {
+        sceneWatcher.removePaths(watched);
+    }
+    if (settings.watchScene && !settings.sceneFilePath.empty()) {
+        sceneWatcher.addPath(QString::fromStdString(settings.sceneFilePath));
+    }
+}
+
+// Re-parses the scene file and applies only what changed. Shape edits go through applyShapeDiff,
+// so when every shape keeps its place the work is proportional to the number of edited shapes; an
+// addition or removal also rebuilds the batches and BVH. Light and camera edits don't touch the
+// geometry at all. The parse and diff still cover the whole file.
+void Realtime::reloadScene() {
+    // A file replaced on save drops out of the watcher, so watch the path again
+    watchSceneFile();
+    if (!settings.watchScene || settings.sceneFilePath.empty()) {
+        return;
+    }
+
+    QElapsedTimer reloadTimer;
+    reloadTimer.start();
+
+    RenderData reloaded;
+    if (!SceneParser::parse(settings.sceneFilePath, reloaded)) {
+        std::cerr << "Error reloading scene, keeping the current one: \"" << settings.sceneFilePath << "\"" << std::endl;
+        return;
+    }
+    SceneDiff diff = diffScenes(loadedScene, reloaded);
+    loadedScene = std::move(reloaded);
+    if (diff.empty()) {
+        return;
+    }
+
+    makeCurrent();
+    if (diff.globalDataChanged) {
+        metaData.globalData = loadedScene.globalData;
+        renderScene.sceneMetaData.globalData = loadedScene.globalData;
+    }
+    if (diff.lightsChanged) {
+        metaData.lights = loadedScene.lights;
+        renderScene.sceneMetaData.lights = loadedScene.lights;
+    }
+    if (diff.cameraChanged) {
+        // Only a camera edited in the file moves the view; otherwise the user's navigation is kept
+        metaData.cameraData = loadedScene.cameraData;
+        renderScene.sceneMetaData.cameraData = loadedScene.cameraData;
+        renderScene.updateCamera(settings.nearPlane, settings.farPlane, metaData);
+        m_view = renderScene.sceneCamera.getViewMatrix();
+        m_proj = renderScene.sceneCamera.getProjectMatrix();
+    }
+    if (diff.shapesChanged() && !applyShapeDiff(diff)) {
+        metaData.shapes = loadedScene.shapes;
+        renderScene.sceneMetaData.shapes = loadedScene.shapes;
+        // Edits that keep every shape in place only move boxes, which a refit handles
+        if (diff.addedShapes.empty() && diff.removedShapes.empty()) {
+            shapeBoundsStale = true;
+        }
+        else {
+            shapeBvhStale = true;
+        }
+        setupShapesGL();
+    }
+
+    std::cout << "Reloaded scene in " << reloadTimer.elapsed() << " ms: "
+              << diff.addedShapes.size() << " shapes added, "
+              << diff.removedShapes.size() << " removed, "
+              << diff.modifiedShapes.size() << " modified"
+              << (diff.lightsChanged ? ", lights changed" : "")
+              << (diff.cameraChanged ? ", camera changed" : "") << std::endl;
+
+    update(); // asks for a PaintGL() call to occur
+}
+
 void Realtime::settingsChanged() {
+    watchSceneFile();
+    if (settings.frameTimings != frameProfiler.enabled()) {
+        frameProfiler.setEnabled(settings.frameTimings);
+        profilerOverlay->setVisible(settings.frameTimings);
+    }
+    // Tessellation parameters may have changed; the geometry cache makes this cheap if they didn't
+    shapeDataStale = true;
+
     int oldNum=particles->getParticleNum();
 //    int newNum=int(1000*((1.0f*settings.intensity)/100.f));
     int newNum=settings.intensity;
     bool flagIntensity=std::abs(oldNum-newNum)>100?true:false;
     if (flagIntensity) {
-        shapeDataList.clear();
-        vboData.clear();
-        shapeStartIndices.clear();
-        shapeSizes.clear();
+        modelMatrixList.clear();
+        shapeRanges.clear();
 
         if (!settings.sceneFilePath.empty()) {
             if (flagIntensity) {
@@ -821,8 +943,9 @@ void Realtime::settingsChanged() {
 
     if (settings.bumpiness != shapeParameter1Saved) {
         staticParticleNum = 0;
-        staticShapeDataList.clear();
         staticMatrixList.clear();
+        accumulatedInstances.clear();
+        accumulatedUploadedBytes = 0;
 
         m_view = glm::mat4(1.0f);
         m_proj = glm::mat4(1.0f);
@@ -883,13 +1006,20 @@ void Realtime::setSunlightDirectionAccordingToTime() {
 
 void Realtime::setupShapesGL() {
     setupShapeData();
+    uploadShapeGeometry();
+}
 
-    // Bind VBO
+// Sends newly tessellated geometry to the VBO; nothing is uploaded when every shape hit the cache
+void Realtime::uploadShapeGeometry() {
+    if (!geometryCache.upload(m_vbo, m_ebo)) {
+        return;
+    }
+
+    // The buffer storage was (re)allocated, so point the attributes at it again
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-    // Send data to VBO
-    glBufferData(GL_ARRAY_BUFFER, vboData.size() * sizeof(GLfloat), vboData.data(), GL_STATIC_DRAW);
-    // Bind VAO
+    // Bind VAO, the index buffer binding is part of its state
     glBindVertexArray(m_vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
     // Enable and define attribute 0 to store vertex positions and attribute 1 to store vertex normals
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
@@ -908,7 +1038,11 @@ void Realtime::setupTerrainGL() {
     // Bind VBO
     glBindBuffer(GL_ARRAY_BUFFER, m_terrain_vbo);
     // Send data to VBO
-    glBufferData(GL_ARRAY_BUFFER, terrainVboData.size() * sizeof(GLfloat), terrainVboData.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, terrainVertices.size_bytes(), terrainVertices.data(), GL_STATIC_DRAW);
+    // The GPU copy is all we need from here on
+    terrainVertices = {};
+    terrainCache.release();
+    terrainData = std::vector<float>();
     // Bind VAO
     glBindVertexArray(m_terrain_vao);
     // Enable and define attribute 0 to store vertex positions, attribute 1 to store vertex normals,  attribute 2 to store uv coordinates for textures
@@ -923,12 +1057,8 @@ void Realtime::setupTerrainGL() {
     glBindBuffer(GL_ARRAY_BUFFER,0);
 }
 
-void Realtime::setupShapeData() {
-    shapeDataList.clear();
-    modelMatrixList.clear();
-    vboData.clear();
-    shapeSizes.clear();
-    shapeStartIndices.clear();
+// Tessellation parameters every scene shape starts from, before distance LOD
+glm::ivec2 Realtime::shapeParameters() const {
     int shapeParameter1 = settings.bumpiness;
     int shapeParameter2 = settings.shapeParameter2;
 
@@ -944,8 +1074,57 @@ void Realtime::setupShapeData() {
     }
 
     // Set the lower bound of shape parameters
-    shapeParameter1 = int(std::max(1, shapeParameter1));
-    shapeParameter2 = int(std::max(3, shapeParameter2));
+    return glm::ivec2(std::max(1, shapeParameter1), std::max(3, shapeParameter2));
+}
+
+GeometryKey Realtime::shapeGeometryKey(const RenderShapeData &shape, int param1, int param2) const {
+    GeometryKey key;
+    key.shape = geometryShapeOf(shape.primitive.type);
+    key.isTexture = shape.primitive.material.textureMap.isUsed;
+    key.repeatU = shape.primitive.material.textureMap.repeatU;
+    key.repeatV = shape.primitive.material.textureMap.repeatV;
+    if (key.shape == GeometryShape::Cube) {
+        key.param1 = param1;
+    }
+    if (key.shape == GeometryShape::Cone || key.shape == GeometryShape::Cylinder) {
+        key.param1 = param1;
+        key.param2 = param2;
+    }
+    if (key.shape == GeometryShape::Sphere) {
+        key.param1 = int(std::max(2, param1));
+        key.param2 = param2;
+    }
+    if (key.shape == GeometryShape::Mesh) {
+        // Meshes ignore tessellation and texture parameters
+        key.isTexture = false;
+        key.repeatU = key.repeatV = 1.f;
+        key.meshfile = shape.primitive.meshfile;
+        key.creaseAngle = settings.creaseAngle;
+    }
+    return key;
+}
+
+// Numbers the distinct materials so shapes that share one can be batched together
+int Realtime::shapeMaterialId(const SceneMaterial &material) {
+    std::vector<int> &candidates = shapeMaterialBuckets[hashMaterial(material)];
+    auto sameMaterial = std::find_if(candidates.begin(), candidates.end(), [&](int id) {
+        return shapeMaterials[id] == material;
+    });
+    if (sameMaterial != candidates.end()) {
+        return *sameMaterial;
+    }
+    candidates.push_back(int(shapeMaterials.size()));
+    shapeMaterials.push_back(material);
+    return candidates.back();
+}
+
+void Realtime::setupShapeData() {
+    modelMatrixList.clear();
+    shapeRanges.clear();
+    shapeMaterialIds.clear();
+    shapeMaterials.clear();
+    shapeMaterialBuckets.clear();
+    glm::ivec2 parameters = shapeParameters();
 
     // Adaptive level of detail for object distances
     std::vector<float> distanceFactors;
@@ -953,104 +1132,284 @@ void Realtime::setupShapeData() {
         distanceFactors = calculateDistanceFactors();
     }
 
-    // Setup shape data (vertices and normals) from the scene
+    // Build one geometry key per scene shape; the geometry cache only tessellates keys it hasn't seen yet
+    std::vector<GeometryKey> keys;
+    keys.reserve(renderScene.sceneMetaData.shapes.size());
     int shapeIdx = 0;
     for (RenderShapeData &shape : renderScene.sceneMetaData.shapes) {
-        int finalShapeParameter1 = shapeParameter1;
-        int finalShapeParameter2 = shapeParameter2;
+        int finalShapeParameter1 = parameters.x;
+        int finalShapeParameter2 = parameters.y;
         if (settings.extraCredit2) {
-            finalShapeParameter1 = int(std::max(3.0f, shapeParameter1 * distanceFactors[shapeIdx]));
-            finalShapeParameter2 = int(std::max(3.0f, shapeParameter2 * distanceFactors[shapeIdx]));
+            finalShapeParameter1 = int(std::max(3.0f, parameters.x * distanceFactors[shapeIdx]));
+            finalShapeParameter2 = int(std::max(3.0f, parameters.y * distanceFactors[shapeIdx]));
         }
 
-        if (shape.primitive.type == PrimitiveType::PRIMITIVE_CUBE) {
-            Cube cubeShape;
-            cubeShape.updateParams(finalShapeParameter1, shape.primitive.material.textureMap.isUsed, shape.primitive.material.textureMap.repeatU, shape.primitive.material.textureMap.repeatV, QString::fromStdString(shape.primitive.material.textureMap.filename));
-            shapeDataList.push_back(cubeShape.generateShape());
+        keys.push_back(shapeGeometryKey(shape, finalShapeParameter1, finalShapeParameter2));
+        shapeMaterialIds.push_back(shapeMaterialId(shape.primitive.material));
+        modelMatrixList.push_back(shape.ctm);
+        shapeIdx++;
+    }
+    // The cache only ever appends, and with distance LOD each camera move can ask for tessellations it
+    // hasn't seen. Once it holds far more entries than the scene draws, start over with just the current ones.
+    if (settings.extraCredit2 && geometryCache.entryCount() > std::max(maxLodCacheEntries, 4 * keys.size())) {
+        geometryCache.clear();
+    }
+    shapeRanges = geometryCache.acquireAll(keys);
+
+    // Every falling and accumulated snowflake shares the same square
+    GeometryKey squareKey;
+    squareKey.shape = GeometryShape::Square;
+    squareKey.isTexture = true;
+    snowflakeRange = geometryCache.acquire(squareKey);
+
+    shapeDataStale = false;
+    sceneInstancesStale = true;
+    updateShapeBvh();
+}
+
+// Applies the shape edits of a reload, doing work only for the shapes that changed: they alone get
+// geometry keys and material ids, a moved shape that stays in its batch has just its instance
+// rewritten, and the BVH is refit along the paths above them. Added or removed shapes shift every
+// index after them, so the survivors' state is carried over and the batches and BVH are rebuilt.
+// Returns false when the shapes have to be set up from scratch instead, because distance or complexity
+// LOD ties each shape's tessellation to the rest of the scene.
+bool Realtime::applyShapeDiff(const SceneDiff &diff) {
+    std::vector<RenderShapeData> &shapes = renderScene.sceneMetaData.shapes;
+    bool countChanged = loadedScene.shapes.size() != shapes.size();
+    if (shapeDataStale || settings.extraCredit2 || (settings.extraCredit1 && countChanged)
+        || shapeRanges.size() != shapes.size() || shapeBounds.size() != shapes.size()) {
+        return false;
+    }
+    glm::ivec2 parameters = shapeParameters();
+
+    if (!countChanged && diff.addedShapes.empty() && diff.removedShapes.empty()) {
+        std::vector<std::uint32_t> moved;
+        for (size_t i : diff.modifiedShapes) {
+            shapes[i] = loadedScene.shapes[i];
+            metaData.shapes[i] = loadedScene.shapes[i];
+            GeometryRange range = geometryCache.acquire(shapeGeometryKey(shapes[i], parameters.x, parameters.y));
+            int materialId = shapeMaterialId(shapes[i].primitive.material);
+            // The batcher identifies geometry by where its range starts and how long it is
+            const GeometryRange &previous = shapeRanges[i];
+            bool sameBatch = materialId == shapeMaterialIds[i] && range.baseVertex == previous.baseVertex
+                             && range.vertexCount == previous.vertexCount && range.indexOffset == previous.indexOffset
+                             && range.indexCount == previous.indexCount;
+            shapeRanges[i] = range;
+            shapeMaterialIds[i] = materialId;
+            modelMatrixList[i] = shapes[i].ctm;
+            shapeBounds[i] = shapeWorldBounds(i);
+            moved.push_back(std::uint32_t(i));
+
+            // Shape 0 is never drawn. Shapes that aren't batched are picked up when the next cull finds them visible.
+            auto batched = std::lower_bound(batchedShapes.begin(), batchedShapes.end(), std::uint32_t(i));
+            if (!sameBatch) {
+                sceneInstancesStale = true;
+            }
+            else if (!sceneInstancesStale && i != 0 && batched != batchedShapes.end() && *batched == i) {
+                size_t element = size_t(batched - batchedShapes.begin()) - (batchedShapes.front() == 0 ? 1 : 0);
+                instanceBatcher.updateInstance(m_instance_vbo, element, modelMatrixList[i]);
+            }
         }
-        if (shape.primitive.type == PrimitiveType::PRIMITIVE_CONE) {
-            Cone coneShape;
-            coneShape.updateParams(finalShapeParameter1, finalShapeParameter2, shape.primitive.material.textureMap.isUsed, shape.primitive.material.textureMap.repeatU, shape.primitive.material.textureMap.repeatV, QString::fromStdString(shape.primitive.material.textureMap.filename));
-            shapeDataList.push_back(coneShape.generateShape());
+        uploadShapeGeometry();
+        if (shapeBvh.primitiveCount() == shapes.size() && !shapeBvhStale) {
+            shapeBvh.refit(shapeBounds, moved);
         }
-        if (shape.primitive.type == PrimitiveType::PRIMITIVE_CYLINDER) {
-            Cylinder cylinderShape;
-            cylinderShape.updateParams(finalShapeParameter1, finalShapeParameter2, shape.primitive.material.textureMap.isUsed, shape.primitive.material.textureMap.repeatU, shape.primitive.material.textureMap.repeatV, QString::fromStdString(shape.primitive.material.textureMap.filename));
-            shapeDataList.push_back(cylinderShape.generateShape());
+        else {
+            shapeBvhStale = true;
+            updateShapeBvh();
         }
-        if (shape.primitive.type == PrimitiveType::PRIMITIVE_SPHERE) {
-            finalShapeParameter1 = int(std::max(2, finalShapeParameter1));
-            Sphere sphereShape;
-            sphereShape.updateParams(finalShapeParameter1, finalShapeParameter2, shape.primitive.material.textureMap.isUsed, shape.primitive.material.textureMap.repeatU, shape.primitive.material.textureMap.repeatV, QString::fromStdString(shape.primitive.material.textureMap.filename));
-            shapeDataList.push_back(sphereShape.generateShape());
+        return true;
+    }
+
+    // Survivors keep their geometry, material id and matrix; only new and modified shapes are looked up
+    size_t count = loadedScene.shapes.size();
+    std::vector<bool> modified(count, false);
+    for (size_t i : diff.modifiedShapes) {
+        modified[i] = true;
+    }
+    std::vector<glm::mat4> matrices(count);
+    std::vector<GeometryRange> ranges(count);
+    std::vector<int> materialIds(count);
+    std::vector<GeometryKey> keys;
+    std::vector<size_t> keyShapes;
+    for (size_t i = 0; i < count; i++) {
+        const RenderShapeData &shape = loadedScene.shapes[i];
+        size_t previous = diff.previousShapes[i];
+        if (previous == SceneDiff::noShape || modified[i]) {
+            keys.push_back(shapeGeometryKey(shape, parameters.x, parameters.y));
+            keyShapes.push_back(i);
+            materialIds[i] = shapeMaterialId(shape.primitive.material);
+            matrices[i] = shape.ctm;
         }
-        if (shape.primitive.type == PrimitiveType::PRIMITIVE_MESH) {
-            Mesh mesh = loadMesh(shape.primitive.meshfile);
-            shapeDataList.push_back(mesh.generateVertexData());
+        else {
+            ranges[i] = shapeRanges[previous];
+            materialIds[i] = shapeMaterialIds[previous];
+            matrices[i] = modelMatrixList[previous];
         }
-
-        modelMatrixList.push_back(shape.ctm);
-        shapeIdx++;
     }
+    std::vector<GeometryRange> acquired = geometryCache.acquireAll(keys);
+    for (size_t k = 0; k < keyShapes.size(); k++) {
+        ranges[keyShapes[k]] = acquired[k];
+    }
+
+    shapes = loadedScene.shapes;
+    metaData.shapes = loadedScene.shapes;
+    modelMatrixList = std::move(matrices);
+    shapeRanges = std::move(ranges);
+    shapeMaterialIds = std::move(materialIds);
+    uploadShapeGeometry();
+    sceneInstancesStale = true;
+    shapeBvhStale = true;
+    updateShapeBvh();
+    return true;
+}
 
-    QString temp_imagePath = "/scenefiles/textures/snowflake.png";
-    int particleNum = particles->getParticleNum();
-    std::vector<std::vector<float>> tempShapeDataList(particleNum);
-    std::vector<glm::mat4> tempModelMatrixList(particleNum);
+// World-space box around a scene shape. Cones, cubes, cylinders and spheres fit in the unit cube
+// around the origin, meshes in the cube around their bounding sphere.
+Aabb Realtime::shapeWorldBounds(size_t shape) const {
+    const RenderShapeData &data = renderScene.sceneMetaData.shapes[shape];
+    float extent = data.primitive.type == PrimitiveType::PRIMITIVE_MESH ? shapeRanges[shape].boundingRadius : 0.5f;
+    Aabb local;
+    local.min = glm::vec3(-extent);
+    local.max = glm::vec3(extent);
+    return transformAabb(data.ctm, local);
+}
 
-    QVector<QFuture<void>> futures;
-    for (int i = 0; i < particleNum; ++i) {
-        futures.push_back(QtConcurrent::run([=, &tempShapeDataList, &tempModelMatrixList]() {
-            Square squareShape;
-            squareShape.updateParams(true, 1, 1, temp_imagePath);
-            tempShapeDataList[i] = squareShape.generateShape();
-            tempModelMatrixList[i] = particles->getModel()[i];
-        }));
+// Brings the BVH up to date with the scene shapes
+void Realtime::updateShapeBvh() {
+    if (!shapeBvhStale && !shapeBoundsStale) {
+        return;
     }
 
-    // 等待所有任务完成
-    for (auto &future : futures) {
-        future.waitForFinished();
+    const std::vector<RenderShapeData> &shapes = renderScene.sceneMetaData.shapes;
+    shapeBounds.resize(shapes.size());
+    for (size_t i = 0; i < shapes.size(); i++) {
+        shapeBounds[i] = shapeWorldBounds(i);
     }
 
-    for (int i = 0; i < particleNum; ++i) {
-        shapeDataList.push_back(tempShapeDataList[i]);
-        modelMatrixList.push_back(tempModelMatrixList[i]);
+    if (shapeBvhStale || shapeBvh.primitiveCount() != shapeBounds.size()) {
+        shapeBvh.build(shapeBounds);
+    }
+    else {
+        shapeBvh.refit(shapeBounds);
     }
+    shapeBvhStale = false;
+    shapeBoundsStale = false;
+}
 
-    if (settings.accumulate) {
-        for (int i = 0; i < staticParticleNum; ++i) {
-            shapeDataList.push_back(staticShapeDataList[i]);
-            modelMatrixList.push_back(staticMatrixList[i]);
+// Picks the scene shapes to draw this frame and batches them, skipping those outside the view frustum.
+// Snowflakes are tiny and all move every tick, so they are always drawn, by paintSnowflakes and
+// paintAccumulatedSnowflakes.
+void Realtime::cullShapes() {
+    size_t sceneShapeCount = renderScene.sceneMetaData.shapes.size();
+    visibleShapes.clear();
+    if (settings.frustumCulling && shapeBvh.primitiveCount() == sceneShapeCount) {
+        shapeBvh.cull(Frustum::fromViewProjection(m_proj * m_view), visibleShapes, shapeCullStats);
+        // Shapes are blended, so keep them in scene order
+        std::sort(visibleShapes.begin(), visibleShapes.end());
+    }
+    else {
+        for (size_t i = 0; i < sceneShapeCount; i++) {
+            visibleShapes.push_back(std::uint32_t(i));
         }
+        shapeCullStats = CullStats();
+        shapeCullStats.visible = sceneShapeCount;
     }
 
-    int currentIndex = 0;
-    for (const auto& shapeData : shapeDataList) {
-        // Record the starting index of this shape.
-        shapeStartIndices.push_back(currentIndex / 8);
+    // Scene shapes only move when the scene is edited, so their instances are rebuilt and uploaded
+    // only when that happened or a different set of them became visible
+    if (sceneInstancesStale || visibleShapes != batchedShapes) {
+        // Shape 0 is never drawn, only its material is used
+        std::vector<GeometryRange> ranges;
+        std::vector<glm::mat4> modelMatrices;
+        std::vector<int> materialIds;
+        ranges.reserve(visibleShapes.size());
+        modelMatrices.reserve(visibleShapes.size());
+        materialIds.reserve(visibleShapes.size());
+        for (std::uint32_t shape : visibleShapes) {
+            if (shape != 0) {
+                ranges.push_back(shapeRanges[shape]);
+                modelMatrices.push_back(modelMatrixList[shape]);
+                materialIds.push_back(shapeMaterialIds[shape]);
+            }
+        }
+        instanceBatcher.build(ranges, modelMatrices, materialIds);
+        instanceBatcher.upload(m_instance_vbo);
+        batchedShapes = visibleShapes;
+        sceneInstancesStale = false;
+    }
 
-        // Append all the data from this shape to the VBO data.
-        vboData.insert(vboData.end(), shapeData.begin(), shapeData.end());
+    // With frame timings on, also log how much was culled when it changes, at most once a second
+    if (settings.frameTimings && settings.frustumCulling && shapeCullStats.visible != reportedVisibleShapes &&
+        (!cullReportTimer.isValid() || cullReportTimer.elapsed() >= 1000)) {
+        std::cout << "Frustum culling: " << shapeCullStats.visible << " of " << sceneShapeCount << " scene shapes visible, "
+                  << shapeCullStats.culled << " culled (" << shapeCullStats.nodesVisited << " BVH nodes visited)" << std::endl;
+        reportedVisibleShapes = shapeCullStats.visible;
+        cullReportTimer.restart();
+    }
+}
 
-        // Record the size (in elements) of this shape.
-        shapeSizes.push_back(static_cast<int>(shapeData.size() / 8));
+// Falling snowflakes all move every tick, so this frame's instances are written to the next ring region
+void Realtime::paintSnowflakes() {
+    useProgram(m_shader);
+    stateCache.bindVertexArray(m_vao);
+    stateCache.setBlend(true);
+    stateCache.bindTexture(3, frameShapeTexture);
+
+    const std::vector<glm::mat4> &particleModels = particles->getModel();
+    snowflakeInstances.resize(particleModels.size());
+    for (size_t i = 0; i < particleModels.size(); i++) {
+        snowflakeInstances[i].modelMatrix = particleModels[i];
+        snowflakeInstances[i].normalMatrix = glm::transpose(glm::inverse(glm::mat3(particleModels[i])));
+    }
+    if (!snowflakeInstances.empty()) {
+        size_t offset = snowflakeStream.write(snowflakeInstances.data(), snowflakeInstances.size() * sizeof(InstanceData));
+        InstanceBatcher::bindInstances(snowflakeStream.buffer(), 0, offset);
+        drawGeometryRange(snowflakeRange, 0, GLsizei(snowflakeInstances.size()));
+    }
+}
 
-        // Update the current index for the next shape.
-        currentIndex += shapeData.size();
+// Accumulated snowflakes stay put once landed, so only the ones added since the last frame are uploaded
+void Realtime::paintAccumulatedSnowflakes() {
+    useProgram(m_shader);
+    stateCache.bindVertexArray(m_vao);
+    stateCache.setBlend(true);
+    stateCache.bindTexture(3, frameShapeTexture);
+
+    for (size_t i = accumulatedInstances.size(); i < size_t(staticParticleNum); i++) {
+        InstanceData instance;
+        instance.modelMatrix = staticMatrixList[i];
+        instance.normalMatrix = glm::transpose(glm::inverse(glm::mat3(staticMatrixList[i])));
+        accumulatedInstances.push_back(instance);
+    }
+    if (accumulatedInstances.empty()) {
+        return;
     }
+    // uploadTail binds the buffer as a copy target, which leaves the cached state alone
+    uploadTail(m_accumulated_vbo, accumulatedInstances.data(), accumulatedInstances.size() * sizeof(InstanceData),
+               accumulatedUploadedBytes, accumulatedCapacityBytes);
+    InstanceBatcher::bindInstances(m_accumulated_vbo, 0);
+    drawGeometryRange(snowflakeRange, 0, GLsizei(accumulatedInstances.size()));
 }
 
 void Realtime::setupTerrainData() {
-    int shapeParameter1 = settings.bumpiness;
-    int shapeParameter2 = settings.shapeParameter2;
-
-    terrainData = terrainGenerator.generateTerrain(QString::fromStdString(settings.heightMapPath), settings.bumpiness);
+    QString heightMapPath = QString::fromStdString(settings.heightMapPath);
+    int resolution = terrainGenerator.getResolution();
+
+    // The heightmap is needed even on a cache hit, since collision queries sample it through getHeight()
+    terrainGenerator.loadHeightMap(heightMapPath);
+
+    if (terrainCache.load(heightMapPath, settings.bumpiness, resolution)) {
+        terrainVertices = std::span<const float>(terrainCache.data(), terrainCache.floatCount());
+    } else {
+        terrainData = terrainGenerator.generateTerrain(settings.bumpiness);
+        terrainCache.store(heightMapPath, settings.bumpiness, resolution, terrainData);
+        terrainVertices = terrainData;
+    }
     terrainModelMatrix = glm::mat4(1);
 
-    terrainVboData = terrainData;
     terrainStartIndex = 0;
-    terrainSize = terrainData.size() / 8;
+    terrainSize = terrainVertices.size() / 8;
 
     matrixData = std::vector<GLuint>(100 * 100, 0);
 }
@@ -1080,12 +1439,52 @@ std::vector<float> Realtime::calculateDistanceFactors() {
     return distanceFactors;
 }
 
+// Meshes switch to a coarser level of detail as they shrink on screen; a batch uses the finest level any of its instances needs
+int Realtime::batchLodLevel(const InstanceBatch &batch) const {
+    if (!settings.extraCredit2 || batch.range.lodCount == 0) {
+        return 0;
+    }
+    const std::vector<InstanceData> &instances = instanceBatcher.instances();
+    int lod = batch.range.lodCount;
+    for (GLint i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount && lod > 0; i++) {
+        lod = std::min(lod, meshLodLevel(batch.range, instances[i].modelMatrix));
+    }
+    return lod;
+}
+
+// Level of detail for a mesh from the projected height of its bounding sphere. Full detail is kept while the
+// mesh covers at least fullDetailPixels; every halving below that moves one level coarser, which roughly
+// halves the triangles while the covered area drops to a quarter.
+int Realtime::meshLodLevel(const GeometryRange &range, const glm::mat4 &modelMatrix) const {
+    if (range.lodCount == 0) {
+        return 0;
+    }
+    const float fullDetailPixels = 512.f;
+
+    float scale = std::max({glm::length(glm::vec3(modelMatrix[0])),
+                            glm::length(glm::vec3(modelMatrix[1])),
+                            glm::length(glm::vec3(modelMatrix[2]))});
+    float radius = range.boundingRadius * scale;
+    float depth = -(m_view * modelMatrix * glm::vec4(0, 0, 0, 1)).z;
+    if (depth <= radius) {
+        return 0;
+    }
+
+    // m_proj[1][1] is cot(fovy / 2), so this is the diameter as a fraction of the viewport height times its pixels
+    float pixels = radius * m_proj[1][1] / depth * m_screen_height;
+    if (pixels >= fullDetailPixels) {
+        return 0;
+    }
+    int level = int(std::log2(fullDetailPixels / std::max(pixels, 1.f)));
+    return std::min(level, range.lodCount);
+}
+
 void Realtime::resetScene() {
     metaData.lights.clear();
     metaData.shapes.clear();
 
-    // Clear all the shape data.
-    shapeDataList.clear();
+    // Drop all cached geometry, its GL buffer is recreated by initializeGL()
+    geometryCache.clear();
 
     // Clear the model matrix list and reset each matrix to identity.
     modelMatrixList.clear();
@@ -1094,10 +1493,12 @@ void Realtime::resetScene() {
     m_view = glm::mat4(1.0f);
     m_proj = glm::mat4(1.0f);
 
-    // Clear VBO data and related vectors.
-    vboData.clear();
-    shapeStartIndices.clear();
-    shapeSizes.clear();
+    // Clear the draw ranges, and the BVH over the shapes' bounds.
+    shapeRanges.clear();
+    shapeBvh.clear();
+    shapeBvhStale = true;
+    batchedShapes.clear();
+    sceneInstancesStale = true;
 
     timeTracker = 0;
     snowTimer = 0;
@@ -1189,17 +1590,22 @@ void Realtime::timerEvent(QTimerEvent *event) {
     int elapsedms   = m_elapsedTimer.elapsed();
 //    std::cout<<elapsedms<<std::endl;
     float deltaTime = elapsedms * 0.001f;
+    m_elapsedTimer.restart();
+
+    advance(deltaTime);
+    update(); // asks for a PaintGL() call to occur
+}
 
+// Steps the snow simulation and the key-driven camera by deltaTime seconds
+void Realtime::advance(float deltaTime) {
     if (settings.sceneFilePath!="") {
+        FrameProfiler::CpuScope scope(frameProfiler, "simulation");
         particles->update_ParticleSystem(deltaTime);
-        setupShapesGL();
         //        update_particle_vbo();
 
     }
     //
 
-    m_elapsedTimer.restart();
-
     // Use deltaTime and m_keyMap here to move around
     if (m_keyMap[Qt::Key_W]) {
         metaData.cameraData.pos += deltaTime * metaData.cameraData.look;
@@ -1223,77 +1629,92 @@ void Realtime::timerEvent(QTimerEvent *event) {
     }
 
     // Update scene data
+    FrameProfiler::CpuScope scope(frameProfiler, "camera");
     renderScene.updateCamera(settings.nearPlane, settings.farPlane, metaData);
 
     // Update camera data from the scene
     m_view = renderScene.sceneCamera.getViewMatrix();
     m_proj = renderScene.sceneCamera.getProjectMatrix();
-
-    update(); // asks for a PaintGL() call to occur
 }
 
-// DO NOT EDIT
-void Realtime::saveViewportImage(std::string filePath) {
-    // Make sure we have the right context and everything has been drawn
-    makeCurrent();
+// ********************************* Offscreen *********************************
+// The widget is never shown in offscreen runs, so its own context never exists and makeCurrent and
+// doneCurrent do nothing; the caller's context stays current throughout.
+bool Realtime::initializeOffscreen(int width, int height) {
+    resize(width, height);
 
-    int fixedWidth = 1024;
-    int fixedHeight = 768;
-
-    // Create Frame Buffer
-    GLuint fbo;
-    glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-    // Create a color attachment texture
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, fixedWidth, fixedHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
-
-    // Optional: Create a depth buffer if your rendering uses depth testing
-    GLuint rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, fixedWidth, fixedHeight);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo);
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Error: Framebuffer is not complete!" << std::endl;
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        return;
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        std::cerr << "Error while initializing GL for offscreen rendering" << std::endl;
+        return false;
     }
 
-    // Render to the FBO
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glViewport(0, 0, fixedWidth, fixedHeight);
+    // Stands in for the widget's framebuffer: paintFrame draws the final image here
+    glGenFramebuffers(1, &m_offscreen_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_offscreen_fbo);
+    glGenRenderbuffers(2, m_offscreen_renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_offscreen_renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_offscreen_renderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_offscreen_renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_offscreen_renderbuffers[1]);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        std::cerr << "Error: Offscreen framebuffer is not complete!" << std::endl;
+        return false;
+    }
 
-    // Clear and render your scene here
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    initializeGL();
+    resizeGL(width, height);
+    return true;
+}
+
+// The benchmark camera stays where the scene file puts it and turns once about the world up axis
+// over the run, so every direction gets drawn and culled.
+void Realtime::renderOffscreenFrame(float pathPosition, float deltaTime) {
+    glm::mat4 turn = glm::rotate(glm::two_pi<float>() * pathPosition, glm::vec3(0.f, 1.f, 0.f));
+    metaData.cameraData.pos = loadedScene.cameraData.pos;
+    metaData.cameraData.look = turn * loadedScene.cameraData.look;
+    metaData.cameraData.up = loadedScene.cameraData.up;
+
+    advance(deltaTime);
     paintGL();
+}
 
-    // Read pixels from framebuffer
-    std::vector<unsigned char> pixels(fixedWidth * fixedHeight * 3);
-    glReadPixels(0, 0, fixedWidth, fixedHeight, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+QImage Realtime::grabOffscreenFrame() {
+    std::vector<unsigned char> pixels(m_screen_width * m_screen_height * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_offscreen_fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, m_screen_width, m_screen_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 
-    // Unbind the framebuffer to return to default rendering to the screen
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // GL rows run bottom to top
+    QImage image(pixels.data(), m_screen_width, m_screen_height, QImage::Format_RGBA8888);
+    return image.mirrored();
+}
 
-    // Convert to QImage
-    QImage image(pixels.data(), fixedWidth, fixedHeight, QImage::Format_RGB888);
-    QImage flippedImage = image.mirrored(); // Flip the image vertically
+// Captures the frame the widget last drew, scaled to the fixed 1024x768 output. The readback and
+// PNG encode complete over the next few frames, without holding up rendering.
+void Realtime::saveViewportImage(std::string filePath) {
+    // Make sure we have the right context
+    makeCurrent();
+    viewportCapture.capture(m_defaultFBO, m_screen_width, m_screen_height, 1024, 768, QString::fromStdString(filePath));
+    update(); // Later frames poll the capture
+}
 
-    // Save to file using Qt
-    QString qFilePath = QString::fromStdString(filePath);
-    if (!flippedImage.save(qFilePath)) {
-        std::cerr << "Failed to save image to " << filePath << std::endl;
+// Saves every frame drawn from now on into directory, or stops recording if it is empty
+void Realtime::setRecordingDirectory(std::string directory) {
+    recordingDirectory = QString::fromStdString(directory);
+    recordedFrames = 0;
+    if (directory.empty()) {
+        std::cout << "Stopped recording frames." << std::endl;
+    }
+    else {
+        std::cout << "Recording frames to \"" << directory << "\"." << std::endl;
     }
-
-    // Clean up
-    glDeleteTextures(1, &texture);
-    glDeleteRenderbuffers(1, &rbo);
-    glDeleteFramebuffers(1, &fbo);
 }
 //void Realtime::paintParticle() {
 
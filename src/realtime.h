@@ -7,19 +7,36 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include <cstdint>
+#include <span>
 #include <unordered_map>
 #include <QElapsedTimer>
+#include <QFileSystemWatcher>
+#include <QLabel>
 #include <QOpenGLWidget>
 #include <QTime>
 #include <QTimer>
 
 #include "render/renderscene.h"
+#include "render/bvh.h"
+#include "render/frameprofiler.h"
+#include "render/geometrycache.h"
+#include "render/indirectdrawlist.h"
+#include "render/instancebatcher.h"
+#include "render/lightbuffer.h"
+#include "render/lightclusters.h"
+#include "render/renderqueue.h"
+#include "render/statecache.h"
+#include "render/viewportcapture.h"
+#include "render/streambuffer.h"
+#include "utils/scenediff.h"
 #include "shapes/sphere.h"
 #include "shapes/cube.h"
 #include "shapes/cone.h"
 #include "shapes/cylinder.h"
 #include "shapes/mesh.h"
 #include "shapes/terrain.h"
+#include "shapes/terraincache.h"
 #include "settings.h"
 #include "shapes/particle.h"
 #include "shapes/square.h"
@@ -31,6 +48,14 @@ public:
     void sceneChanged();
     void settingsChanged();
     void saveViewportImage(std::string filePath);
+    void setRecordingDirectory(std::string directory);
+    void saveFrameTimings(std::string filePath);     // Writes the rolling stage timings as CSV
+
+    // Offscreen runs (see headless.h) render with the caller's context current, into a framebuffer of
+    // the given size instead of the widget's
+    bool initializeOffscreen(int width, int height);
+    void renderOffscreenFrame(float pathPosition, float deltaTime); // pathPosition in [0, 1) along the benchmark camera path
+    QImage grabOffscreenFrame();
 
 public slots:
     void tick(QTimerEvent* event);                      // Called once per tick of m_timer
@@ -43,34 +68,135 @@ protected:
 private:
     // ======= GL-related
     void setupShapesGL();
+    void uploadShapeGeometry();
     void setupTerrainGL();
 
+    // Uniform locations of each program, looked up once after it is linked
+    struct ShapeUniforms {
+        GLint viewMatrix, projectMatrix;
+        GLint ka, kd, ks, shininess;
+        GLint cAmbient, cDiffuse, cSpecular;
+        GLint isTexture, cameraWorldSpacePos;
+        GLint snowTimer, sunTimer;
+    };
+    struct TerrainUniforms {
+        GLint modelMatrix, normalMatrix, viewMatrix, projectMatrix;
+        GLint ka, kd, ks;
+        GLint isTexture, cameraWorldSpacePos;
+        GLint isIncrease, accumulateRate;
+        GLint snowTimer, sunTimer;
+    };
+    struct FrameUniforms {
+        GLint gradientStartColor, gradientEndColor;
+        GLint isPerPixelFilter, isKernelFilter, isFXAA;
+        GLint screenWidth, screenHeight;
+    };
+    ShapeUniforms m_shader_uniforms;
+    TerrainUniforms m_terrain_uniforms;
+    FrameUniforms m_frame_uniforms;
+
+    LightBuffer lightBuffer; // Directional scene lights and the sun, read by the shape and terrain programs
+    LightClusters lightClusters; // Point and spot lights, binned per view cluster
+
+    void setupUniforms();
+
+    // ======= Render queue
+    // What a RenderItem draws; for ShapeBatch its index picks the instance batch
+    enum class DrawKind : std::uint32_t { Terrain, ShapeBatch, Snowflakes, AccumulatedSnowflakes };
+    // Small ids for the sort keys
+    static const std::uint32_t TerrainProgramId = 0;
+    static const std::uint32_t ShapeProgramId = 1;
+    static const std::uint32_t TerrainTextureId = 0;
+    static const std::uint32_t ShapeTextureId = 1;
+    static const std::uint32_t SnowflakeMaterialId = 0xFFFF;
+
+    RenderQueue renderQueue;
+    StateCache stateCache;
+    GLuint frameTerrainTexture = 0; // Looked up once per frame, before the state cache is reset
+    GLuint frameShapeTexture = 0;
+
+    void queueDraws();
+    void submitDraws();
+    void useProgram(GLuint program);
+    void setShapeUniforms();
+    void setTerrainUniforms();
+
+    // ======= Frame timings
+    FrameProfiler frameProfiler; // Enabled by settings.frameTimings
+    QLabel *profilerOverlay;
+    QElapsedTimer profilerOverlayTimer;
+
+    void updateProfilerOverlay();
+
     // ======= Shapes-related
     GLuint m_shader; // Stores id of main shader program - default.vert/.frag
     GLuint m_vbo; // Stores id of vbo
+    GLuint m_ebo = 0; // Stores id of the index buffer shared by all cached primitives
     GLuint m_vao; // Stores id of vao
 
-    QImage m_image; // Texture image
-    GLuint m_texture; // Stores id of geometry texture mapping
+    QString m_shape_texture_path; // Geometry texture image, owned by the TextureManager
 
     RenderData metaData; // Parsed scene data by scene paser
     RenderScene renderScene;
 
-    std::vector<std::vector<float>> shapeDataList;
-    std::vector<glm::mat4> modelMatrixList;
+    std::vector<glm::mat4> modelMatrixList; // Per scene shape
     glm::mat4 m_view  = glm::mat4(1);
     glm::mat4 m_proj  = glm::mat4(1);
 
-    std::vector<float> vboData; // Flat vector to store all the vertices and normals for the VBO.
-    std::vector<int> shapeStartIndices; // Vector to store the starting index of each shape in the VBO.
-    std::vector<int> shapeSizes; // Vector to store the number of elements (vertices+normals) of each shape.
+    GeometryCache geometryCache; // Owns the VBO contents, one tessellated copy per distinct primitive
+    static constexpr size_t maxLodCacheEntries = 256; // Distance LOD rebuilds the cache past this many, or 4x the scene's shapes
+    std::vector<GeometryRange> shapeRanges; // Shared VBO/EBO range drawn for each scene shape
+    std::vector<int> shapeMaterialIds; // Scene shapes with equal ids have identical materials
+    std::vector<SceneMaterial> shapeMaterials; // Distinct materials, indexed by material id
+    std::unordered_map<size_t, std::vector<int>> shapeMaterialBuckets; // Material ids by hashMaterial
+    bool shapeDataStale = true; // A setting that affects tessellation changed, so setupShapesGL runs before the next draw
+
+    GLuint m_instance_vbo = 0; // Per-instance model and normal matrices of the visible scene shapes, grouped by batch
+    InstanceBatcher instanceBatcher;
+    std::vector<std::uint32_t> batchedShapes; // visibleShapes as of the last upload to m_instance_vbo
+    bool sceneInstancesStale = true; // The scene shapes changed since that upload
+
+    GLuint m_indirect_buffer = 0; // Draw commands for the scene batches, when multi-draw indirect is available
+    IndirectDrawList indirectDraws;
+    bool useIndirectDraws = false;
+
+    // Snowflakes share one square and are drawn after the scene shapes. Falling ones all move every
+    // tick and go through a stream ring; accumulated ones never move, so only new ones are appended.
+    GeometryRange snowflakeRange;
+    StreamBuffer snowflakeStream;
+    std::vector<InstanceData> snowflakeInstances;
+    GLuint m_accumulated_vbo = 0;
+    std::vector<InstanceData> accumulatedInstances;
+    size_t accumulatedUploadedBytes = 0;
+    size_t accumulatedCapacityBytes = 0;
+
+    // Over the world-space bounds of the scene shapes; snowflakes aren't in it and are always drawn
+    Bvh shapeBvh;
+    std::vector<Aabb> shapeBounds;
+    bool shapeBvhStale = true; // The scene shapes were replaced, so the tree is rebuilt
+    bool shapeBoundsStale = false; // Only their transforms changed, so the tree is refit
+    std::vector<std::uint32_t> visibleShapes; // Indices into shapeRanges drawn this frame
+    CullStats shapeCullStats;
+    size_t reportedVisibleShapes = SIZE_MAX;
+    QElapsedTimer cullReportTimer;
 
     void generateScreen();
     void setupShapeData();
+    bool applyShapeDiff(const SceneDiff &diff);
+    glm::ivec2 shapeParameters() const;
+    GeometryKey shapeGeometryKey(const RenderShapeData &shape, int param1, int param2) const;
+    int shapeMaterialId(const SceneMaterial &material);
+    Aabb shapeWorldBounds(size_t shape) const;
     void setupLightData();
     std::vector<float> calculateDistanceFactors();
+    int batchLodLevel(const InstanceBatch &batch) const;
+    int meshLodLevel(const GeometryRange &range, const glm::mat4 &modelMatrix) const;
     void resetScene();
-    void paintGeometry();
+    void updateShapeBvh();
+    void cullShapes();
+    void paintShapeBatches(const RenderItem *first, const RenderItem *last);
+    void paintSnowflakes();
+    void paintAccumulatedSnowflakes();
 
     int shapeParameter1Saved = settings.bumpiness;
 
@@ -92,23 +218,22 @@ private:
     QImage m_particle_image; // Texture image for terrain
 
     int staticParticleNum = 0;
-    std::vector<std::vector<float>> staticShapeDataList;
-    std::vector<glm::mat4> staticMatrixList;
+    std::vector<glm::mat4> staticMatrixList; // Accumulated snowflakes, drawn with the shared square geometry
 
     // ====== Terrain-related
     GLuint m_terrain_shader; // Stores id of terrain shader program - terrain.vert/.frag
     GLuint m_terrain_vbo; // Stores id of terrain vbo
     GLuint m_terrain_vao; // Stores id of terrain vao
 
-    std::vector<float> terrainData;
+    std::vector<float> terrainData; // Only filled when the terrain had to be generated
     glm::mat4 terrainModelMatrix;
 
-    std::vector<float> terrainVboData;
+    std::span<const float> terrainVertices; // Either terrainData or a mapped TerrainCache entry, valid until upload
+    TerrainCache terrainCache;
     int terrainStartIndex;
     int terrainSize;
 
-    QImage m_terrain_image; // Texture image for terrain
-    GLuint m_terrain_texture; // Stores id of geometry texture mapping
+    QString m_terrain_texture_path; // Terrain texture image, owned by the TextureManager
 
     TerrainGenerator terrainGenerator;
     GLuint m_collision_texture; // Store id of collision map
@@ -138,8 +263,18 @@ private:
     void setSunlightDirectionAccordingToTime();
     void updateSunlight(glm::vec4 originalDirection);
 
+    // ======= Scene hot reload
+    RenderData loadedScene; // The scene file as last parsed, which reloads are diffed against
+    QFileSystemWatcher sceneWatcher;
+    QTimer sceneReloadTimer; // Coalesces the several change signals a single save can produce
+
+    void watchSceneFile();
+    void reloadScene();
+
     // ======= Frame-related
     GLuint m_defaultFBO;
+    GLuint m_offscreen_fbo = 0; // Replaces the widget's framebuffer in offscreen runs
+    GLuint m_offscreen_renderbuffers[2] = {0, 0}; // Color, depth-stencil
     int m_fbo_width;
     int m_fbo_height;
     int m_screen_width;
@@ -155,6 +290,11 @@ private:
     void makeFBO();
     void paintFrame(GLuint texture);
 
+    // ======= Capture
+    ViewportCapture viewportCapture;
+    QString recordingDirectory; // Every frame is saved here while it isn't empty
+    int recordedFrames = 0;
+
     // ======= Others
     void keyPressEvent(QKeyEvent *event) override;
     void keyReleaseEvent(QKeyEvent *event) override;
@@ -162,6 +302,7 @@ private:
     void mouseReleaseEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void timerEvent(QTimerEvent *event) override;
+    void advance(float deltaTime);
 
     // Tick Related Variables
     int m_timer;                                        // Stores timer which attempts to run ~60 times per second
@@ -0,0 +1,339 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <QThread>
+#include <QtConcurrent>
+
+namespace {
+
+const int binCount = 12;
+const std::uint32_t maxLeafSize = 8;
+// Nodes smaller than this aren't worth handing to another thread
+const std::uint32_t minParallelSize = 4096;
+// Relative to testing one box, for the surface area heuristic
+const float traversalCost = 1.f;
+
+struct BuildState {
+    const std::vector<Aabb> &bounds;
+    std::vector<glm::vec3> centers;
+    std::vector<Bvh::Node> &nodes;
+    std::vector<std::uint32_t> &indices;
+    std::atomic<std::uint32_t> nodeCount{1};
+};
+
+struct Bin {
+    Aabb bounds;
+    std::uint32_t count = 0;
+};
+
+// Splits node in two, or turns it into a leaf when that is cheaper. Returns whether it was split.
+bool splitNode(BuildState &state, std::uint32_t nodeIndex) {
+    Bvh::Node &node = state.nodes[nodeIndex];
+    std::uint32_t *first = state.indices.data() + node.first;
+    std::uint32_t *last = first + node.count;
+
+    Aabb centerBounds;
+    node.bounds = Aabb();
+    for (std::uint32_t *index = first; index != last; index++) {
+        node.bounds.grow(state.bounds[*index]);
+        centerBounds.grow(state.centers[*index]);
+    }
+    if (node.count <= 2) {
+        return false;
+    }
+
+    // Bin the centers along all three axes in one pass, then sweep each axis for the cheapest split plane
+    glm::vec3 extent = centerBounds.max - centerBounds.min;
+    glm::vec3 scale = glm::vec3(float(binCount)) / glm::max(extent, glm::vec3(std::numeric_limits<float>::min()));
+    std::array<std::array<Bin, binCount>, 3> bins;
+    for (std::uint32_t *index = first; index != last; index++) {
+        glm::ivec3 bin = glm::min(glm::ivec3((state.centers[*index] - centerBounds.min) * scale), glm::ivec3(binCount - 1));
+        for (int axis = 0; axis < 3; axis++) {
+            bins[axis][bin[axis]].bounds.grow(state.bounds[*index]);
+            bins[axis][bin[axis]].count++;
+        }
+    }
+
+    float leafCost = float(node.count);
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1;
+    int bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        if (extent[axis] <= 0.f) {
+            continue;
+        }
+
+        // Right-to-left pass for the area and count right of each plane, then left-to-right to price it
+        std::array<float, binCount> rightCost;
+        Aabb right;
+        std::uint32_t rightCount = 0;
+        for (int bin = binCount - 1; bin > 0; bin--) {
+            right.grow(bins[axis][bin].bounds);
+            rightCount += bins[axis][bin].count;
+            rightCost[bin] = rightCount > 0 ? right.surfaceArea() * rightCount : 0.f;
+        }
+        Aabb left;
+        std::uint32_t leftCount = 0;
+        for (int split = 1; split < binCount; split++) {
+            left.grow(bins[axis][split - 1].bounds);
+            leftCount += bins[axis][split - 1].count;
+            float cost = (leftCount > 0 ? left.surfaceArea() * leftCount : 0.f) + rightCost[split];
+            if (leftCount > 0 && leftCount < node.count && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    std::uint32_t *middle;
+    if (bestAxis >= 0) {
+        float area = node.bounds.surfaceArea();
+        bestCost = area > 0.f ? traversalCost + bestCost / area : leafCost;
+        if (bestCost >= leafCost && node.count <= maxLeafSize) {
+            return false;
+        }
+        float axisScale = scale[bestAxis];
+        float minimum = centerBounds.min[bestAxis];
+        middle = std::partition(first, last, [&](std::uint32_t index) {
+            return std::min(binCount - 1, int((state.centers[index][bestAxis] - minimum) * axisScale)) < bestSplit;
+        });
+    }
+    else {
+        // Every center coincides, so no plane separates them; halve by count to keep leaves small
+        if (node.count <= maxLeafSize) {
+            return false;
+        }
+        middle = first + node.count / 2;
+    }
+
+    std::uint32_t children = state.nodeCount.fetch_add(2);
+    Bvh::Node &leftChild = state.nodes[children];
+    Bvh::Node &rightChild = state.nodes[children + 1];
+    leftChild.first = node.first;
+    leftChild.count = std::uint32_t(middle - first);
+    rightChild.first = node.first + leftChild.count;
+    rightChild.count = node.count - leftChild.count;
+    node.first = children;
+    node.count = 0;
+    return true;
+}
+
+void buildSubtree(BuildState &state, std::uint32_t root) {
+    // Lopsided splits can make the tree deep, so this keeps its own stack rather than recursing
+    std::vector<std::uint32_t> stack = {root};
+    while (!stack.empty()) {
+        std::uint32_t node = stack.back();
+        stack.pop_back();
+        if (splitNode(state, node)) {
+            stack.push_back(state.nodes[node].first);
+            stack.push_back(state.nodes[node].first + 1);
+        }
+    }
+}
+
+// Whether box is entirely outside one of the planes in planeMask. Otherwise clears from the mask
+// the planes box is entirely inside of.
+bool outsideFrustum(const Frustum &frustum, const Aabb &box, std::uint32_t &planeMask) {
+    for (int p = 0; p < 6; p++) {
+        if (!(planeMask & (1u << p))) {
+            continue;
+        }
+        const glm::vec4 &plane = frustum.planes[p];
+        glm::vec3 normal(plane);
+        // The corners farthest along and against the plane normal
+        glm::bvec3 facing = glm::greaterThanEqual(normal, glm::vec3(0.f));
+        glm::vec3 positive = glm::mix(box.min, box.max, facing);
+        glm::vec3 negative = glm::mix(box.max, box.min, facing);
+        if (glm::dot(normal, positive) + plane.w < 0.f) {
+            return true;
+        }
+        if (glm::dot(normal, negative) + plane.w >= 0.f) {
+            planeMask &= ~(1u << p);
+        }
+    }
+    return false;
+}
+
+}
+
+Aabb transformAabb(const glm::mat4 &matrix, const Aabb &local) {
+    // Arvo's method: the center moves with the matrix, the half extents with its absolute value
+    glm::vec3 center = glm::vec3(matrix * glm::vec4(local.center(), 1.f));
+    glm::vec3 halfExtent = (local.max - local.min) * 0.5f;
+    glm::mat3 linear(matrix);
+    glm::vec3 extent = glm::abs(linear[0]) * halfExtent.x + glm::abs(linear[1]) * halfExtent.y + glm::abs(linear[2]) * halfExtent.z;
+
+    Aabb world;
+    world.min = center - extent;
+    world.max = center + extent;
+    return world;
+}
+
+Frustum Frustum::fromViewProjection(const glm::mat4 &m) {
+    // glm is column-major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    auto row = [&m](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+    Frustum frustum;
+    frustum.planes[0] = row(3) + row(0); // Left
+    frustum.planes[1] = row(3) - row(0); // Right
+    frustum.planes[2] = row(3) + row(1); // Bottom
+    frustum.planes[3] = row(3) - row(1); // Top
+    frustum.planes[4] = row(3) + row(2); // Near
+    frustum.planes[5] = row(3) - row(2); // Far
+    return frustum;
+}
+
+void Bvh::clear() {
+    m_nodes.clear();
+    m_indices.clear();
+    m_leafBounds.clear();
+    m_parents.clear();
+    m_leafOf.clear();
+    m_slotOf.clear();
+}
+
+void Bvh::build(const std::vector<Aabb> &bounds) {
+    clear();
+    if (bounds.empty()) {
+        return;
+    }
+
+    m_indices.resize(bounds.size());
+    std::iota(m_indices.begin(), m_indices.end(), 0u);
+    m_nodes.resize(2 * bounds.size() - 1);
+    m_nodes[0].count = std::uint32_t(bounds.size());
+
+    BuildState state{bounds, {}, m_nodes, m_indices};
+    state.centers.resize(bounds.size());
+    for (size_t i = 0; i < bounds.size(); i++) {
+        state.centers[i] = bounds[i].center();
+    }
+
+    // Split the top levels here until there are enough large independent subtrees to keep every
+    // worker busy; subtrees own disjoint slices of m_indices, so they can then be built in parallel
+    size_t targetSubtrees = 4 * size_t(std::max(QThread::idealThreadCount(), 1));
+    std::vector<std::uint32_t> frontier = {0};
+    std::vector<std::uint32_t> subtrees;
+    while (!frontier.empty() && frontier.size() + subtrees.size() < targetSubtrees) {
+        std::vector<std::uint32_t> next;
+        for (std::uint32_t node : frontier) {
+            if (m_nodes[node].count < minParallelSize) {
+                subtrees.push_back(node);
+            }
+            else if (splitNode(state, node)) {
+                next.push_back(m_nodes[node].first);
+                next.push_back(m_nodes[node].first + 1);
+            }
+        }
+        frontier = std::move(next);
+    }
+    subtrees.insert(subtrees.end(), frontier.begin(), frontier.end());
+
+    QtConcurrent::blockingMap(subtrees, [&state](std::uint32_t node) {
+        buildSubtree(state, node);
+    });
+    m_nodes.resize(state.nodeCount);
+
+    m_leafBounds.resize(bounds.size());
+    for (size_t i = 0; i < m_indices.size(); i++) {
+        m_leafBounds[i] = bounds[m_indices[i]];
+    }
+
+    // Links for the partial refit to walk from a box up to the root
+    m_parents.assign(m_nodes.size(), 0);
+    m_leafOf.resize(bounds.size());
+    m_slotOf.resize(bounds.size());
+    for (std::uint32_t i = 0; i < m_nodes.size(); i++) {
+        const Node &node = m_nodes[i];
+        if (node.count > 0) {
+            for (std::uint32_t j = node.first; j < node.first + node.count; j++) {
+                m_leafOf[m_indices[j]] = i;
+                m_slotOf[m_indices[j]] = j;
+            }
+        }
+        else {
+            m_parents[node.first] = i;
+            m_parents[node.first + 1] = i;
+        }
+    }
+}
+
+void Bvh::refit(const std::vector<Aabb> &bounds) {
+    // Children come after their parents, so a backwards sweep sees every child before its parent
+    for (size_t i = m_nodes.size(); i-- > 0;) {
+        Node &node = m_nodes[i];
+        node.bounds = Aabb();
+        if (node.count > 0) {
+            for (std::uint32_t j = node.first; j < node.first + node.count; j++) {
+                m_leafBounds[j] = bounds[m_indices[j]];
+                node.bounds.grow(m_leafBounds[j]);
+            }
+        }
+        else {
+            node.bounds.grow(m_nodes[node.first].bounds);
+            node.bounds.grow(m_nodes[node.first + 1].bounds);
+        }
+    }
+}
+
+void Bvh::refit(const std::vector<Aabb> &bounds, const std::vector<std::uint32_t> &changed) {
+    for (std::uint32_t box : changed) {
+        m_leafBounds[m_slotOf[box]] = bounds[box];
+        std::uint32_t index = m_leafOf[box];
+        Node &leaf = m_nodes[index];
+        leaf.bounds = Aabb();
+        for (std::uint32_t j = leaf.first; j < leaf.first + leaf.count; j++) {
+            leaf.bounds.grow(m_leafBounds[j]);
+        }
+        // Boxes that share ancestors refit them more than once, which still beats a full sweep for a few boxes
+        while (index != 0) {
+            index = m_parents[index];
+            Node &node = m_nodes[index];
+            node.bounds = m_nodes[node.first].bounds;
+            node.bounds.grow(m_nodes[node.first + 1].bounds);
+        }
+    }
+}
+
+void Bvh::cull(const Frustum &frustum, std::vector<std::uint32_t> &visible, CullStats &stats) const {
+    size_t visibleBefore = visible.size();
+    stats.nodesVisited = 0;
+
+    // Each entry carries the planes its box still straddles; a box inside a plane has all its
+    // descendants inside it too, so that plane is never tested again below it
+    struct Entry {
+        std::uint32_t node;
+        std::uint32_t planeMask;
+    };
+    std::vector<Entry> stack;
+    if (!m_nodes.empty()) {
+        stack.push_back({0, (1u << 6) - 1});
+    }
+    while (!stack.empty()) {
+        Entry entry = stack.back();
+        stack.pop_back();
+        const Node &node = m_nodes[entry.node];
+        stats.nodesVisited++;
+
+        if (outsideFrustum(frustum, node.bounds, entry.planeMask)) {
+            continue;
+        }
+
+        if (node.count == 0) {
+            stack.push_back({node.first, entry.planeMask});
+            stack.push_back({node.first + 1, entry.planeMask});
+            continue;
+        }
+        for (std::uint32_t i = node.first; i < node.first + node.count; i++) {
+            std::uint32_t planeMask = entry.planeMask;
+            if (planeMask == 0 || !outsideFrustum(frustum, m_leafBounds[i], planeMask)) {
+                visible.push_back(m_indices[i]);
+            }
+        }
+    }
+
+    stats.visible = visible.size() - visibleBefore;
+    stats.culled = m_indices.size() - stats.visible;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Axis-aligned box; a default-constructed one is empty and grows to fit whatever is added
+struct Aabb {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    void grow(const glm::vec3 &point) { min = glm::min(min, point); max = glm::max(max, point); }
+    void grow(const Aabb &other) { min = glm::min(min, other.min); max = glm::max(max, other.max); }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    float surfaceArea() const {
+        glm::vec3 size = glm::max(max - min, glm::vec3(0.f));
+        return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+};
+
+// Bounds of the box local once transformed by matrix
+Aabb transformAabb(const glm::mat4 &matrix, const Aabb &local);
+
+// The six planes of a view volume, facing inwards. Planes aren't normalized, which the box
+// tests don't need.
+struct Frustum {
+    std::array<glm::vec4, 6> planes;
+
+    // Extracts the planes from a GL projection times view matrix (Gribb and Hartmann)
+    static Frustum fromViewProjection(const glm::mat4 &viewProjection);
+};
+
+struct CullStats {
+    size_t visible = 0;
+    size_t culled = 0;
+    size_t nodesVisited = 0;
+};
+
+// Bounding volume hierarchy over a list of boxes, for culling them against a view frustum.
+//
+// build() splits with a binned surface area heuristic; once the top of the tree has produced
+// enough independent subtrees, those are built on the worker threads. refit() keeps the topology
+// and only recomputes the boxes, which is cheap but lets the tree degrade if primitives move far.
+class Bvh
+{
+public:
+    void build(const std::vector<Aabb> &bounds);
+
+    // bounds must have as many boxes as the tree was built with
+    void refit(const std::vector<Aabb> &bounds);
+    // Refits only the leaves holding the changed boxes and the nodes above them
+    void refit(const std::vector<Aabb> &bounds, const std::vector<std::uint32_t> &changed);
+
+    // Appends the index of every box that intersects frustum to visible, in no particular order.
+    // A plane a node is inside of isn't tested again below it, and whole subtrees outside are skipped.
+    void cull(const Frustum &frustum, std::vector<std::uint32_t> &visible, CullStats &stats) const;
+
+    void clear();
+    size_t primitiveCount() const { return m_indices.size(); }
+
+    // Inner nodes have count 0 and their children at first and first + 1; leaves index m_indices
+    struct Node {
+        Aabb bounds;
+        std::uint32_t first = 0;
+        std::uint32_t count = 0;
+    };
+
+private:
+    std::vector<Node> m_nodes; // Children always come after their parent
+    std::vector<std::uint32_t> m_indices; // Box indices, grouped by leaf
+    std::vector<Aabb> m_leafBounds; // The boxes in the same order, so leaves read them contiguously
+    std::vector<std::uint32_t> m_parents; // Per node; the root's is unused
+    std::vector<std::uint32_t> m_leafOf;  // Per box, the leaf that holds it
+    std::vector<std::uint32_t> m_slotOf;  // Per box, its position in m_indices
+};
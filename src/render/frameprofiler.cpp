@@ -0,0 +1,182 @@
+#include "frameprofiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+FrameProfiler::CpuScope::CpuScope(FrameProfiler &profiler, const char *stage)
+    : m_profiler(profiler.enabled() ? &profiler : nullptr), m_stage(stage)
+{
+    if (m_profiler) {
+        m_start = std::chrono::steady_clock::now();
+    }
+}
+
+FrameProfiler::CpuScope::~CpuScope() {
+    if (m_profiler) {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_start;
+        m_profiler->addCpuSample(m_stage, elapsed.count());
+    }
+}
+
+void FrameProfiler::setEnabled(bool enabled) {
+    if (enabled && !m_enabled) {
+        // Queries still in flight are simply reused; their old results are never read
+        for (Stage &stage : m_stages) {
+            stage.samples.clear();
+            stage.next = 0;
+            stage.pending.fill(false);
+        }
+        m_counters.clear();
+    }
+    m_enabled = enabled;
+}
+
+void FrameProfiler::destroy() {
+    for (Stage &stage : m_stages) {
+        if (stage.gpu && stage.queries[0] != 0) {
+            glDeleteQueries(queryLatency, stage.queries.data());
+            stage.queries.fill(0);
+        }
+    }
+    m_stages.clear();
+    m_gpuStage = -1;
+}
+
+size_t FrameProfiler::stageIndex(const char *name, bool gpu) {
+    for (size_t i = 0; i < m_stages.size(); i++) {
+        if (m_stages[i].gpu == gpu && m_stages[i].name == name) {
+            return i;
+        }
+    }
+    Stage stage;
+    stage.name = name;
+    stage.gpu = gpu;
+    stage.samples.reserve(historySize);
+    if (gpu) {
+        glGenQueries(queryLatency, stage.queries.data());
+    }
+    m_stages.push_back(std::move(stage));
+    return m_stages.size() - 1;
+}
+
+void FrameProfiler::beginGpu(const char *name) {
+    if (!m_enabled) {
+        return;
+    }
+    size_t index = stageIndex(name, true);
+    Stage &stage = m_stages[index];
+
+    // Collect the result this slot's query from queryLatency frames ago, if the GPU has finished it.
+    // If it hasn't, this frame goes untimed rather than waiting on it.
+    if (stage.pending[stage.slot]) {
+        GLuint query = stage.queries[stage.slot];
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            return;
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        addSample(stage, float(nanoseconds * 1e-6));
+        stage.pending[stage.slot] = false;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, stage.queries[stage.slot]);
+    m_gpuStage = int(index);
+}
+
+void FrameProfiler::endGpu() {
+    if (m_gpuStage < 0) {
+        return;
+    }
+    Stage &stage = m_stages[m_gpuStage];
+    glEndQuery(GL_TIME_ELAPSED);
+    stage.pending[stage.slot] = true;
+    stage.slot = (stage.slot + 1) % queryLatency;
+    m_gpuStage = -1;
+}
+
+void FrameProfiler::addCpuSample(const char *name, double ms) {
+    if (!m_enabled) {
+        return;
+    }
+    addSample(m_stages[stageIndex(name, false)], float(ms));
+}
+
+void FrameProfiler::setCounter(const char *name, long long value) {
+    if (!m_enabled) {
+        return;
+    }
+    for (std::pair<std::string, long long> &counter : m_counters) {
+        if (counter.first == name) {
+            counter.second = value;
+            return;
+        }
+    }
+    m_counters.emplace_back(name, value);
+}
+
+void FrameProfiler::addSample(Stage &stage, float ms) {
+    if (stage.samples.size() < historySize) {
+        stage.samples.push_back(ms);
+    }
+    else {
+        stage.samples[stage.next] = ms;
+    }
+    stage.next = (stage.next + 1) % historySize;
+}
+
+FrameProfiler::Stats FrameProfiler::stats(const Stage &stage) {
+    Stats result;
+    if (stage.samples.empty()) {
+        return result;
+    }
+    std::vector<float> sorted = stage.samples;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (float sample : sorted) {
+        sum += sample;
+    }
+    result.min = sorted.front();
+    result.avg = float(sum / sorted.size());
+    size_t p99 = size_t(std::ceil(0.99 * sorted.size())) - 1;
+    result.p99 = sorted[p99];
+    return result;
+}
+
+std::string FrameProfiler::summary() const {
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-17s %7s %7s %7s ms\n", "stage", "min", "avg", "p99");
+    std::string text = line;
+    for (const Stage &stage : m_stages) {
+        Stats s = stats(stage);
+        std::snprintf(line, sizeof(line), "%-4s %-12s %7.3f %7.3f %7.3f\n",
+                      stage.gpu ? "gpu" : "cpu", stage.name.c_str(), s.min, s.avg, s.p99);
+        text += line;
+    }
+    for (const std::pair<std::string, long long> &counter : m_counters) {
+        std::snprintf(line, sizeof(line), "%-17s %lld\n", counter.first.c_str(), counter.second);
+        text += line;
+    }
+    if (!text.empty()) {
+        text.pop_back();
+    }
+    return text;
+}
+
+bool FrameProfiler::writeCsv(const std::string &filePath) const {
+    std::ofstream file(filePath);
+    if (!file) {
+        std::cerr << "Failed to open \"" << filePath << "\" for frame timings" << std::endl;
+        return false;
+    }
+    file << "stage,source,samples,min_ms,avg_ms,p99_ms\n";
+    for (const Stage &stage : m_stages) {
+        Stats s = stats(stage);
+        file << stage.name << ',' << (stage.gpu ? "gpu" : "cpu") << ',' << stage.samples.size() << ','
+             << s.min << ',' << s.avg << ',' << s.p99 << '\n';
+    }
+    return bool(file);
+}
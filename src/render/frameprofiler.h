@@ -0,0 +1,84 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Per-stage frame timings: CPU stages are timed with scoped timers, GPU stages with GL_TIME_ELAPSED
+// queries kept in a small ring so results are read a few frames later without stalling. Each stage
+// keeps a rolling window of samples for min/avg/p99. While disabled, every call returns right away.
+class FrameProfiler
+{
+public:
+    static const int historySize = 240; // Samples kept per stage
+    static const int queryLatency = 4;  // Queries in flight per GPU stage
+
+    // Times the enclosing scope as a CPU stage
+    class CpuScope
+    {
+    public:
+        CpuScope(FrameProfiler &profiler, const char *stage);
+        ~CpuScope();
+        CpuScope(const CpuScope &) = delete;
+        CpuScope &operator=(const CpuScope &) = delete;
+
+    private:
+        FrameProfiler *m_profiler; // Null while the profiler is disabled
+        const char *m_stage;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    // Enabling clears the collected samples
+    void setEnabled(bool enabled);
+    bool enabled() const { return m_enabled; }
+
+    // Deletes the GPU queries; needs the GL context current
+    void destroy();
+
+    // Brackets a GPU stage. GL_TIME_ELAPSED queries can't nest, so GPU stages mustn't overlap.
+    void beginGpu(const char *stage);
+    void endGpu();
+
+    void addCpuSample(const char *stage, double ms);
+
+    // A value shown with the timings, like how many shapes were culled this frame
+    void setCounter(const char *name, long long value);
+
+    // One line per stage with its rolling min/avg/p99, then the counters
+    std::string summary() const;
+
+    // Writes the same statistics as summary, one row per stage; returns whether the file was written
+    bool writeCsv(const std::string &filePath) const;
+
+private:
+    struct Stage {
+        std::string name;
+        bool gpu = false;
+        std::vector<float> samples; // Ring of milliseconds, historySize long once full
+        size_t next = 0;
+        std::array<GLuint, queryLatency> queries = {};
+        std::array<bool, queryLatency> pending = {};
+        int slot = 0;
+    };
+    struct Stats {
+        float min = 0.f;
+        float avg = 0.f;
+        float p99 = 0.f;
+    };
+
+    size_t stageIndex(const char *name, bool gpu); // Adds the stage the first time it's seen
+    static void addSample(Stage &stage, float ms);
+    static Stats stats(const Stage &stage);
+
+    bool m_enabled = false;
+    std::vector<Stage> m_stages;
+    std::vector<std::pair<std::string, long long>> m_counters;
+    int m_gpuStage = -1; // Index of the stage whose query is running, if any
+};
@@ -0,0 +1,322 @@
+#include "geometrycache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <span>
+#include <QtConcurrent>
+#include "shapes/cube.h"
+#include "shapes/cone.h"
+#include "shapes/cylinder.h"
+#include "shapes/sphere.h"
+#include "shapes/square.h"
+#include "shapes/mesh.h"
+#include "shapes/meshcache.h"
+#include "shapes/primitivetables.h"
+
+GeometryShape geometryShapeOf(PrimitiveType type) {
+    switch (type) {
+    case PrimitiveType::PRIMITIVE_CUBE:     return GeometryShape::Cube;
+    case PrimitiveType::PRIMITIVE_CONE:     return GeometryShape::Cone;
+    case PrimitiveType::PRIMITIVE_CYLINDER: return GeometryShape::Cylinder;
+    case PrimitiveType::PRIMITIVE_SPHERE:   return GeometryShape::Sphere;
+    case PrimitiveType::PRIMITIVE_MESH:     return GeometryShape::Mesh;
+    }
+    return GeometryShape::Cube;
+}
+
+size_t GeometryKeyHash::operator()(const GeometryKey &key) const {
+    // Boost-style hash combine over every key field
+    size_t seed = 0;
+    auto combine = [&seed](size_t value) {
+        seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    };
+    combine(std::hash<int>()(static_cast<int>(key.shape)));
+    combine(std::hash<int>()(key.param1));
+    combine(std::hash<int>()(key.param2));
+    combine(std::hash<bool>()(key.isTexture));
+    combine(std::hash<float>()(key.repeatU));
+    combine(std::hash<float>()(key.repeatV));
+    combine(std::hash<std::string>()(key.meshfile));
+    combine(std::hash<float>()(key.creaseAngle));
+    return seed;
+}
+
+static_assert(GeometryRange::maxCoarserLods == int(Mesh::maxLodLevels) - 1, "Every mesh level of detail needs a slot in GeometryRange");
+
+namespace {
+
+// Looks up the baked table for key; only untextured primitives in the baked parameter range have one
+bool bakedTableOf(const GeometryKey &key, PrimitiveTable &table) {
+    if (key.isTexture) {
+        return false;
+    }
+    switch (key.shape) {
+    case GeometryShape::Cube:     return PrimitiveTables::cube(key.param1, table);
+    case GeometryShape::Cone:     return PrimitiveTables::cone(key.param1, key.param2, table);
+    case GeometryShape::Cylinder: return PrimitiveTables::cylinder(key.param1, key.param2, table);
+    case GeometryShape::Sphere:   return PrimitiveTables::sphere(key.param1, key.param2, table);
+    default:                      return false;
+    }
+}
+
+// Calls function with a generator configured for key. Meshes have no generator and are skipped.
+// The texture image path is not part of the geometry, so none is passed to the generators.
+template <typename Function>
+void withGenerator(const GeometryKey &key, Function function) {
+    switch (key.shape) {
+    case GeometryShape::Cube: {
+        Cube cubeShape;
+        cubeShape.updateParams(key.param1, key.isTexture, key.repeatU, key.repeatV, QString());
+        function(cubeShape);
+        break;
+    }
+    case GeometryShape::Cone: {
+        Cone coneShape;
+        coneShape.updateParams(key.param1, key.param2, key.isTexture, key.repeatU, key.repeatV, QString());
+        function(coneShape);
+        break;
+    }
+    case GeometryShape::Cylinder: {
+        Cylinder cylinderShape;
+        cylinderShape.updateParams(key.param1, key.param2, key.isTexture, key.repeatU, key.repeatV, QString());
+        function(cylinderShape);
+        break;
+    }
+    case GeometryShape::Sphere: {
+        Sphere sphereShape;
+        sphereShape.updateParams(key.param1, key.param2, key.isTexture, key.repeatU, key.repeatV, QString());
+        function(sphereShape);
+        break;
+    }
+    case GeometryShape::Square: {
+        Square squareShape;
+        squareShape.updateParams(key.isTexture, key.repeatU, key.repeatV, QString());
+        function(squareShape);
+        break;
+    }
+    case GeometryShape::Mesh:
+        break;
+    }
+}
+
+// Distance from the origin to the farthest vertex
+float boundingRadiusOf(std::span<const float> vertexData) {
+    float radiusSquared = 0.f;
+    for (size_t i = 0; i < vertexData.size(); i += GeometryCache::floatsPerVertex) {
+        glm::vec3 position(vertexData[i], vertexData[i + 1], vertexData[i + 2]);
+        radiusSquared = std::max(radiusSquared, glm::dot(position, position));
+    }
+    return std::sqrt(radiusSquared);
+}
+
+}
+
+// Sizes pending without writing it anywhere. Meshes, and primitives that don't fit 16-bit indices,
+// only know their size once generated, so they are generated here into flatVertices (and meshIndices).
+void GeometryCache::measure(PendingGeometry &pending) {
+    PrimitiveTable table;
+    if (bakedTableOf(pending.key, table)) {
+        pending.vertexCount = table.vertices.size() / floatsPerVertex;
+        pending.indexCount = table.indices.size();
+        return;
+    }
+
+    if (pending.key.shape == GeometryShape::Mesh) {
+        // A mesh cache hit stays mapped until write() has copied it
+        auto meshCache = std::make_unique<MeshCache>();
+        pending.indexSize = sizeof(std::uint32_t);
+        if (meshCache->load(pending.key.meshfile, pending.key.creaseAngle)) {
+            pending.vertexCount = meshCache->vertices().size() / floatsPerVertex;
+            pending.indexCount = meshCache->indices().size();
+            pending.lodIndexCounts = meshCache->lodIndexCounts();
+            pending.boundingRadius = boundingRadiusOf(meshCache->vertices());
+            pending.meshCache = std::move(meshCache);
+            return;
+        }
+
+        Mesh mesh = loadMesh(pending.key.meshfile, pending.key.creaseAngle);
+        mesh.generateIndexedData(pending.flatVertices, pending.meshIndices, pending.lodIndexCounts);
+        pending.vertexCount = pending.flatVertices.size() / floatsPerVertex;
+        pending.indexCount = pending.meshIndices.size();
+        pending.boundingRadius = boundingRadiusOf(pending.flatVertices);
+        meshCache->store(pending.key.meshfile, pending.key.creaseAngle, pending.flatVertices, pending.meshIndices, pending.lodIndexCounts);
+        return;
+    }
+
+    withGenerator(pending.key, [&pending](auto &shape) {
+        pending.vertexCount = shape.indexedVertexCount();
+        if (pending.vertexCount > 65536) {
+            std::cerr << "Primitive too finely tessellated for 16-bit indices, drawing it unindexed" << std::endl;
+            pending.flatVertices = shape.generateShape();
+            pending.vertexCount = pending.flatVertices.size() / floatsPerVertex;
+            return;
+        }
+        pending.indexCount = shape.indexedIndexCount();
+    });
+}
+
+// Writes pending into the slices of m_vertexData and m_indexData reserved for it by acquireAll()
+void GeometryCache::write(const PendingGeometry &pending) {
+    std::span<float> vertices(m_vertexData.data() + pending.vertexStart, pending.vertexCount * floatsPerVertex);
+    std::uint8_t *indexBytes = m_indexData.data() + pending.indexStart;
+
+    // Meshes use 32-bit indices
+    if (pending.meshCache) {
+        std::span<const float> cachedVertices = pending.meshCache->vertices();
+        std::span<const std::uint32_t> cachedIndices = pending.meshCache->indices();
+        std::copy(cachedVertices.begin(), cachedVertices.end(), vertices.begin());
+        std::copy(cachedIndices.begin(), cachedIndices.end(), reinterpret_cast<std::uint32_t *>(indexBytes));
+        return;
+    }
+
+    if (!pending.flatVertices.empty()) {
+        std::copy(pending.flatVertices.begin(), pending.flatVertices.end(), vertices.begin());
+        std::copy(pending.meshIndices.begin(), pending.meshIndices.end(), reinterpret_cast<std::uint32_t *>(indexBytes));
+        return;
+    }
+
+    std::span<std::uint16_t> indices(reinterpret_cast<std::uint16_t *>(indexBytes), pending.indexCount);
+
+    PrimitiveTable table;
+    if (bakedTableOf(pending.key, table)) {
+        std::copy(table.vertices.begin(), table.vertices.end(), vertices.begin());
+        std::copy(table.indices.begin(), table.indices.end(), indices.begin());
+        return;
+    }
+
+    withGenerator(pending.key, [&](auto &shape) {
+        shape.generateIndexedShape(vertices, indices);
+    });
+}
+
+std::vector<GeometryRange> GeometryCache::acquireAll(const std::vector<GeometryKey> &keys) {
+    // Collect the distinct keys that miss the cache; repeated keys share one pending entry
+    std::vector<PendingGeometry> pending;
+    std::unordered_map<GeometryKey, size_t, GeometryKeyHash> pendingIndex;
+    for (const GeometryKey &key : keys) {
+        if (m_ranges.find(key) == m_ranges.end() && pendingIndex.emplace(key, pending.size()).second) {
+            pending.push_back(PendingGeometry{key});
+        }
+    }
+
+    if (!pending.empty()) {
+        // Size every miss in parallel; this is also where meshes are loaded
+        QtConcurrent::blockingMap(pending, [](PendingGeometry &entry) {
+            measure(entry);
+        });
+
+        // Prefix sum over the sizes gives every entry its own slice, so the storage grows exactly once
+        size_t vertexEnd = m_vertexData.size();
+        size_t indexEnd = m_indexData.size();
+        for (PendingGeometry &entry : pending) {
+            entry.vertexStart = vertexEnd;
+            vertexEnd += entry.vertexCount * floatsPerVertex;
+
+            // Keep every range aligned to its index size
+            entry.indexStart = (indexEnd + entry.indexSize - 1) / entry.indexSize * entry.indexSize;
+            indexEnd = entry.indexStart + entry.indexCount * entry.indexSize;
+
+            GeometryRange range;
+            range.baseVertex = static_cast<GLint>(entry.vertexStart / floatsPerVertex);
+            range.vertexCount = static_cast<GLsizei>(entry.vertexCount);
+            range.indexCount = static_cast<GLsizei>(entry.indexCount);
+            range.indexType = entry.indexSize == sizeof(std::uint32_t) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+            range.indexOffset = entry.indexStart;
+
+            // Mesh levels of detail follow each other in the index slice, full detail first
+            if (!entry.lodIndexCounts.empty()) {
+                range.indexCount = static_cast<GLsizei>(entry.lodIndexCounts.front());
+                size_t lodOffset = entry.indexStart + entry.lodIndexCounts.front() * entry.indexSize;
+                for (size_t level = 1; level < entry.lodIndexCounts.size(); level++) {
+                    range.lods[level - 1].indexCount = static_cast<GLsizei>(entry.lodIndexCounts[level]);
+                    range.lods[level - 1].indexOffset = lodOffset;
+                    lodOffset += entry.lodIndexCounts[level] * entry.indexSize;
+                }
+                range.lodCount = static_cast<int>(entry.lodIndexCounts.size()) - 1;
+                range.boundingRadius = entry.boundingRadius;
+            }
+            m_ranges.emplace(entry.key, range);
+        }
+        m_vertexData.resize(vertexEnd);
+        m_indexData.resize(indexEnd);
+
+        // Entries write disjoint slices, so they can be generated concurrently without locking.
+        // A single miss is written inline rather than paying for a thread pool round trip.
+        if (pending.size() == 1) {
+            write(pending.front());
+        }
+        else {
+            QtConcurrent::blockingMap(pending, [this](const PendingGeometry &entry) {
+                write(entry);
+            });
+        }
+    }
+
+    std::vector<GeometryRange> ranges;
+    ranges.reserve(keys.size());
+    for (const GeometryKey &key : keys) {
+        ranges.push_back(m_ranges.at(key));
+    }
+    return ranges;
+}
+
+GeometryRange GeometryCache::acquire(const GeometryKey &key) {
+    auto found = m_ranges.find(key);
+    if (found != m_ranges.end()) {
+        return found->second;
+    }
+    return acquireAll({key}).front();
+}
+
+bool uploadTail(GLuint buffer, const void *data, size_t size, size_t &uploaded, size_t &capacity) {
+    if (uploaded == size) {
+        return false;
+    }
+
+    // GL_COPY_WRITE_BUFFER doesn't disturb any VAO's element array binding
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    bool reallocated = false;
+    if (size > capacity) {
+        // Grow geometrically so a steady stream of appends doesn't reallocate every tick
+        capacity = std::max(size, capacity * 2);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+        uploaded = 0;
+        reallocated = true;
+    }
+    glBufferSubData(GL_COPY_WRITE_BUFFER, uploaded, size - uploaded, static_cast<const std::uint8_t *>(data) + uploaded);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    uploaded = size;
+    return reallocated;
+}
+
+bool GeometryCache::upload(GLuint vbo, GLuint ebo) {
+    bool reallocated = uploadTail(vbo, m_vertexData.data(), m_vertexData.size() * sizeof(GLfloat), m_uploadedVertexBytes, m_vertexCapacityBytes);
+    uploadTail(ebo, m_indexData.data(), m_indexData.size(), m_uploadedIndexBytes, m_indexCapacityBytes);
+    return reallocated;
+}
+
+void drawGeometryRange(const GeometryRange &range, int lod, GLsizei instanceCount) {
+    if (lod > 0 && lod <= range.lodCount) {
+        const GeometryLod &level = range.lods[lod - 1];
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level.indexCount, range.indexType, reinterpret_cast<const void *>(level.indexOffset), instanceCount, range.baseVertex);
+    }
+    else if (range.indexCount > 0) {
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, range.indexType, reinterpret_cast<const void *>(range.indexOffset), instanceCount, range.baseVertex);
+    }
+    else {
+        glDrawArraysInstanced(GL_TRIANGLES, range.baseVertex, range.vertexCount, instanceCount);
+    }
+}
+
+void GeometryCache::clear() {
+    m_ranges.clear();
+    m_vertexData.clear();
+    m_indexData.clear();
+    m_uploadedVertexBytes = 0;
+    m_vertexCapacityBytes = 0;
+    m_uploadedIndexBytes = 0;
+    m_indexCapacityBytes = 0;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shapes/meshcache.h"
+#include "utils/scenedata.h"
+
+// Everything the tessellators can produce; Square is only used for snowflakes and never appears in scene files
+enum class GeometryShape {
+    Cube,
+    Cone,
+    Cylinder,
+    Sphere,
+    Mesh,
+    Square
+};
+
+GeometryShape geometryShapeOf(PrimitiveType type);
+
+// Uniquely identifies one tessellated unit primitive
+struct GeometryKey {
+    GeometryShape shape;
+    int param1 = 0;
+    int param2 = 0;
+    bool isTexture = false;
+    float repeatU = 1.f;
+    float repeatV = 1.f;
+    std::string meshfile; // Only used for meshes
+    float creaseAngle = 0.f; // Only used for meshes without normals
+
+    bool operator==(const GeometryKey &other) const = default;
+};
+
+struct GeometryKeyHash {
+    size_t operator()(const GeometryKey &key) const;
+};
+
+// A coarser level of detail of a mesh: another triangle list over the same vertices
+struct GeometryLod {
+    GLsizei indexCount = 0;
+    size_t indexOffset = 0; // In bytes from the start of the index buffer
+};
+
+// Location of a cached primitive inside the shared vertex and index buffers.
+// Ranges without indices are drawn with glDrawArrays(baseVertex, vertexCount).
+struct GeometryRange {
+    GLint baseVertex = 0;
+    GLsizei vertexCount = 0;
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_SHORT;
+    size_t indexOffset = 0; // In bytes from the start of the index buffer
+
+    // Meshes only: progressively coarser levels, and the object-space radius around the origin that bounds them
+    static const int maxCoarserLods = 4;
+    int lodCount = 0;
+    std::array<GeometryLod, maxCoarserLods> lods;
+    float boundingRadius = 0.f;
+};
+
+// Draws instanceCount copies of range at level of detail lod, where 0 (and any level the range doesn't have) is full detail
+void drawGeometryRange(const GeometryRange &range, int lod = 0, GLsizei instanceCount = 1);
+
+// Appends data[uploaded, size) to buffer, growing its storage geometrically when needed, for
+// buffers that are only ever appended to. Returns true when the storage was reallocated.
+bool uploadTail(GLuint buffer, const void *data, size_t size, size_t &uploaded, size_t &capacity);
+
+// Keeps a single tessellated copy of every distinct primitive in one big vertex buffer,
+// plus its triangle indices in one big index buffer. Shapes reference shared ranges,
+// so identical primitives are tessellated and uploaded exactly once.
+class GeometryCache
+{
+public:
+    // Returns the range for key, tessellating and appending it on first use
+    GeometryRange acquire(const GeometryKey &key);
+
+    // Returns the range for every key, in order. All misses are sized first, the storage grows once,
+    // and then every miss is tessellated in parallel straight into its own slice.
+    std::vector<GeometryRange> acquireAll(const std::vector<GeometryKey> &keys);
+
+    // Uploads only the vertices and indices appended since the last call. The buffer storage is
+    // only reallocated when it has to grow. Returns true when the vertex buffer was reallocated,
+    // in which case the caller must re-specify its vertex attributes.
+    bool upload(GLuint vbo, GLuint ebo);
+
+    // Drops every entry, e.g. when the scene (and its GL objects) is recreated
+    void clear();
+
+    size_t entryCount() const { return m_ranges.size(); }
+    size_t vertexCount() const { return m_vertexData.size() / floatsPerVertex; }
+
+    static const int floatsPerVertex = 8; // position, normal, uv
+
+private:
+    // A cache miss, sized before anything is written
+    struct PendingGeometry {
+        GeometryKey key;
+        size_t vertexCount = 0;
+        size_t indexCount = 0;
+        size_t indexSize = sizeof(std::uint16_t);
+        size_t vertexStart = 0;          // In floats into m_vertexData
+        size_t indexStart = 0;           // In bytes into m_indexData
+        std::vector<float> flatVertices; // Meshes and primitives too large for 16-bit indices
+        std::vector<std::uint32_t> meshIndices;
+        std::vector<std::uint32_t> lodIndexCounts; // Meshes only, finest level first
+        float boundingRadius = 0.f;
+        std::unique_ptr<MeshCache> meshCache; // Mapped entry when a mesh was found in the mesh cache
+    };
+
+    static void measure(PendingGeometry &pending);
+    void write(const PendingGeometry &pending);
+
+    std::unordered_map<GeometryKey, GeometryRange, GeometryKeyHash> m_ranges;
+    std::vector<float> m_vertexData;
+    std::vector<std::uint8_t> m_indexData; // Raw bytes, so ranges can mix index widths
+
+    // Bytes already on the GPU and size of the GPU allocations
+    size_t m_uploadedVertexBytes = 0;
+    size_t m_vertexCapacityBytes = 0;
+    size_t m_uploadedIndexBytes = 0;
+    size_t m_indexCapacityBytes = 0;
+};
@@ -0,0 +1,69 @@
+#include "indirectdrawlist.h"
+
+namespace {
+
+template <typename T>
+void append(std::vector<std::uint8_t> &bytes, const T &command) {
+    const std::uint8_t *data = reinterpret_cast<const std::uint8_t *>(&command);
+    bytes.insert(bytes.end(), data, data + sizeof(T));
+}
+
+}
+
+bool IndirectDrawList::supported() {
+    return GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+}
+
+void IndirectDrawList::clear() {
+    m_commands.clear();
+    m_runs.clear();
+    m_commandCount = 0;
+}
+
+void IndirectDrawList::add(const GeometryRange &range, int lod, GLsizei instanceCount, GLuint baseInstance) {
+    // Mirrors drawGeometryRange, except offsets count indices rather than bytes
+    GLsizei indexCount = range.indexCount;
+    size_t indexOffset = range.indexOffset;
+    if (lod > 0 && lod <= range.lodCount) {
+        indexCount = range.lods[lod - 1].indexCount;
+        indexOffset = range.lods[lod - 1].indexOffset;
+    }
+
+    // A run only ever extends with the command right after it, so nothing is drawn out of order
+    GLenum indexType = indexCount == 0 ? GL_NONE : range.indexType;
+    if (m_runs.empty() || m_runs.back().indexType != indexType) {
+        m_runs.push_back({indexType, m_commands.size(), 0});
+    }
+    m_runs.back().count++;
+    m_commandCount++;
+
+    if (indexType == GL_NONE) {
+        append(m_commands, DrawArraysIndirectCommand{GLuint(range.vertexCount), GLuint(instanceCount), GLuint(range.baseVertex), baseInstance});
+        return;
+    }
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    append(m_commands, DrawElementsIndirectCommand{GLuint(indexCount), GLuint(instanceCount), GLuint(indexOffset / indexSize), range.baseVertex, baseInstance});
+}
+
+void IndirectDrawList::upload(GLuint indirectBuffer) {
+    // The commands only change with the visible set, their order or the levels of detail, so most frames stop here
+    if (m_commands == m_uploaded) {
+        return;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size(), m_commands.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    m_uploaded = m_commands;
+}
+
+void IndirectDrawList::draw() const {
+    for (const DrawRun &run : m_runs) {
+        const void *offset = reinterpret_cast<const void *>(run.offset);
+        if (run.indexType == GL_NONE) {
+            glMultiDrawArraysIndirect(GL_TRIANGLES, offset, run.count, 0);
+        }
+        else {
+            glMultiDrawElementsIndirect(GL_TRIANGLES, run.indexType, offset, run.count, 0);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "render/geometrycache.h"
+
+// Command layouts read by glMultiDrawArraysIndirect and glMultiDrawElementsIndirect
+struct DrawArraysIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+};
+
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Collects instanced draws of cached geometry and issues them as multi-draws, one per run of
+// consecutive commands of the same kind (unindexed, 16-bit indices, 32-bit indices), so any number
+// of batches costs a handful of calls. Commands are drawn in the order they were added, which keeps
+// blended batches back to front.
+// baseInstance makes each draw read its own slice of the per-instance attributes, which are bound
+// once at the start of the instance buffer.
+//
+// Needs GL 4.3, or the multi draw indirect and base instance extensions; callers check supported()
+// and otherwise fall back to one drawGeometryRange per batch.
+class IndirectDrawList
+{
+public:
+    static bool supported();
+
+    void clear();
+    // Same arguments as drawGeometryRange, plus where the draw's instances start
+    void add(const GeometryRange &range, int lod, GLsizei instanceCount, GLuint baseInstance);
+
+    // Uploads the commands to indirectBuffer, unless they're the same as the last ones uploaded there
+    void upload(GLuint indirectBuffer);
+    // Issues every command; the VAO and the buffer passed to upload must be bound
+    void draw() const;
+
+    size_t commandCount() const { return m_commandCount; }
+
+private:
+    // Consecutive commands issued by one multi-draw
+    struct DrawRun {
+        GLenum indexType;  // GL_NONE for unindexed draws
+        size_t offset;     // In bytes into the command buffer
+        GLsizei count;
+    };
+
+    std::vector<std::uint8_t> m_commands; // Both command layouts, back to back in the order added
+    std::vector<DrawRun> m_runs;
+    size_t m_commandCount = 0;
+
+    std::vector<std::uint8_t> m_uploaded; // m_commands as last uploaded
+};
@@ -0,0 +1,85 @@
+#include "instancebatcher.h"
+
+#include <cstddef>
+#include <map>
+#include <tuple>
+
+void InstanceBatcher::build(const std::vector<GeometryRange> &ranges, const std::vector<glm::mat4> &modelMatrices, const std::vector<int> &materialIds) {
+    m_batches.clear();
+    m_instances.clear();
+
+    // Ranges of the same geometry are identical copies, so their location identifies the geometry
+    using BatchKey = std::tuple<GLint, GLsizei, size_t, GLsizei, int>;
+    std::map<BatchKey, size_t> batchIndex;
+    std::vector<size_t> shapeBatch(ranges.size());
+    for (size_t i = 0; i < ranges.size(); i++) {
+        const GeometryRange &range = ranges[i];
+        BatchKey key(range.baseVertex, range.vertexCount, range.indexOffset, range.indexCount, materialIds[i]);
+        auto [found, inserted] = batchIndex.emplace(key, m_batches.size());
+        if (inserted) {
+            InstanceBatch batch;
+            batch.range = range;
+            batch.materialId = materialIds[i];
+            m_batches.push_back(batch);
+        }
+        shapeBatch[i] = found->second;
+        m_batches[found->second].instanceCount++;
+    }
+
+    // Counting sort of the shapes into contiguous per-batch slices
+    GLint nextInstance = 0;
+    for (InstanceBatch &batch : m_batches) {
+        batch.firstInstance = nextInstance;
+        nextInstance += batch.instanceCount;
+    }
+    m_instances.resize(ranges.size());
+    m_shapeInstances.resize(ranges.size());
+    std::vector<GLint> fill(m_batches.size());
+    for (size_t b = 0; b < m_batches.size(); b++) {
+        fill[b] = m_batches[b].firstInstance;
+    }
+    for (size_t i = 0; i < ranges.size(); i++) {
+        m_shapeInstances[i] = fill[shapeBatch[i]]++;
+        InstanceData &instance = m_instances[m_shapeInstances[i]];
+        instance.modelMatrix = modelMatrices[i];
+        instance.normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrices[i])));
+    }
+}
+
+void InstanceBatcher::upload(GLuint instanceVbo) const {
+    // Respecifying the whole store every time lets the driver orphan the copy still in flight
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+    glBufferData(GL_ARRAY_BUFFER, m_instances.size() * sizeof(InstanceData), m_instances.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBatcher::updateInstance(GLuint instanceVbo, size_t shape, const glm::mat4 &modelMatrix) {
+    GLint index = m_shapeInstances[shape];
+    InstanceData &instance = m_instances[index];
+    instance.modelMatrix = modelMatrix;
+    instance.normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+    glBufferSubData(GL_ARRAY_BUFFER, index * sizeof(InstanceData), sizeof(InstanceData), &instance);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBatcher::enableInstanceAttributes() {
+    for (GLuint column = 0; column < 7; column++) {
+        glEnableVertexAttribArray(firstAttributeLocation + column);
+        glVertexAttribDivisor(firstAttributeLocation + column, 1);
+    }
+}
+
+void InstanceBatcher::bindInstances(GLuint instanceVbo, GLint firstInstance, size_t baseOffset) {
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+    size_t base = baseOffset + size_t(firstInstance) * sizeof(InstanceData);
+    for (GLuint column = 0; column < 4; column++) {
+        size_t offset = base + offsetof(InstanceData, modelMatrix) + column * sizeof(glm::vec4);
+        glVertexAttribPointer(firstAttributeLocation + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), reinterpret_cast<const void *>(offset));
+    }
+    for (GLuint column = 0; column < 3; column++) {
+        size_t offset = base + offsetof(InstanceData, normalMatrix) + column * sizeof(glm::vec3);
+        glVertexAttribPointer(firstAttributeLocation + 4 + column, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), reinterpret_cast<const void *>(offset));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "render/geometrycache.h"
+
+// Per-instance vertex attributes, read with a divisor of 1
+struct InstanceData {
+    glm::mat4 modelMatrix;
+    glm::mat3 normalMatrix; // Inverse transpose of the model matrix
+};
+
+// Shapes that share geometry and material, drawn with a single instanced call
+struct InstanceBatch {
+    GeometryRange range;
+    int materialId = 0;
+    GLint firstInstance = 0; // Into the instance buffer
+    GLsizei instanceCount = 0;
+};
+
+// Groups shapes by (geometry range, material) so a scene with hundreds of copies of one
+// primitive costs one draw call per distinct pair instead of one per shape. The model and
+// normal matrices of every batch sit contiguously in one instance buffer.
+class InstanceBatcher
+{
+public:
+    // Rebuilds the batches from parallel per-shape arrays. Batches come out in the order their
+    // first shape appears; shapes keep their relative order inside a batch.
+    void build(const std::vector<GeometryRange> &ranges, const std::vector<glm::mat4> &modelMatrices, const std::vector<int> &materialIds);
+
+    // Replaces the contents of instanceVbo with the instance data of every batch
+    void upload(GLuint instanceVbo) const;
+
+    // Moves shape, an index into the arrays passed to the last build(), without changing its batch,
+    // and uploads only its instance to instanceVbo
+    void updateInstance(GLuint instanceVbo, size_t shape, const glm::mat4 &modelMatrix);
+
+    // Enables the instance attributes on the bound VAO and sets their divisor
+    static void enableInstanceAttributes();
+
+    // Points the instance attributes of the bound VAO at firstInstance of the instances starting
+    // baseOffset bytes into instanceVbo. GL 4.1 has no base instance for instanced draws, so this
+    // is done before every batch.
+    static void bindInstances(GLuint instanceVbo, GLint firstInstance, size_t baseOffset = 0);
+
+    const std::vector<InstanceBatch> &batches() const { return m_batches; }
+    const std::vector<InstanceData> &instances() const { return m_instances; }
+
+    // Locations 3-6 hold the model matrix columns, 7-9 the normal matrix columns
+    static const GLuint firstAttributeLocation = 3;
+
+private:
+    std::vector<InstanceBatch> m_batches;
+    std::vector<InstanceData> m_instances;
+    std::vector<GLint> m_shapeInstances; // Per shape of the last build(), its index into m_instances
+};
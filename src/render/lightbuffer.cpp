@@ -0,0 +1,56 @@
+#include "lightbuffer.h"
+
+#include <cstring>
+
+void LightBuffer::create() {
+    // Creating again, as on every scene load, replaces the previous buffer
+    destroy();
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, m_buffer);
+    m_uploaded = false;
+}
+
+void LightBuffer::destroy() {
+    glDeleteBuffers(1, &m_buffer);
+    m_buffer = 0;
+}
+
+void LightBuffer::bindProgram(GLuint program) {
+    GLuint block = glGetUniformBlockIndex(program, "Lights");
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, block, bindingPoint);
+    }
+}
+
+void LightBuffer::update(const std::vector<SceneLightData> &lights, const glm::vec3 &sunColor, const glm::vec3 &sunDirection) {
+    // Every field is written so unused slots and padding compare equal from frame to frame
+    LightBlock block;
+    for (GpuLight &light : block.lights) {
+        light = {glm::vec4(0.f, 0.f, 0.f, -1.f), glm::vec4(0.f), glm::vec4(0.f), glm::vec4(0.f)};
+    }
+    // Point and spot lights are LightClusters' job; directional lights fill the slots from the front
+    int count = 0;
+    for (const SceneLightData &scene : lights) {
+        if (scene.type != LightType::LIGHT_DIRECTIONAL || count == maxLights) {
+            continue;
+        }
+        GpuLight &light = block.lights[count++];
+        light.color = glm::vec4(glm::vec3(scene.color), 0.f);
+        light.direction = glm::vec4(glm::vec3(scene.dir), 0.f);
+    }
+    block.sunColor = glm::vec4(sunColor, 0.f);
+    block.sunDirection = glm::vec4(sunDirection, 0.f);
+
+    // The sun only moves while its setting is on, and scene lights only change on load, so most frames stop here
+    if (m_uploaded && std::memcmp(&block, &m_block, sizeof(LightBlock)) == 0) {
+        return;
+    }
+    m_block = block;
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightBlock), &m_block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    m_uploaded = true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "utils/scenedata.h"
+
+// Directional scene lights and the sun packed into one std140 uniform buffer that every lit program
+// reads through its Lights block, so changing a light costs one upload rather than a round of uniform
+// calls per program. Point and spot lights go through LightClusters instead.
+// The block layout lives in default.frag and terrain.frag and must match LightBlock.
+class LightBuffer
+{
+public:
+    static const int maxLights = 8;
+    static const GLuint bindingPoint = 0;
+
+    // Safe to call again; anything created before is released first
+    void create();
+    void destroy();
+
+    // Points program's Lights block at the shared binding point; done once after linking
+    static void bindProgram(GLuint program);
+
+    // Repacks the directional lights and the sun, and uploads them only if they differ from what the
+    // buffer holds. Directional lights past maxLights are ignored.
+    void update(const std::vector<SceneLightData> &lights, const glm::vec3 &sunColor, const glm::vec3 &sunDirection);
+
+private:
+    struct GpuLight {
+        glm::vec4 color;     // rgb, with the type in w: 0 directional, -1 unused
+        glm::vec4 position;  // xyz, with the spot angle in w
+        glm::vec4 direction; // xyz, with the spot penumbra in w
+        glm::vec4 function;  // Attenuation coefficients in xyz
+    };
+    struct LightBlock {
+        GpuLight lights[maxLights];
+        glm::vec4 sunColor;
+        glm::vec4 sunDirection;
+    };
+    static_assert(sizeof(LightBlock) == (4 * maxLights + 2) * sizeof(glm::vec4), "LightBlock must match the std140 layout");
+
+    GLuint m_buffer = 0;
+    LightBlock m_block; // Last contents uploaded
+    bool m_uploaded = false;
+};
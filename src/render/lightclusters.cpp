@@ -0,0 +1,259 @@
+#include "lightclusters.h"
+
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+
+namespace {
+
+// Below this many lights, handing the binning to the worker pool costs more than it saves
+const size_t parallelLightCount = 64;
+
+template <typename Function>
+void forEachIndex(int count, bool parallel, Function function) {
+    if (!parallel) {
+        for (int i = 0; i < count; i++) {
+            function(i);
+        }
+        return;
+    }
+    std::vector<int> indices(count);
+    std::iota(indices.begin(), indices.end(), 0);
+    QtConcurrent::blockingMap(indices, [&function](int i) { function(i); });
+}
+
+}
+
+void LightClusters::create() {
+    // Creating again, as on every scene load, replaces the previous buffers and textures
+    destroy();
+    glGenBuffers(1, &m_blockBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_blockBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ClusterBlock), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, m_blockBuffer);
+
+    // Each buffer texture gets a small store now, so the samplers are valid before the first update
+    const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+    glGenBuffers(3, m_buffers);
+    glGenTextures(3, m_textures);
+    for (int i = 0; i < 3; i++) {
+        glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, m_textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], m_buffers[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &m_maxTexels);
+
+    m_table.assign(clusterCount, glm::uvec2(0));
+    m_sliceIndices.assign(gridZ, {});
+    m_uploadedLights.clear();
+    m_warnedOverflow = false;
+}
+
+void LightClusters::destroy() {
+    glDeleteBuffers(1, &m_blockBuffer);
+    glDeleteBuffers(3, m_buffers);
+    glDeleteTextures(3, m_textures);
+    m_blockBuffer = 0;
+    std::fill(std::begin(m_buffers), std::end(m_buffers), 0);
+    std::fill(std::begin(m_textures), std::end(m_textures), 0);
+}
+
+void LightClusters::bindProgram(GLuint program) {
+    GLuint block = glGetUniformBlockIndex(program, "Clusters");
+    if (block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, block, bindingPoint);
+    }
+    glUniform1i(glGetUniformLocation(program, "clusterLights"), lightsUnit);
+    glUniform1i(glGetUniformLocation(program, "clusterTable"), tableUnit);
+    glUniform1i(glGetUniformLocation(program, "clusterIndices"), indicesUnit);
+}
+
+float LightClusters::lightRange(const SceneLightData &light, float farPlane) {
+    // The shaders attenuate by min(1, 1 / (c + l*d + q*d^2)); past the distance where that drops
+    // under a 256th of the light's brightest channel, it no longer changes the output
+    float brightest = std::max({light.color.r, light.color.g, light.color.b});
+    float limit = 256.f * brightest;
+    float c = light.function.x;
+    float l = light.function.y;
+    float q = light.function.z;
+    if (brightest <= 0.f || c >= limit) {
+        return 0.f;
+    }
+    if (q > 0.f) {
+        return std::min(farPlane, (-l + std::sqrt(l * l + 4.f * q * (limit - c))) / (2.f * q));
+    }
+    if (l > 0.f) {
+        return std::min(farPlane, (limit - c) / l);
+    }
+    // Constant attenuation reaches everything in view
+    return farPlane;
+}
+
+void LightClusters::update(const std::vector<SceneLightData> &lights, const glm::mat4 &view, const glm::mat4 &proj,
+                           float nearPlane, float farPlane, int screenWidth, int screenHeight) {
+    // ====== Pack the point and spot lights with a range that reaches the view
+    m_lights.clear();
+    m_ranges.clear();
+    for (const SceneLightData &light : lights) {
+        if (light.type == LightType::LIGHT_DIRECTIONAL) {
+            continue;
+        }
+        float range = lightRange(light, farPlane);
+        if (range <= 0.f) {
+            continue;
+        }
+        bool spot = light.type == LightType::LIGHT_SPOT;
+        m_lights.push_back(glm::vec4(glm::vec3(light.color), spot ? 2.f : 1.f));
+        m_lights.push_back(glm::vec4(glm::vec3(light.pos), spot ? light.angle : 0.f));
+        m_lights.push_back(glm::vec4(glm::vec3(light.dir), spot ? light.penumbra : 0.f));
+        m_lights.push_back(glm::vec4(light.function, 0.f));
+        m_ranges.push_back(range);
+    }
+    int lightCount = int(m_ranges.size());
+    bool parallel = size_t(lightCount) >= parallelLightCount;
+
+    // ====== Slices are spaced evenly in log(depth), so near clusters are as deep as they are wide
+    float sliceScale = gridZ / std::log(farPlane / nearPlane);
+    float sliceBias = -std::log(nearPlane) * sliceScale;
+    auto slice = [&](float depth) {
+        return std::clamp(int(std::floor(std::log(std::max(depth, nearPlane)) * sliceScale + sliceBias)), 0, gridZ - 1);
+    };
+
+    // ====== Find each light's clusters from the view-space box around its range. Spot lights use the
+    // same sphere; the shader's cone test rejects the rest.
+    m_bounds.resize(lightCount);
+    forEachIndex(lightCount, parallel, [&](int i) {
+        ClusterBounds &bounds = m_bounds[i];
+        glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(m_lights[4 * i + 1]), 1.f));
+        float radius = m_ranges[i];
+        float nearDepth = -center.z - radius;
+        float farDepth = -center.z + radius;
+        if (farDepth < nearPlane || nearDepth > farPlane) {
+            bounds = {glm::ivec3(0), glm::ivec3(-1)};
+            return;
+        }
+        bounds.min = glm::ivec3(0, 0, slice(nearDepth));
+        bounds.max = glm::ivec3(gridX - 1, gridY - 1, slice(farDepth));
+        if (nearDepth < nearPlane) {
+            // The box reaches behind the near plane, where projecting it says nothing useful
+            return;
+        }
+        glm::vec2 ndcMin(1.f);
+        glm::vec2 ndcMax(-1.f);
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+            glm::vec4 clip = proj * glm::vec4(center + offset, 1.f);
+            glm::vec2 ndc = glm::vec2(clip) / clip.w;
+            ndcMin = glm::min(ndcMin, ndc);
+            ndcMax = glm::max(ndcMax, ndc);
+        }
+        glm::vec2 grid(gridX, gridY);
+        glm::ivec2 tileMin = glm::ivec2(glm::floor((ndcMin * 0.5f + 0.5f) * grid));
+        glm::ivec2 tileMax = glm::ivec2(glm::floor((ndcMax * 0.5f + 0.5f) * grid));
+        bounds.min = glm::ivec3(glm::max(tileMin, glm::ivec2(0)), bounds.min.z);
+        bounds.max = glm::ivec3(glm::min(tileMax, glm::ivec2(gridX - 1, gridY - 1)), bounds.max.z);
+    });
+
+    // ====== Bin one depth slice at a time; slices share nothing, so they run in parallel
+    const int sliceClusters = gridX * gridY;
+    forEachIndex(gridZ, parallel, [&](int z) {
+        glm::uvec2 *table = m_table.data() + z * sliceClusters;
+        std::fill(table, table + sliceClusters, glm::uvec2(0));
+        std::vector<std::uint32_t> &indices = m_sliceIndices[z];
+
+        // Count, turn the counts into offsets, then fill
+        for (const ClusterBounds &bounds : m_bounds) {
+            if (z < bounds.min.z || z > bounds.max.z) {
+                continue;
+            }
+            for (int y = bounds.min.y; y <= bounds.max.y; y++) {
+                for (int x = bounds.min.x; x <= bounds.max.x; x++) {
+                    table[y * gridX + x].y++;
+                }
+            }
+        }
+        std::uint32_t offset = 0;
+        for (int c = 0; c < sliceClusters; c++) {
+            table[c].x = offset;
+            offset += table[c].y;
+            table[c].y = 0;
+        }
+        indices.resize(offset);
+        for (int i = 0; i < lightCount; i++) {
+            const ClusterBounds &bounds = m_bounds[i];
+            if (z < bounds.min.z || z > bounds.max.z) {
+                continue;
+            }
+            for (int y = bounds.min.y; y <= bounds.max.y; y++) {
+                for (int x = bounds.min.x; x <= bounds.max.x; x++) {
+                    glm::uvec2 &cluster = table[y * gridX + x];
+                    indices[cluster.x + cluster.y++] = std::uint32_t(i);
+                }
+            }
+        }
+    });
+
+    // ====== Join the slices into one index list
+    m_indices.clear();
+    for (int z = 0; z < gridZ; z++) {
+        std::uint32_t base = std::uint32_t(m_indices.size());
+        glm::uvec2 *table = m_table.data() + z * sliceClusters;
+        for (int c = 0; c < sliceClusters; c++) {
+            table[c].x += base;
+        }
+        m_indices.insert(m_indices.end(), m_sliceIndices[z].begin(), m_sliceIndices[z].end());
+    }
+    if (m_maxTexels > 0 && m_indices.size() > size_t(m_maxTexels)) {
+        // Clusters whose lists would run past the end lose them rather than read out of bounds
+        if (!m_warnedOverflow) {
+            std::cerr << "Light clusters need " << m_indices.size() << " indices, more than the "
+                      << m_maxTexels << " a buffer texture holds; dropping lights from the farthest clusters" << std::endl;
+            m_warnedOverflow = true;
+        }
+        for (glm::uvec2 &cluster : m_table) {
+            if (cluster.x + cluster.y > std::uint32_t(m_maxTexels)) {
+                cluster.y = cluster.x < std::uint32_t(m_maxTexels) ? std::uint32_t(m_maxTexels) - cluster.x : 0;
+            }
+        }
+        m_indices.resize(m_maxTexels);
+    }
+
+    // ====== Upload. Lights only change on load; the table and indices follow the camera.
+    ClusterBlock block;
+    block.viewDepth = -glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]);
+    block.scale = glm::vec4(float(gridX) / screenWidth, float(gridY) / screenHeight, sliceScale, sliceBias);
+    block.grid = glm::ivec4(gridX, gridY, gridZ, 0);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_blockBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ClusterBlock), &block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // Empty lists still get a texel, as a zero-sized buffer texture store isn't allowed
+    auto upload = [](GLuint buffer, const void *data, size_t size) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max(size, size_t(16)), nullptr, GL_STREAM_DRAW);
+        if (size > 0) {
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        }
+    };
+    if (m_lights != m_uploadedLights) {
+        upload(m_buffers[0], m_lights.data(), m_lights.size() * sizeof(glm::vec4));
+        m_uploadedLights = m_lights;
+    }
+    upload(m_buffers[1], m_table.data(), m_table.size() * sizeof(glm::uvec2));
+    upload(m_buffers[2], m_indices.data(), m_indices.size() * sizeof(std::uint32_t));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    // The textures stay bound to their units; nothing else uses those
+    const GLuint units[3] = {lightsUnit, tableUnit, indicesUnit};
+    for (int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE0 + units[i]);
+        glBindTexture(GL_TEXTURE_BUFFER, m_textures[i]);
+    }
+}
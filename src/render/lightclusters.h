@@ -0,0 +1,83 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "utils/scenedata.h"
+
+// Clustered assignment of point and spot lights. The view frustum is split into a grid of clusters,
+// screen tiles in x and y and exponential depth slices in z, and every frame each light is binned
+// into the clusters its range overlaps. Lit programs find their fragment's cluster and evaluate only
+// the lights listed for it, so the light count is no longer bounded by a uniform array.
+//
+// The GPU side is three buffer textures and a std140 Clusters block; the layouts live in
+// default.frag and terrain.frag:
+//   clusterLights   RGBA32F, four texels per light laid out like LightBuffer's Light
+//   clusterTable    RG32UI, offset and count into clusterIndices per cluster
+//   clusterIndices  R32UI, light indices
+class LightClusters
+{
+public:
+    static const int gridX = 16;
+    static const int gridY = 9;
+    static const int gridZ = 24;
+    static const int clusterCount = gridX * gridY * gridZ;
+    static const GLuint bindingPoint = 1;
+    // Texture units the buffer textures stay bound to; clear of the units the 2D textures use
+    static const GLuint lightsUnit = 4;
+    static const GLuint tableUnit = 5;
+    static const GLuint indicesUnit = 6;
+
+    // Safe to call again; anything created before is released first
+    void create();
+    void destroy();
+
+    // Points program's Clusters block at the binding point and its samplers at the units above;
+    // done once after linking, with program in use
+    static void bindProgram(GLuint program);
+
+    // Rebins the point and spot lights in lights for this view and uploads the result. Leaves
+    // GL_TEXTURE0 + indicesUnit active, so call it before anything that tracks the active unit.
+    void update(const std::vector<SceneLightData> &lights, const glm::mat4 &view, const glm::mat4 &proj,
+                float nearPlane, float farPlane, int screenWidth, int screenHeight);
+
+    size_t lightCount() const { return m_lights.size() / 4; }
+    size_t indexCount() const { return m_indices.size(); }
+
+private:
+    // The clusters one light overlaps, inclusive; empty if max < min on any axis
+    struct ClusterBounds {
+        glm::ivec3 min;
+        glm::ivec3 max;
+    };
+    struct ClusterBlock {
+        glm::vec4 viewDepth; // Dotted with a world position, gives its depth in front of the camera
+        glm::vec4 scale;     // Clusters per pixel in xy; slice = log(depth) * z + w
+        glm::ivec4 grid;
+    };
+    static_assert(sizeof(ClusterBlock) == 3 * sizeof(glm::vec4), "ClusterBlock must match the std140 layout");
+
+    // Distance past which the light's attenuated color stays under what 8-bit output can show
+    static float lightRange(const SceneLightData &light, float farPlane);
+
+    GLuint m_blockBuffer = 0;
+    GLuint m_buffers[3] = {0, 0, 0}; // Lights, table, indices
+    GLuint m_textures[3] = {0, 0, 0};
+    GLint m_maxTexels = 0;
+
+    std::vector<glm::vec4> m_lights;
+    std::vector<float> m_ranges;
+    std::vector<ClusterBounds> m_bounds;
+    std::vector<std::vector<std::uint32_t>> m_sliceIndices; // Per depth slice, then flattened into m_indices
+    std::vector<glm::uvec2> m_table;
+    std::vector<std::uint32_t> m_indices;
+    std::vector<glm::vec4> m_uploadedLights;
+    bool m_warnedOverflow = false;
+};
@@ -0,0 +1,67 @@
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+std::uint64_t makeSortKey(RenderPass pass, std::uint32_t program, std::uint32_t material, std::uint32_t texture, float depth) {
+    // Non-negative floats order the same as their bit patterns
+    depth = std::max(depth, 0.f);
+    std::uint32_t depthBits;
+    std::memcpy(&depthBits, &depth, sizeof(depthBits));
+    if (pass == RenderPass::Blended) {
+        return (std::uint64_t(pass) << 62) |
+               (std::uint64_t(~depthBits) << 30) |
+               (std::uint64_t(program & 0xF) << 26) |
+               (std::uint64_t(material & 0xFFFF) << 10) |
+               std::uint64_t(texture & 0x3FF);
+    }
+
+    return (std::uint64_t(pass) << 62) |
+           (std::uint64_t(program & 0xF) << 58) |
+           (std::uint64_t(material & 0xFFFF) << 42) |
+           (std::uint64_t(texture & 0x3FF) << 32) |
+           std::uint64_t(depthBits);
+}
+
+void RenderQueue::sort() {
+    // Insertion sort wins on the handful of draws a typical frame has
+    if (m_items.size() <= 32) {
+        for (size_t i = 1; i < m_items.size(); i++) {
+            RenderItem item = m_items[i];
+            size_t j = i;
+            for (; j > 0 && m_items[j - 1].key > item.key; j--) {
+                m_items[j] = m_items[j - 1];
+            }
+            m_items[j] = item;
+        }
+        return;
+    }
+
+    // One pass over the keys histograms all eight bytes
+    std::array<std::array<size_t, 256>, 8> counts = {};
+    for (const RenderItem &item : m_items) {
+        for (int byte = 0; byte < 8; byte++) {
+            counts[byte][(item.key >> (8 * byte)) & 0xFF]++;
+        }
+    }
+
+    m_scratch.resize(m_items.size());
+    for (int byte = 0; byte < 8; byte++) {
+        std::array<size_t, 256> &count = counts[byte];
+        if (count[(m_items.front().key >> (8 * byte)) & 0xFF] == m_items.size()) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t &bucket : count) {
+            size_t size = bucket;
+            bucket = offset;
+            offset += size;
+        }
+        for (const RenderItem &item : m_items) {
+            m_scratch[count[(item.key >> (8 * byte)) & 0xFF]++] = item;
+        }
+        m_items.swap(m_scratch);
+    }
+}
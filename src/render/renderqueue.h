@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Broad ordering of draws; everything in one pass is drawn before anything in the next
+enum class RenderPass : std::uint64_t {
+    Opaque = 0,
+    Blended = 1,
+};
+
+// Packs the state a draw needs into a key whose order groups draws by pass, then program,
+// material and texture, so sorting the keys minimizes state changes:
+//
+//   Opaque:   63-62 pass | 61-58 program | 57-42 material | 41-32 texture | 31-0 depth
+//   Blended:  63-62 pass | 61-30 depth | 29-26 program | 25-10 material | 9-0 texture
+//
+// Program, material and texture are small ids, truncated to their fields. Depth is the view-space
+// distance; opaque draws go front to back within a state group so early depth tests reject more.
+// Blended draws have to composite back to front whatever their state, so depth leads their key
+// and state only groups draws at the same depth.
+std::uint64_t makeSortKey(RenderPass pass, std::uint32_t program, std::uint32_t material, std::uint32_t texture, float depth);
+
+struct RenderItem {
+    std::uint64_t key;
+    std::uint32_t kind;  // What to draw, interpreted by whoever submits the queue
+    std::uint32_t index; // Which one of that kind
+};
+
+// A frame's draws, sorted by key before submission
+class RenderQueue
+{
+public:
+    void clear() { m_items.clear(); }
+    void push(std::uint64_t key, std::uint32_t kind, std::uint32_t index) { m_items.push_back({key, kind, index}); }
+
+    // Stable sort on the keys: least-significant-digit radix sort a byte at a time, or insertion
+    // sort for short queues. Bytes that are the same in every key, like the pass and program bits
+    // most frames, are skipped without moving anything.
+    void sort();
+
+    const std::vector<RenderItem> &items() const { return m_items; }
+
+private:
+    std::vector<RenderItem> m_items;
+    std::vector<RenderItem> m_scratch;
+};
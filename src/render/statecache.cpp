@@ -0,0 +1,67 @@
+#include "statecache.h"
+
+template <typename T>
+bool StateCache::update(T &current, bool &known, T value) {
+    if (known && current == value) {
+        m_skipped++;
+        return false;
+    }
+    current = value;
+    known = true;
+    m_changes++;
+    return true;
+}
+
+void StateCache::reset() {
+    m_programKnown = false;
+    m_vaoKnown = false;
+    m_activeUnitKnown = false;
+    m_texturesKnown.fill(false);
+    m_blendKnown = false;
+}
+
+bool StateCache::useProgram(GLuint program) {
+    if (!update(m_program, m_programKnown, program)) {
+        return false;
+    }
+    glUseProgram(program);
+    return true;
+}
+
+bool StateCache::bindVertexArray(GLuint vao) {
+    if (!update(m_vao, m_vaoKnown, vao)) {
+        return false;
+    }
+    glBindVertexArray(vao);
+    return true;
+}
+
+bool StateCache::bindTexture(GLuint unit, GLuint texture) {
+    if (update(m_activeUnit, m_activeUnitKnown, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    if (unit >= textureUnits) {
+        // Not tracked; always bind
+        m_changes++;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        return true;
+    }
+    if (!update(m_textures[unit], m_texturesKnown[unit], texture)) {
+        return false;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    return true;
+}
+
+bool StateCache::setBlend(bool enabled) {
+    if (!update(m_blend, m_blendKnown, enabled)) {
+        return false;
+    }
+    if (enabled) {
+        glEnable(GL_BLEND);
+    }
+    else {
+        glDisable(GL_BLEND);
+    }
+    return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <array>
+#include <cstddef>
+
+// Remembers the program, vertex array, 2D textures and blending last set through it, and skips
+// calls that wouldn't change anything. Code that sets any of these directly must call reset()
+// before the cache is used again.
+class StateCache
+{
+public:
+    static const int textureUnits = 8;
+
+    // Forgets everything, so the next call of each kind always reaches GL
+    void reset();
+
+    // Each returns whether the state actually changed
+    bool useProgram(GLuint program);
+    bool bindVertexArray(GLuint vao);
+    bool bindTexture(GLuint unit, GLuint texture); // GL_TEXTURE_2D; leaves unit active
+    bool setBlend(bool enabled);
+
+    // Since the last resetCounters, how many calls reached GL and how many were skipped
+    size_t changes() const { return m_changes; }
+    size_t skipped() const { return m_skipped; }
+    void resetCounters() { m_changes = m_skipped = 0; }
+
+private:
+    // Returns whether value differs from (or wasn't known in) current, and records it
+    template <typename T>
+    bool update(T &current, bool &known, T value);
+
+    GLuint m_program = 0;
+    GLuint m_vao = 0;
+    GLuint m_activeUnit = 0;
+    std::array<GLuint, textureUnits> m_textures = {};
+    bool m_blend = false;
+
+    bool m_programKnown = false;
+    bool m_vaoKnown = false;
+    bool m_activeUnitKnown = false;
+    std::array<bool, textureUnits> m_texturesKnown = {};
+    bool m_blendKnown = false;
+
+    size_t m_changes = 0;
+    size_t m_skipped = 0;
+};
@@ -0,0 +1,98 @@
+#include "streambuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Keeps every write, and so every vertex attribute offset into the buffer, comfortably aligned
+const size_t alignment = 16;
+
+size_t alignUp(size_t size) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+}
+
+void StreamBuffer::create(size_t regionSize) {
+    // Creating again, as on every scene load, replaces the old ring and its fences
+    destroy();
+    m_regionSize = alignUp(std::max<size_t>(regionSize, 1));
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, regionCount * m_regionSize, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    m_region = 0;
+    m_used = 0;
+}
+
+void StreamBuffer::destroy() {
+    for (GLsync &fence : m_fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    glDeleteBuffers(1, &m_buffer);
+    m_buffer = 0;
+}
+
+void StreamBuffer::waitForRegion(int region) {
+    GLsync &fence = m_fences[region];
+    if (!fence) {
+        return;
+    }
+    // Flush on the first wait so the fence is guaranteed to signal eventually
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(fence, flags, 1000000) == GL_TIMEOUT_EXPIRED) {
+        flags = 0;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+size_t StreamBuffer::write(const void *data, size_t size) {
+    if (m_used == 0) {
+        waitForRegion(m_region);
+    }
+
+    size_t offset = alignUp(m_used);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    if (offset + size > m_regionSize) {
+        // Respecifying the storage orphans the old copy, so draws already issued from it are unaffected
+        for (int region = 0; region < regionCount; region++) {
+            if (m_fences[region]) {
+                glDeleteSync(m_fences[region]);
+                m_fences[region] = nullptr;
+            }
+        }
+        m_regionSize = std::max(alignUp(size), m_regionSize * 2);
+        glBufferData(GL_COPY_WRITE_BUFFER, regionCount * m_regionSize, nullptr, GL_STREAM_DRAW);
+        m_region = 0;
+        offset = 0;
+    }
+
+    // The fence wait above already guarantees the GPU is done with this range
+    size_t start = size_t(m_region) * m_regionSize + offset;
+    void *mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, start, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (mapped) {
+        std::memcpy(mapped, data, size);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+    else {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, start, size, data);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    m_used = offset + size;
+    return start;
+}
+
+void StreamBuffer::endFrame() {
+    if (m_used == 0) {
+        return;
+    }
+    m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_region = (m_region + 1) % regionCount;
+    m_used = 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <cstddef>
+
+// Ring of regions in one buffer for data rewritten every frame. Each frame writes into its own
+// region through an unsynchronized mapping, and a fence marks when the GPU is done with it, so the
+// CPU only ever waits if it laps a region the GPU is still reading.
+class StreamBuffer
+{
+public:
+    static const int regionCount = 3;
+
+    // Safe to call again; any previous storage is released first
+    void create(size_t regionSize);
+    void destroy();
+
+    // Copies size bytes into this frame's region and returns their offset in buffer(), 16-byte
+    // aligned. The storage grows when a frame needs more than a region holds, which drops anything
+    // written earlier in the same frame, so write everything a frame needs before drawing from it.
+    size_t write(const void *data, size_t size);
+
+    // Fences the region written this frame once the draws reading it have been issued, and moves to the next
+    void endFrame();
+
+    GLuint buffer() const { return m_buffer; }
+
+private:
+    void waitForRegion(int region);
+
+    GLuint m_buffer = 0;
+    size_t m_regionSize = 0;
+    int m_region = 0;
+    size_t m_used = 0; // Bytes written to the current region this frame
+    GLsync m_fences[regionCount] = {};
+};
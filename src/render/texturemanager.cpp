@@ -0,0 +1,80 @@
+#include "texturemanager.h"
+
+#include <iostream>
+#include <QtConcurrent>
+
+TextureManager &TextureManager::instance() {
+    static TextureManager manager;
+    return manager;
+}
+
+// Runs on the worker pool; only touches its own QImage
+QImage TextureManager::decode(const QString &path) {
+    QImage image(path);
+    if (image.isNull()) {
+        return image;
+    }
+    // Format image to fit OpenGL
+    return image.convertToFormat(QImage::Format_RGBA8888).mirrored();
+}
+
+GLuint TextureManager::upload(const QImage &image) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width(), image.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, image.bits());
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+void TextureManager::request(const QString &path) {
+    if (m_entries.find(path) != m_entries.end()) {
+        return;
+    }
+    Entry &entry = m_entries[path];
+    entry.decode = QtConcurrent::run(&TextureManager::decode, path);
+}
+
+GLuint TextureManager::texture(const QString &path) {
+    request(path);
+    Entry &entry = m_entries[path];
+    if (entry.resolved) {
+        return entry.texture;
+    }
+    if (!entry.decode.isFinished()) {
+        return 0;
+    }
+
+    QImage image = entry.decode.result();
+    entry.decode = QFuture<QImage>();
+    entry.resolved = true;
+    if (image.isNull()) {
+        std::cerr << "Failed to load texture image: " << path.toStdString() << std::endl;
+        std::cerr << "Continue with no texture image." << std::endl;
+        return 0;
+    }
+    entry.texture = upload(image);
+    return entry.texture;
+}
+
+void TextureManager::waitForDecodes() {
+    for (auto &[path, entry] : m_entries) {
+        if (!entry.resolved) {
+            entry.decode.waitForFinished();
+        }
+    }
+}
+
+void TextureManager::clear() {
+    for (auto &[path, entry] : m_entries) {
+        // Don't leave a decode running against a manager that is being torn down
+        entry.decode.waitForFinished();
+        if (entry.texture) {
+            glDeleteTextures(1, &entry.texture);
+        }
+    }
+    m_entries.clear();
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <map>
+#include <QFuture>
+#include <QImage>
+#include <QString>
+
+// Process-wide owner of every image texture. Each file is decoded once on the worker pool,
+// then uploaded with a full mip chain the first time it's asked for after the decode finishes,
+// so neither startup nor scene load ever waits on image decode.
+class TextureManager
+{
+public:
+    static TextureManager &instance();
+
+    // Starts decoding path in the background unless it is already known
+    void request(const QString &path);
+
+    // Returns the GL texture for path, or 0 while it is still decoding or if it failed to load.
+    // Requests path if needed. Must be called with the GL context current.
+    GLuint texture(const QString &path);
+
+    // Blocks until every requested decode has finished, so the next texture() calls return them.
+    // For runs that need the same image every time, like offscreen benchmarks.
+    void waitForDecodes();
+
+    // Deletes every GL texture; call while the context is still current, e.g. on program exit
+    void clear();
+
+private:
+    TextureManager() = default;
+
+    struct Entry {
+        QFuture<QImage> decode;
+        GLuint texture = 0;
+        bool resolved = false; // Decode finished and was uploaded or reported as failed
+    };
+
+    static QImage decode(const QString &path);
+    static GLuint upload(const QImage &image);
+
+    std::map<QString, Entry> m_entries;
+};
@@ -0,0 +1,143 @@
+#include "viewportcapture.h"
+
+#include <QImage>
+#include <QtConcurrent>
+#include <cstring>
+#include <iostream>
+
+void ViewportCapture::resizeTarget(int width, int height) {
+    if (m_fbo != 0 && width == m_targetWidth && height == m_targetHeight) {
+        return;
+    }
+    if (m_fbo == 0) {
+        glGenFramebuffers(1, &m_fbo);
+        glGenRenderbuffers(1, &m_renderbuffer);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo);
+    glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_renderbuffer);
+    if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Error: Capture framebuffer is not complete!" << std::endl;
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    m_targetWidth = width;
+    m_targetHeight = height;
+}
+
+void ViewportCapture::capture(GLuint framebuffer, int width, int height, int outputWidth, int outputHeight, const QString &filePath) {
+    Slot &slot = m_slots[m_next];
+    if (slot.fence) {
+        complete(slot, true);
+    }
+    m_next = (m_next + 1) % ringSize;
+
+    // Scale into the pooled target; the blit stays on the GPU
+    resizeTarget(outputWidth, outputHeight);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, outputWidth, outputHeight, GL_COLOR_BUFFER_BIT,
+                      width == outputWidth && height == outputHeight ? GL_NEAREST : GL_LINEAR);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+    // Read into the slot's buffer; with a pack buffer bound, glReadPixels returns without waiting
+    size_t size = size_t(outputWidth) * outputHeight * 4;
+    if (slot.buffer == 0) {
+        glGenBuffers(1, &slot.buffer);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (size > slot.capacity) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        slot.capacity = size;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, outputWidth, outputHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.width = outputWidth;
+    slot.height = outputHeight;
+    slot.filePath = filePath;
+}
+
+void ViewportCapture::complete(Slot &slot, bool wait) {
+    GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GLuint64(1000000000) : 0);
+    if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+        if (wait) {
+            std::cerr << "Failed to read back capture for " << slot.filePath.toStdString() << std::endl;
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+        return;
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    // GL rows run bottom to top, so copy them in reverse
+    QImage image(slot.width, slot.height, QImage::Format_RGBA8888);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const unsigned char *pixels = static_cast<const unsigned char *>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size_t(slot.width) * slot.height * 4, GL_MAP_READ_BIT));
+    if (pixels) {
+        size_t rowSize = size_t(slot.width) * 4;
+        for (int y = 0; y < slot.height; y++) {
+            std::memcpy(image.scanLine(slot.height - 1 - y), pixels + y * rowSize, rowSize);
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!pixels) {
+        std::cerr << "Failed to map capture for " << slot.filePath.toStdString() << std::endl;
+        return;
+    }
+
+    QString filePath = slot.filePath;
+    m_encodes.push_back(QtConcurrent::run([image, filePath]() {
+        if (!image.save(filePath)) {
+            std::cerr << "Failed to save image to " << filePath.toStdString() << std::endl;
+        }
+    }));
+}
+
+void ViewportCapture::poll(bool wait) {
+    // Oldest first, so images are handed over in the order they were captured
+    for (int i = 0; i < ringSize; i++) {
+        Slot &slot = m_slots[(m_next + i) % ringSize];
+        if (slot.fence) {
+            complete(slot, wait);
+        }
+    }
+    std::erase_if(m_encodes, [](const QFuture<void> &encode) { return encode.isFinished(); });
+}
+
+bool ViewportCapture::pending() const {
+    for (const Slot &slot : m_slots) {
+        if (slot.fence) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ViewportCapture::finish() {
+    poll(true);
+    for (QFuture<void> &encode : m_encodes) {
+        encode.waitForFinished();
+    }
+    m_encodes.clear();
+}
+
+void ViewportCapture::destroy() {
+    finish();
+    for (Slot &slot : m_slots) {
+        glDeleteBuffers(1, &slot.buffer);
+        slot = Slot();
+    }
+    glDeleteRenderbuffers(1, &m_renderbuffer);
+    glDeleteFramebuffers(1, &m_fbo);
+    m_renderbuffer = 0;
+    m_fbo = 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <QFuture>
+#include <QString>
+#include <vector>
+
+// Saves framebuffer contents as images without stalling rendering. Each capture is scaled into a
+// pooled target, read into the next of a ring of pixel pack buffers and fenced; a later poll maps
+// the buffer once the GPU is done with it and hands the PNG encode to the worker pool.
+class ViewportCapture
+{
+public:
+    static const int ringSize = 3;
+
+    // Frees the GL objects after finishing every capture in flight; needs the context current
+    void destroy();
+
+    // Queues a capture of framebuffer's width x height color contents, scaled to outputWidth x
+    // outputHeight. If every buffer in the ring is still busy, waits for the oldest.
+    void capture(GLuint framebuffer, int width, int height, int outputWidth, int outputHeight, const QString &filePath);
+
+    // Hands finished readbacks to the encoder; call once a frame. With wait, finishes all of them.
+    void poll(bool wait = false);
+
+    // Whether any capture is still being read back
+    bool pending() const;
+
+    // Finishes every readback and waits for every encode
+    void finish();
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+        int width = 0;
+        int height = 0;
+        QString filePath;
+    };
+
+    void resizeTarget(int width, int height);
+    void complete(Slot &slot, bool wait);
+
+    GLuint m_fbo = 0; // Pooled target, resized only when the output size changes
+    GLuint m_renderbuffer = 0;
+    int m_targetWidth = 0;
+    int m_targetHeight = 0;
+
+    Slot m_slots[ringSize];
+    int m_next = 0;
+    std::vector<QFuture<void>> m_encodes;
+};
@@ -6,9 +6,13 @@
 struct Settings {
     std::string sceneFilePath;
     std::string heightMapPath;
+    bool watchScene = false; // Reload the scene file whenever it changes on disk
+    bool frustumCulling = true; // Skip scene shapes outside the view
+    bool frameTimings = false; // Time frame stages and show the results over the viewport; also logs mesh load and welding statistics
     int speed = 1;
     int bumpiness = 1;
     int shapeParameter2 = 1;
+    float creaseAngle = 60.f; // Degrees; generated mesh normals are only split across sharper edges
     float nearPlane = 1;
     float farPlane = 1;
     bool perPixelFilter = false;
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cassert>
 #include <cstdint>
+#include <span>
 #include <vector>
 #include <iostream>
 #include <cmath>
@@ -18,12 +20,46 @@ struct RGBA {
     std::uint8_t a = 255;
 };
 
-struct ImageData {
-    std::vector<RGBA> data;
-    int width;
-    int height;
-};
-
-std::vector<RGBA> loadImage(const QString &filePath, int &width, int &height);
 void insertVec3(std::vector<float>& data, const glm::vec3& v);
 void insertVec2(std::vector<float>& data, const glm::vec2& v);
+
+// Writes interleaved vertices (position, normal, uv) into caller-provided storage, which may be a mapped GPU buffer.
+// The storage must be sized exactly from the generator's reported vertex count; nothing is allocated here.
+class VertexWriter {
+public:
+    explicit VertexWriter(std::span<float> out) : m_out(out) {}
+
+    void write(const glm::vec3 &position, const glm::vec3 &normal, const glm::vec2 &uv) {
+        assert(m_size + 8 <= m_out.size());
+        float *v = m_out.data() + m_size;
+        v[0] = position.x; v[1] = position.y; v[2] = position.z;
+        v[3] = normal.x;   v[4] = normal.y;   v[5] = normal.z;
+        v[6] = uv.x;       v[7] = uv.y;
+        m_size += 8;
+    }
+
+    // Index of the next vertex to be written
+    std::uint16_t vertexCount() const { return static_cast<std::uint16_t>(m_size / 8); }
+
+private:
+    std::span<float> m_out;
+    size_t m_size = 0;
+};
+
+// Writes a 16-bit triangle list into caller-provided storage
+class IndexWriter {
+public:
+    explicit IndexWriter(std::span<std::uint16_t> out) : m_out(out) {}
+
+    void triangle(std::uint16_t a, std::uint16_t b, std::uint16_t c) {
+        assert(m_size + 3 <= m_out.size());
+        m_out[m_size] = a;
+        m_out[m_size + 1] = b;
+        m_out[m_size + 2] = c;
+        m_size += 3;
+    }
+
+private:
+    std::span<std::uint16_t> m_out;
+    size_t m_size = 0;
+};
@@ -1,14 +1,12 @@
 #include "Cone.h"
 
 void Cone::updateParams(int param1, int param2, bool isTexture, float repeatU, float repeatV, QString imgPath) {
-    m_vertexData = std::vector<float>();
     m_param1 = param1;
     m_param2 = param2;
     this->isTexture = isTexture;
     this->repeatU = repeatU;
     this->repeatV = repeatV;
     this->imgPath = imgPath;
-    setVertexData();
 }
 
 void Cone::makeTile(glm::vec3 topLeft,
@@ -131,7 +129,7 @@ void Cone::makeSide(float currentTheta, float nextTheta, float thetaStep) {
 
         glm::vec3 bottomMiddle = {(i + 1) * step * glm::sin(currentTheta + thetaStep / 2), 0.5 - (i + 1) * yStep, (i + 1) * step * glm::cos(currentTheta + thetaStep / 2)};
 
-        std::vector<glm::vec2> tileTextureUV = calculateTileTextureUV(topLeft, topRight, bottomLeft, bottomRight);
+        std::array<glm::vec2, 4> tileTextureUV = calculateTileTextureUV(topLeft, topRight, bottomLeft, bottomRight);
         glm::vec2 topLeftTexture = tileTextureUV.at(0);
         glm::vec2 topRightTexture = tileTextureUV.at(1);
         glm::vec2 bottomLeftTexture = tileTextureUV.at(2);
@@ -151,7 +149,7 @@ void Cone::makeCap(float currentTheta, float nextTheta) {
         glm::vec3 bottomRight = {(i + 1) * step * glm::sin(currentTheta), -0.5, (i + 1) * step * glm::cos(currentTheta)};
         glm::vec3 bottomLeft = {(i + 1) * step * glm::sin(nextTheta), -0.5, (i + 1) * step * glm::cos(nextTheta)};
 
-        std::vector<glm::vec2> tileTextureUV = calculateTileTextureUV(topLeft, topRight, bottomLeft, bottomRight);
+        std::array<glm::vec2, 4> tileTextureUV = calculateTileTextureUV(topLeft, topRight, bottomLeft, bottomRight);
         glm::vec2 topLeftTexture = tileTextureUV.at(0);
         glm::vec2 topRightTexture = tileTextureUV.at(1);
         glm::vec2 bottomLeftTexture = tileTextureUV.at(2);
@@ -161,11 +159,11 @@ void Cone::makeCap(float currentTheta, float nextTheta) {
     }
 }
 
-std::vector<glm::vec2> Cone::calculateTileTextureUV(glm::vec3 topLeft,
+std::array<glm::vec2, 4> Cone::calculateTileTextureUV(glm::vec3 topLeft,
                                                     glm::vec3 topRight,
                                                     glm::vec3 bottomLeft,
                                                     glm::vec3 bottomRight) {
-    std::vector<glm::vec2> tileTextureUV;
+    std::array<glm::vec2, 4> tileTextureUV;
 
     glm::vec2 topLeftTexture;
     if (isTexture) {
@@ -174,7 +172,7 @@ std::vector<glm::vec2> Cone::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         topLeftTexture = {0,0};
     }
-    tileTextureUV.push_back(topLeftTexture);
+    tileTextureUV[0] = topLeftTexture;
 
     glm::vec2 topRightTexture;
     if (isTexture) {
@@ -183,7 +181,7 @@ std::vector<glm::vec2> Cone::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         topRightTexture = {0,0};
     }
-    tileTextureUV.push_back(topRightTexture);
+    tileTextureUV[1] = topRightTexture;
 
     glm::vec2 bottomLeftTexture;
     if (isTexture) {
@@ -192,7 +190,7 @@ std::vector<glm::vec2> Cone::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         bottomLeftTexture = {0,0};
     }
-    tileTextureUV.push_back(bottomLeftTexture);
+    tileTextureUV[2] = bottomLeftTexture;
 
     glm::vec2 bottomRightTexture;
     if (isTexture) {
@@ -201,7 +199,7 @@ std::vector<glm::vec2> Cone::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         bottomRightTexture = {0,0};
     }
-    tileTextureUV.push_back(bottomRightTexture);
+    tileTextureUV[3] = bottomRightTexture;
 
     return tileTextureUV;
 }
@@ -254,3 +252,90 @@ void Cone::setVertexData() {
         makeCap(currentTheta, nextTheta);
     }
 }
+
+size_t Cone::indexedVertexCount() const {
+    // One tip vertex per wedge, the side grid below the tip and the cap grid
+    return m_param2 + m_param1 * (m_param2 + 1) + (m_param1 + 1) * (m_param2 + 1);
+}
+
+size_t Cone::indexedIndexCount() const {
+    // The tip row and the cap center have one triangle per wedge, every other tile has two
+    return 3 * m_param2 * (2 * m_param1 - 1) * 2;
+}
+
+void Cone::generateIndexedShape(std::span<float> vertices, std::span<std::uint16_t> indices) {
+    VertexWriter vertexWriter(vertices);
+    IndexWriter indexWriter(indices);
+
+    float thetaStep = glm::radians(360.f / m_param2);
+    float yStep = 1.0 / m_param1;
+    float step = m_radius / m_param1;
+    int columns = m_param2 + 1;
+
+    auto texture = [this](glm::vec3 position) {
+        return isTexture ? coneTexture(position, repeatU, repeatV) : glm::vec2(0, 0);
+    };
+    auto sideNormal = [](glm::vec3 position) {
+        glm::vec3 radialComponent = glm::normalize(glm::vec3(position.x, 0, position.z));
+        return glm::normalize(glm::vec3(radialComponent.x, 0.5, radialComponent.z));
+    };
+
+    // Tip: one vertex per wedge, facing the middle of the wedge like makeTileSide()
+    std::uint16_t tipStart = vertexWriter.vertexCount();
+    for (int j = 0; j < m_param2; j++) {
+        float nextTheta = (j + 1) * thetaStep;
+        glm::vec3 position = {0 * step * glm::sin(nextTheta), 0.5, 0 * step * glm::cos(nextTheta)};
+        glm::vec3 middle = {step * glm::sin(j * thetaStep + thetaStep / 2), 0, step * glm::cos(j * thetaStep + thetaStep / 2)};
+        vertexWriter.write(position, sideNormal(middle), texture(position));
+    }
+
+    // Side: one vertex per (row, theta) grid point below the tip
+    std::uint16_t sideStart = vertexWriter.vertexCount();
+    for (int i = 1; i <= m_param1; i++) {
+        for (int j = 0; j <= m_param2; j++) {
+            float theta = j * thetaStep;
+            glm::vec3 position = {i * step * glm::sin(theta), 0.5 - i * yStep, i * step * glm::cos(theta)};
+            vertexWriter.write(position, sideNormal(position), texture(position));
+        }
+    }
+
+    // Bottom cap: one vertex per (ring, theta) grid point with a constant normal
+    std::uint16_t capStart = vertexWriter.vertexCount();
+    for (int i = 0; i <= m_param1; i++) {
+        for (int j = 0; j <= m_param2; j++) {
+            float theta = j * thetaStep;
+            glm::vec3 position = {i * step * glm::sin(theta), -0.5, i * step * glm::cos(theta)};
+            vertexWriter.write(position, glm::vec3(0, -1, 0), texture(position));
+        }
+    }
+
+    // Same winding as makeTileSide() and makeTile(); zero-area triangles at the tip and cap center are skipped
+    auto sideVertex = [&](int row, int column) -> std::uint16_t {
+        return sideStart + (row - 1) * columns + column;
+    };
+    for (int i = 0; i < m_param1; i++) {
+        for (int j = 0; j < m_param2; j++) {
+            std::uint16_t bottomLeft = sideVertex(i + 1, j);
+            std::uint16_t bottomRight = sideVertex(i + 1, j + 1);
+            if (i == 0) {
+                indexWriter.triangle(tipStart + j, bottomLeft, bottomRight);
+            }
+            else {
+                std::uint16_t topLeft = sideVertex(i, j);
+                std::uint16_t topRight = sideVertex(i, j + 1);
+                indexWriter.triangle(topLeft, bottomLeft, topRight);
+                indexWriter.triangle(topRight, bottomLeft, bottomRight);
+            }
+
+            // The cap is mirrored, so left and right swap
+            std::uint16_t topRight = capStart + i * columns + j;
+            std::uint16_t topLeft = topRight + 1;
+            bottomRight = topRight + columns;
+            bottomLeft = bottomRight + 1;
+            if (i > 0) {
+                indexWriter.triangle(topLeft, bottomLeft, topRight);
+            }
+            indexWriter.triangle(topRight, bottomLeft, bottomRight);
+        }
+    }
+}
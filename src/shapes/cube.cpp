@@ -5,13 +5,11 @@
 #include <algorithm>
 
 void Cube::updateParams(int param1, bool isTexture, float repeatU, float repeatV, QString imgPath) {
-    m_vertexData = std::vector<float>();
     m_param1 = param1;
     this->isTexture = isTexture;
     this->repeatU = repeatU;
     this->repeatV = repeatV;
     this->imgPath = imgPath;
-    setVertexData();
 }
 
 
@@ -73,7 +71,7 @@ void Cube::makeFace(glm::vec3 topLeft,
                     glm::vec3 bottomRightTile = bottomLeftTile + glm::vec3(stepU, 0, 0);
                     glm::vec3 topRightTile = bottomLeftTile + glm::vec3(stepU, stepV, 0);
 
-                    std::vector<glm::vec2> tileTextureUV = calculateTileTextureUV(topLeftTile, topRightTile, bottomLeftTile, bottomRightTile);
+                    std::array<glm::vec2, 4> tileTextureUV = calculateTileTextureUV(topLeftTile, topRightTile, bottomLeftTile, bottomRightTile);
                     glm::vec2 topLeftTexture = tileTextureUV.at(0);
                     glm::vec2 topRightTexture = tileTextureUV.at(1);
                     glm::vec2 bottomLeftTexture = tileTextureUV.at(2);
@@ -91,7 +89,7 @@ void Cube::makeFace(glm::vec3 topLeft,
                     glm::vec3 bottomLeftTile = bottomRightTile + glm::vec3(stepU, 0, 0);
                     glm::vec3 topRightTile = bottomRightTile + glm::vec3(0, stepV, 0);
 
-                    std::vector<glm::vec2> tileTextureUV = calculateTileTextureUV(topLeftTile, topRightTile, bottomLeftTile, bottomRightTile);
+                    std::array<glm::vec2, 4> tileTextureUV = calculateTileTextureUV(topLeftTile, topRightTile, bottomLeftTile, bottomRightTile);
                     glm::vec2 topLeftTexture = tileTextureUV.at(0);
                     glm::vec2 topRightTexture = tileTextureUV.at(1);
                     glm::vec2 bottomLeftTexture = tileTextureUV.at(2);
@@ -112,7 +110,7 @@ void Cube::makeFace(glm::vec3 topLeft,
                     glm::vec3 bottomRightTile = bottomLeftTile + glm::vec3(0, stepU, 0);
                     glm::vec3 topRightTile = bottomLeftTile + glm::vec3(0, stepV, stepU);
 
-                    std::vector<glm::vec2> tileTextureUV = calculateTileTextureUV(topLeftTile, topRightTile, bottomLeftTile, bottomRightTile);
+                    std::array<glm::vec2, 4> tileTextureUV = calculateTileTextureUV(topLeftTile, topRightTile, bottomLeftTile, bottomRightTile);
                     glm::vec2 topLeftTexture = tileTextureUV.at(0);
                     glm::vec2 topRightTexture = tileTextureUV.at(1);
                     glm::vec2 bottomLeftTexture = tileTextureUV.at(2);
@@ -130,7 +128,7 @@ void Cube::makeFace(glm::vec3 topLeft,
                     glm::vec3 bottomLeftTile = bottomRightTile + glm::vec3(0, stepU, 0);
                     glm::vec3 topLeftTile = bottomRightTile + glm::vec3(0, stepU, stepV);
 
-                    std::vector<glm::vec2> tileTextureUV = calculateTileTextureUV(topLeftTile, topRightTile, bottomLeftTile, bottomRightTile);
+                    std::array<glm::vec2, 4> tileTextureUV = calculateTileTextureUV(topLeftTile, topRightTile, bottomLeftTile, bottomRightTile);
                     glm::vec2 topLeftTexture = tileTextureUV.at(0);
                     glm::vec2 topRightTexture = tileTextureUV.at(1);
                     glm::vec2 bottomLeftTexture = tileTextureUV.at(2);
@@ -151,7 +149,7 @@ void Cube::makeFace(glm::vec3 topLeft,
                     glm::vec3 bottomRightTile = bottomLeftTile + glm::vec3(stepU, 0, 0);
                     glm::vec3 topRightTile = bottomLeftTile + glm::vec3(stepU, 0, stepV);
 
-                    std::vector<glm::vec2> tileTextureUV = calculateTileTextureUV(topLeftTile, topRightTile, bottomLeftTile, bottomRightTile);
+                    std::array<glm::vec2, 4> tileTextureUV = calculateTileTextureUV(topLeftTile, topRightTile, bottomLeftTile, bottomRightTile);
                     glm::vec2 topLeftTexture = tileTextureUV.at(0);
                     glm::vec2 topRightTexture = tileTextureUV.at(1);
                     glm::vec2 bottomLeftTexture = tileTextureUV.at(2);
@@ -169,7 +167,7 @@ void Cube::makeFace(glm::vec3 topLeft,
                     glm::vec3 bottomLeftTile = bottomRightTile + glm::vec3(stepU, 0, 0);
                     glm::vec3 topLeftTile = bottomRightTile + glm::vec3(stepU, 0, stepV);
 
-                    std::vector<glm::vec2> tileTextureUV = calculateTileTextureUV(topLeftTile, topRightTile, bottomLeftTile, bottomRightTile);
+                    std::array<glm::vec2, 4> tileTextureUV = calculateTileTextureUV(topLeftTile, topRightTile, bottomLeftTile, bottomRightTile);
                     glm::vec2 topLeftTexture = tileTextureUV.at(0);
                     glm::vec2 topRightTexture = tileTextureUV.at(1);
                     glm::vec2 bottomLeftTexture = tileTextureUV.at(2);
@@ -182,11 +180,11 @@ void Cube::makeFace(glm::vec3 topLeft,
     }
 }
 
-std::vector<glm::vec2> Cube::calculateTileTextureUV(glm::vec3 topLeft,
+std::array<glm::vec2, 4> Cube::calculateTileTextureUV(glm::vec3 topLeft,
                                                     glm::vec3 topRight,
                                                     glm::vec3 bottomLeft,
                                                     glm::vec3 bottomRight) {
-    std::vector<glm::vec2> tileTextureUV;
+    std::array<glm::vec2, 4> tileTextureUV;
 
     glm::vec2 topLeftTexture;
     if (isTexture) {
@@ -195,7 +193,7 @@ std::vector<glm::vec2> Cube::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         topLeftTexture = {0,0};
     }
-    tileTextureUV.push_back(topLeftTexture);
+    tileTextureUV[0] = topLeftTexture;
 
     glm::vec2 topRightTexture;
     if (isTexture) {
@@ -204,7 +202,7 @@ std::vector<glm::vec2> Cube::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         topRightTexture = {0,0};
     }
-    tileTextureUV.push_back(topRightTexture);
+    tileTextureUV[1] = topRightTexture;
 
     glm::vec2 bottomLeftTexture;
     if (isTexture) {
@@ -213,7 +211,7 @@ std::vector<glm::vec2> Cube::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         bottomLeftTexture = {0,0};
     }
-    tileTextureUV.push_back(bottomLeftTexture);
+    tileTextureUV[2] = bottomLeftTexture;
 
     glm::vec2 bottomRightTexture;
     if (isTexture) {
@@ -222,7 +220,7 @@ std::vector<glm::vec2> Cube::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         bottomRightTexture = {0,0};
     }
-    tileTextureUV.push_back(bottomRightTexture);
+    tileTextureUV[3] = bottomRightTexture;
 
     return tileTextureUV;
 }
@@ -309,3 +307,59 @@ void Cube::setVertexData() {
              glm::vec3(-0.5f, -0.5f, -0.5f),
              5);
 }
+
+size_t Cube::indexedVertexCount() const {
+    return 6 * (m_param1 + 1) * (m_param1 + 1);
+}
+
+size_t Cube::indexedIndexCount() const {
+    return 6 * 6 * m_param1 * m_param1;
+}
+
+void Cube::generateIndexedShape(std::span<float> vertices, std::span<std::uint16_t> indices) {
+    VertexWriter vertexWriter(vertices);
+    IndexWriter indexWriter(indices);
+
+    // Each face is spanned from one corner by two unit axes whose cross product is the outward normal
+    struct Face {
+        glm::vec3 origin;
+        glm::vec3 uAxis;
+        glm::vec3 vAxis;
+    };
+    const Face faces[6] = {
+        {{-0.5f, -0.5f,  0.5f}, { 1, 0,  0}, {0, 1,  0}}, // +z
+        {{ 0.5f, -0.5f, -0.5f}, {-1, 0,  0}, {0, 1,  0}}, // -z
+        {{ 0.5f, -0.5f,  0.5f}, { 0, 0, -1}, {0, 1,  0}}, // +x
+        {{-0.5f, -0.5f, -0.5f}, { 0, 0,  1}, {0, 1,  0}}, // -x
+        {{-0.5f,  0.5f,  0.5f}, { 1, 0,  0}, {0, 0, -1}}, // +y
+        {{-0.5f, -0.5f, -0.5f}, { 1, 0,  0}, {0, 0,  1}}, // -y
+    };
+
+    float step = 1.0 / m_param1;
+    int columns = m_param1 + 1;
+
+    for (const Face &face : faces) {
+        std::uint16_t faceStart = vertexWriter.vertexCount();
+        glm::vec3 normal = glm::cross(face.uAxis, face.vAxis);
+
+        for (int i = 0; i <= m_param1; i++) {
+            for (int j = 0; j <= m_param1; j++) {
+                glm::vec3 position = face.origin + face.uAxis * (j * step) + face.vAxis * (i * step);
+                vertexWriter.write(position, normal, isTexture ? cubeTexture(position, repeatU, repeatV) : glm::vec2(0, 0));
+            }
+        }
+
+        // Counter-clockwise around the outward normal
+        for (int i = 0; i < m_param1; i++) {
+            for (int j = 0; j < m_param1; j++) {
+                std::uint16_t bottomLeft = faceStart + i * columns + j;
+                std::uint16_t bottomRight = bottomLeft + 1;
+                std::uint16_t topLeft = bottomLeft + columns;
+                std::uint16_t topRight = topLeft + 1;
+
+                indexWriter.triangle(bottomLeft, bottomRight, topRight);
+                indexWriter.triangle(bottomLeft, topRight, topLeft);
+            }
+        }
+    }
+}
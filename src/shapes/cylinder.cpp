@@ -1,14 +1,12 @@
 #include "Cylinder.h"
 
 void Cylinder::updateParams(int param1, int param2, bool isTexture, float repeatU, float repeatV, QString imgPath) {
-    m_vertexData = std::vector<float>();
     m_param1 = param1;
     m_param2 = param2;
     this->isTexture = isTexture;
     this->repeatU = repeatU;
     this->repeatV = repeatV;
     this->imgPath = imgPath;
-    setVertexData();
 }
 
 void Cylinder::makeTile(glm::vec3 topLeft,
@@ -108,7 +106,7 @@ void Cylinder::makeSide(float currentTheta, float nextTheta) {
         glm::vec3 bottomLeft = {xLeft, 0.5 - (i + 1) * yStep, zLeft};
         glm::vec3 bottomRight = {xRight, 0.5 - (i + 1) * yStep, zRight};
 
-        std::vector<glm::vec2> tileTextureUV = calculateTileTextureUV(topLeft, topRight, bottomLeft, bottomRight);
+        std::array<glm::vec2, 4> tileTextureUV = calculateTileTextureUV(topLeft, topRight, bottomLeft, bottomRight);
         glm::vec2 topLeftTexture = tileTextureUV.at(0);
         glm::vec2 topRightTexture = tileTextureUV.at(1);
         glm::vec2 bottomLeftTexture = tileTextureUV.at(2);
@@ -128,7 +126,7 @@ void Cylinder::makeCap(float currentTheta, float nextTheta) {
         glm::vec3 bottomLeft = {(i + 1) * step * glm::sin(currentTheta), 0.5, (i + 1) * step * glm::cos(currentTheta)};
         glm::vec3 bottomRight = {(i + 1) * step * glm::sin(nextTheta), 0.5, (i + 1) * step * glm::cos(nextTheta)};
 
-        std::vector<glm::vec2> tileTextureUV = calculateTileTextureUV(topLeft, topRight, bottomLeft, bottomRight);
+        std::array<glm::vec2, 4> tileTextureUV = calculateTileTextureUV(topLeft, topRight, bottomLeft, bottomRight);
         glm::vec2 topLeftTexture = tileTextureUV.at(0);
         glm::vec2 topRightTexture = tileTextureUV.at(1);
         glm::vec2 bottomLeftTexture = tileTextureUV.at(2);
@@ -144,7 +142,7 @@ void Cylinder::makeCap(float currentTheta, float nextTheta) {
         glm::vec3 bottomRight = {(i + 1) * step * glm::sin(currentTheta), -0.5, (i + 1) * step * glm::cos(currentTheta)};
         glm::vec3 bottomLeft = {(i + 1) * step * glm::sin(nextTheta), -0.5, (i + 1) * step * glm::cos(nextTheta)};
 
-        std::vector<glm::vec2> tileTextureUV = calculateTileTextureUV(topLeft, topRight, bottomLeft, bottomRight);
+        std::array<glm::vec2, 4> tileTextureUV = calculateTileTextureUV(topLeft, topRight, bottomLeft, bottomRight);
         glm::vec2 topLeftTexture = tileTextureUV.at(0);
         glm::vec2 topRightTexture = tileTextureUV.at(1);
         glm::vec2 bottomLeftTexture = tileTextureUV.at(2);
@@ -154,11 +152,11 @@ void Cylinder::makeCap(float currentTheta, float nextTheta) {
     }
 }
 
-std::vector<glm::vec2> Cylinder::calculateTileTextureUV(glm::vec3 topLeft,
+std::array<glm::vec2, 4> Cylinder::calculateTileTextureUV(glm::vec3 topLeft,
                                                       glm::vec3 topRight,
                                                       glm::vec3 bottomLeft,
                                                       glm::vec3 bottomRight) {
-    std::vector<glm::vec2> tileTextureUV;
+    std::array<glm::vec2, 4> tileTextureUV;
 
     glm::vec2 topLeftTexture;
     if (isTexture) {
@@ -167,7 +165,7 @@ std::vector<glm::vec2> Cylinder::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         topLeftTexture = {0,0};
     }
-    tileTextureUV.push_back(topLeftTexture);
+    tileTextureUV[0] = topLeftTexture;
 
     glm::vec2 topRightTexture;
     if (isTexture) {
@@ -176,7 +174,7 @@ std::vector<glm::vec2> Cylinder::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         topRightTexture = {0,0};
     }
-    tileTextureUV.push_back(topRightTexture);
+    tileTextureUV[1] = topRightTexture;
 
     glm::vec2 bottomLeftTexture;
     if (isTexture) {
@@ -185,7 +183,7 @@ std::vector<glm::vec2> Cylinder::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         bottomLeftTexture = {0,0};
     }
-    tileTextureUV.push_back(bottomLeftTexture);
+    tileTextureUV[2] = bottomLeftTexture;
 
     glm::vec2 bottomRightTexture;
     if (isTexture) {
@@ -194,7 +192,7 @@ std::vector<glm::vec2> Cylinder::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         bottomRightTexture = {0,0};
     }
-    tileTextureUV.push_back(bottomRightTexture);
+    tileTextureUV[3] = bottomRightTexture;
 
     return tileTextureUV;
 }
@@ -251,3 +249,87 @@ void Cylinder::makeCylinder() {
 void Cylinder::setVertexData() {
     makeCylinder();
 }
+
+size_t Cylinder::indexedVertexCount() const {
+    // Side, top cap and bottom cap grids
+    return 3 * (m_param1 + 1) * (m_param2 + 1);
+}
+
+size_t Cylinder::indexedIndexCount() const {
+    // Each cap loses one triangle per wedge at its center
+    return 6 * m_param1 * m_param2 + 2 * 3 * m_param2 * (2 * m_param1 - 1);
+}
+
+void Cylinder::generateIndexedShape(std::span<float> vertices, std::span<std::uint16_t> indices) {
+    VertexWriter vertexWriter(vertices);
+    IndexWriter indexWriter(indices);
+
+    float thetaStep = glm::radians(360.f / m_param2);
+    float yStep = 1.0 / m_param1;
+    float step = m_radius / m_param1;
+    int columns = m_param2 + 1;
+
+    auto texture = [this](glm::vec3 position) {
+        return isTexture ? cylinderTexture(position, repeatU, repeatV) : glm::vec2(0, 0);
+    };
+
+    // Side: one vertex per (height, theta) grid point, normals point away from the axis
+    std::uint16_t sideStart = vertexWriter.vertexCount();
+    for (int i = 0; i <= m_param1; i++) {
+        for (int j = 0; j <= m_param2; j++) {
+            float theta = j * thetaStep;
+            glm::vec3 position = {m_radius * glm::sin(theta), 0.5 - i * yStep, m_radius * glm::cos(theta)};
+            vertexWriter.write(position, glm::normalize(glm::vec3(position.x, 0, position.z)), texture(position));
+        }
+    }
+
+    // Caps: one vertex per (ring, theta) grid point with a constant normal
+    std::uint16_t topCapStart = vertexWriter.vertexCount();
+    for (int i = 0; i <= m_param1; i++) {
+        for (int j = 0; j <= m_param2; j++) {
+            float theta = j * thetaStep;
+            glm::vec3 position = {i * step * glm::sin(theta), 0.5, i * step * glm::cos(theta)};
+            vertexWriter.write(position, glm::vec3(0, 1, 0), texture(position));
+        }
+    }
+
+    std::uint16_t bottomCapStart = vertexWriter.vertexCount();
+    for (int i = 0; i <= m_param1; i++) {
+        for (int j = 0; j <= m_param2; j++) {
+            float theta = j * thetaStep;
+            glm::vec3 position = {i * step * glm::sin(theta), -0.5, i * step * glm::cos(theta)};
+            vertexWriter.write(position, glm::vec3(0, -1, 0), texture(position));
+        }
+    }
+
+    // Same winding as makeTileSide() and makeTile(); the zero-area triangle touching each cap center is skipped
+    for (int i = 0; i < m_param1; i++) {
+        for (int j = 0; j < m_param2; j++) {
+            std::uint16_t topLeft = sideStart + i * columns + j;
+            std::uint16_t topRight = topLeft + 1;
+            std::uint16_t bottomLeft = topLeft + columns;
+            std::uint16_t bottomRight = bottomLeft + 1;
+            indexWriter.triangle(topLeft, bottomLeft, bottomRight);
+            indexWriter.triangle(topLeft, bottomRight, topRight);
+
+            topLeft = topCapStart + i * columns + j;
+            topRight = topLeft + 1;
+            bottomLeft = topLeft + columns;
+            bottomRight = bottomLeft + 1;
+            indexWriter.triangle(topLeft, bottomLeft, bottomRight);
+            if (i > 0) {
+                indexWriter.triangle(topLeft, bottomRight, topRight);
+            }
+
+            // The bottom cap is mirrored, so left and right swap
+            topRight = bottomCapStart + i * columns + j;
+            topLeft = topRight + 1;
+            bottomRight = topRight + columns;
+            bottomLeft = bottomRight + 1;
+            indexWriter.triangle(topLeft, bottomLeft, bottomRight);
+            if (i > 0) {
+                indexWriter.triangle(topLeft, bottomRight, topRight);
+            }
+        }
+    }
+}
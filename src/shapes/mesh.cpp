@@ -1,123 +1,564 @@
 #include "mesh.h"
 
-#include <fstream>
-#include <sstream>
+#include <charconv>
+#include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <stdexcept>
-#include <iostream>>
+#include <iostream>
+#include <QFile>
+#include <QThread>
+#include <QtConcurrent>
+#include "meshoptimizer.h"
+#include "meshsimplifier.h"
+#include "settings.h"
 
-// Note: error handling added for invalid mesh file
-Mesh loadMesh(const std::string& filePath) {
-    std::ifstream file(filePath);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open .obj file");
+namespace {
+
+// A run of whole lines handled by one worker. The counting pass fills in the element counts,
+// their prefix sums give every chunk its own slice of the mesh arrays, and the parsing pass
+// then writes straight into those slices.
+struct ObjChunk {
+    const char *begin;
+    const char *end;
+
+    size_t vertexCount = 0;
+    size_t texcoordCount = 0;
+    size_t normalCount = 0;
+    size_t faceCount = 0; // Triangles after fan triangulation
+
+    size_t vertexBase = 0;
+    size_t texcoordBase = 0;
+    size_t normalBase = 0;
+    size_t faceBase = 0;
+
+    bool missingNormals = false; // Some face corner has no vn
+    std::string error;
+};
+
+enum class ObjLine {
+    Vertex,
+    Texcoord,
+    Normal,
+    Face,
+    Other
+};
+
+struct ObjCorner {
+    int v;
+    int vt;
+    int vn;
+};
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char *skipSpaces(const char *p, const char *end) {
+    while (p < end && isSpace(*p)) {
+        p++;
     }
+    return p;
+}
 
-    Mesh mesh;
-    std::vector<glm::vec3> tempNormals;
-    std::vector<int> normalCount;
-    std::string line;
-
-    while (std::getline(file, line)) {
-        std::istringstream stream(line);
-        std::string type;
-        stream >> type;
-
-        if (type == "v") {
-            glm::vec3 vertex;
-            stream >> vertex.x >> vertex.y >> vertex.z;
-            if (stream.fail()) {
-                throw std::runtime_error("Error reading vertex data.");
+const char *lineEnd(const char *p, const char *end) {
+    const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    return newline ? newline : end;
+}
+
+// Identifies the line starting at p and moves p past its keyword
+ObjLine classify(const char *&p, const char *end) {
+    p = skipSpaces(p, end);
+    if (end - p >= 2 && p[0] == 'v' && isSpace(p[1])) {
+        p += 2;
+        return ObjLine::Vertex;
+    }
+    if (end - p >= 3 && p[0] == 'v' && p[1] == 't' && isSpace(p[2])) {
+        p += 3;
+        return ObjLine::Texcoord;
+    }
+    if (end - p >= 3 && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+        p += 3;
+        return ObjLine::Normal;
+    }
+    if (end - p >= 2 && p[0] == 'f' && isSpace(p[1])) {
+        p += 2;
+        return ObjLine::Face;
+    }
+    return ObjLine::Other;
+}
+
+bool parseFloat(const char *&p, const char *end, float &value) {
+    p = skipSpaces(p, end);
+#if defined(__cpp_lib_to_chars)
+    auto [next, error] = std::from_chars(p, end, value);
+    if (error != std::errc()) {
+        return false;
+    }
+    p = next;
+    return true;
+#else
+    // Floating-point from_chars is still missing from some standard libraries, so parse a bounded copy instead
+    char buffer[64];
+    size_t length = 0;
+    while (p + length < end && length < sizeof(buffer) - 1 && !isSpace(p[length]) && p[length] != '\n') {
+        buffer[length] = p[length];
+        length++;
+    }
+    buffer[length] = '\0';
+    char *parsedEnd;
+    value = std::strtof(buffer, &parsedEnd);
+    if (parsedEnd == buffer) {
+        return false;
+    }
+    p += parsedEnd - buffer;
+    return true;
+#endif
+}
+
+bool parseInt(const char *&p, const char *end, int &value) {
+    auto [next, error] = std::from_chars(p, end, value);
+    if (error != std::errc()) {
+        return false;
+    }
+    p = next;
+    return true;
+}
+
+// OBJ indices are 1-based; negative ones count back from the last element defined so far
+bool resolveIndex(int raw, size_t definedSoFar, size_t total, int &index) {
+    if (raw > 0 && size_t(raw) <= total) {
+        index = raw - 1;
+        return true;
+    }
+    if (raw < 0 && size_t(-raw) <= definedSoFar) {
+        index = int(definedSoFar) + raw;
+        return true;
+    }
+    return false;
+}
+
+// Parses one v, v/vt, v//vn or v/vt/vn corner; absent attributes stay as raw index 0
+bool parseCorner(const char *&p, const char *end, ObjCorner &corner) {
+    corner = {0, 0, 0};
+    if (!parseInt(p, end, corner.v)) {
+        return false;
+    }
+    if (p < end && *p == '/') {
+        p++;
+        if (p < end && *p != '/' && !parseInt(p, end, corner.vt)) {
+            return false;
+        }
+        if (p < end && *p == '/') {
+            p++;
+            if (!parseInt(p, end, corner.vn)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void countChunk(ObjChunk &chunk) {
+    const char *p = chunk.begin;
+    while (p < chunk.end) {
+        const char *end = lineEnd(p, chunk.end);
+        switch (classify(p, end)) {
+        case ObjLine::Vertex:   chunk.vertexCount++; break;
+        case ObjLine::Texcoord: chunk.texcoordCount++; break;
+        case ObjLine::Normal:   chunk.normalCount++; break;
+        case ObjLine::Face: {
+            // Every corner past the second adds one triangle to the fan
+            int corners = 0;
+            while (true) {
+                p = skipSpaces(p, end);
+                if (p == end || *p == '#') {
+                    break;
+                }
+                corners++;
+                while (p < end && !isSpace(*p)) {
+                    p++;
+                }
+            }
+            chunk.faceCount += std::max(corners - 2, 0);
+            break;
+        }
+        case ObjLine::Other:
+            break;
+        }
+        p = end + 1;
+    }
+}
+
+void parseChunk(ObjChunk &chunk, Mesh &mesh) {
+    size_t vertexIndex = chunk.vertexBase;
+    size_t texcoordIndex = chunk.texcoordBase;
+    size_t normalIndex = chunk.normalBase;
+    size_t faceIndex = chunk.faceBase;
+
+    const char *p = chunk.begin;
+    while (p < chunk.end) {
+        const char *end = lineEnd(p, chunk.end);
+        switch (classify(p, end)) {
+        case ObjLine::Vertex: {
+            glm::vec3 &vertex = mesh.vertices[vertexIndex++];
+            if (!parseFloat(p, end, vertex.x) || !parseFloat(p, end, vertex.y) || !parseFloat(p, end, vertex.z)) {
+                chunk.error = "Error reading vertex data.";
+                return;
+            }
+            break;
+        }
+        case ObjLine::Texcoord: {
+            glm::vec2 &texcoord = mesh.texcoords[texcoordIndex++];
+            if (!parseFloat(p, end, texcoord.x) || !parseFloat(p, end, texcoord.y)) {
+                chunk.error = "Error reading texture coordinate data.";
+                return;
             }
-            mesh.vertices.push_back(vertex);
-            tempNormals.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
-            normalCount.push_back(0);
-        }
-        else if (type == "vn") {
-            glm::vec3 normal;
-            stream >> normal.x >> normal.y >> normal.z;
-            if (stream.fail()) {
-                throw std::runtime_error("Error reading vertex normal data.");
+            break;
+        }
+        case ObjLine::Normal: {
+            glm::vec3 &normal = mesh.normals[normalIndex++];
+            if (!parseFloat(p, end, normal.x) || !parseFloat(p, end, normal.y) || !parseFloat(p, end, normal.z)) {
+                chunk.error = "Error reading vertex normal data.";
+                return;
             }
-            mesh.normals.push_back(normal);
-        }
-        else if (type == "f") {
-            Face face;
-            char skip;
-            std::fill_n(face.vn, 3, -1); // Initialize normal indices to -1
-
-            for (int i = 0; i < 3; i++) {
-                stream >> face.v[i]; // Read vertex index
-                face.v[i] -= 1; // Adjust for 0-based indexing
-
-                if (stream.peek() == '/') {
-                    stream >> skip; // Skip the '/'
-                    if (stream.peek() == '/') {
-                        stream >> skip; // Skip the second '/'
-                        // Read normal index, if available
-                        stream >> face.vn[i];
-                        face.vn[i] -= 1; // Adjust for 0-based indexing
+            break;
+        }
+        case ObjLine::Face: {
+            // Fan-triangulate on the fly: (first, previous, current) for every corner past the second
+            ObjCorner first, previous, current;
+            int corners = 0;
+            while (true) {
+                p = skipSpaces(p, end);
+                if (p == end || *p == '#') {
+                    break;
+                }
+
+                ObjCorner raw;
+                if (!parseCorner(p, end, raw)
+                    || !resolveIndex(raw.v, vertexIndex, mesh.vertices.size(), current.v)) {
+                    chunk.error = "Error reading face data.";
+                    return;
+                }
+                current.vt = -1;
+                current.vn = -1;
+                if (raw.vt != 0 && !resolveIndex(raw.vt, texcoordIndex, mesh.texcoords.size(), current.vt)) {
+                    chunk.error = "Error reading face texture coordinate index.";
+                    return;
+                }
+                if (raw.vn != 0 && !resolveIndex(raw.vn, normalIndex, mesh.normals.size(), current.vn)) {
+                    chunk.error = "Error reading face normal index.";
+                    return;
+                }
+                if (current.vn < 0) {
+                    chunk.missingNormals = true;
+                }
+
+                if (corners == 0) {
+                    first = current;
+                }
+                else if (corners >= 2) {
+                    Face &face = mesh.faces[faceIndex++];
+                    const ObjCorner *triangle[3] = {&first, &previous, &current};
+                    for (int i = 0; i < 3; i++) {
+                        face.v[i] = triangle[i]->v;
+                        face.vt[i] = triangle[i]->vt;
+                        face.vn[i] = triangle[i]->vn;
                     }
                 }
+                previous = current;
+                corners++;
             }
-            mesh.faces.push_back(face);
+            break;
+        }
+        case ObjLine::Other:
+            // Comments, groups, materials and anything else unsupported are skipped
+            break;
+        }
+        p = end + 1;
+    }
+}
+
+}
+
+// Note: error handling added for invalid mesh file
+Mesh loadMesh(const std::string& filePath, float creaseAngle) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    QFile file(QString::fromStdString(filePath));
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error("Failed to open .obj file");
+    }
+
+    Mesh mesh;
+    qint64 size = file.size();
+    if (size == 0) {
+        return mesh;
+    }
+    uchar *mapping = file.map(0, size);
+    if (!mapping) {
+        throw std::runtime_error("Failed to map .obj file");
+    }
+    const char *data = reinterpret_cast<const char *>(mapping);
+    const char *dataEnd = data + size;
+
+    // Split into roughly equal runs of whole lines, one per worker but none smaller than 1 MiB
+    const qint64 minChunkSize = 1 << 20;
+    int chunkCount = int(std::clamp<qint64>(size / minChunkSize, 1, std::max(QThread::idealThreadCount(), 1)));
+    std::vector<ObjChunk> chunks;
+    const char *chunkBegin = data;
+    for (int i = 0; i < chunkCount && chunkBegin < dataEnd; i++) {
+        const char *chunkEnd = dataEnd;
+        if (i < chunkCount - 1) {
+            chunkEnd = std::max(data + size * (i + 1) / chunkCount, chunkBegin);
+            chunkEnd = std::min(lineEnd(chunkEnd, dataEnd) + 1, dataEnd);
         }
+        chunks.push_back({chunkBegin, chunkEnd});
+        chunkBegin = chunkEnd;
+    }
+
+    QtConcurrent::blockingMap(chunks, countChunk);
+
+    size_t vertexTotal = 0, texcoordTotal = 0, normalTotal = 0, faceTotal = 0;
+    for (ObjChunk &chunk : chunks) {
+        chunk.vertexBase = vertexTotal;
+        chunk.texcoordBase = texcoordTotal;
+        chunk.normalBase = normalTotal;
+        chunk.faceBase = faceTotal;
+        vertexTotal += chunk.vertexCount;
+        texcoordTotal += chunk.texcoordCount;
+        normalTotal += chunk.normalCount;
+        faceTotal += chunk.faceCount;
+    }
+    mesh.vertices.resize(vertexTotal);
+    mesh.texcoords.resize(texcoordTotal);
+    mesh.normals.resize(normalTotal);
+    mesh.faces.resize(faceTotal);
+
+    QtConcurrent::blockingMap(chunks, [&mesh](ObjChunk &chunk) {
+        parseChunk(chunk, mesh);
+    });
 
-        // Skipping comment lines
-        else if (type == "#") {
-            continue;
+    bool missingNormals = false;
+    for (const ObjChunk &chunk : chunks) {
+        if (!chunk.error.empty()) {
+            throw std::runtime_error(chunk.error);
         }
+        missingNormals = missingNormals || chunk.missingNormals;
     }
 
+    file.unmap(mapping);
     file.close();
 
-    // If no normals were provided in the file, calculate them
-    if (mesh.normals.empty()) {
-        mesh.calculateNormals();
+    // If normals weren't provided for every face, calculate them
+    if (mesh.normals.empty() || missingNormals) {
+        mesh.calculateNormals(creaseAngle);
+    }
+
+    // Load throughput is reported alongside the frame timings, like the welding statistics
+    if (settings.frameTimings) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        double megabytes = size / (1024.0 * 1024.0);
+        std::cout << "Loaded mesh " << filePath << ": " << mesh.faces.size() << " triangles, "
+                  << megabytes << " MB in " << seconds * 1000.0 << " ms ("
+                  << (seconds > 0 ? megabytes / seconds : 0.0) << " MB/s)" << std::endl;
     }
 
     return mesh;
 }
 
-void Mesh::calculateNormals() {
-    // Clear the normals if they were already calculated
-    normals.clear();
+namespace {
 
-    // Temporary normals to store the calculated face normals
-    std::vector<glm::vec3> tempFaceNormals;
-    tempFaceNormals.reserve(faces.size());
+// Half-open index range processed by one worker
+struct WorkRange {
+    size_t begin;
+    size_t end;
+};
 
-    for (const auto& face : faces) {
-        // Calculate the face normal
-        glm::vec3 v1 = vertices[face.v[1]] - vertices[face.v[0]];
-        glm::vec3 v2 = vertices[face.v[2]] - vertices[face.v[0]];
-        glm::vec3 normal = glm::normalize(glm::cross(v1, v2));
-        tempFaceNormals.push_back(normal);
+std::vector<WorkRange> splitWork(size_t count, size_t minRangeSize) {
+    size_t rangeCount = std::clamp<size_t>(count / minRangeSize, 1, std::max(QThread::idealThreadCount(), 1));
+    std::vector<WorkRange> ranges;
+    for (size_t i = 0; i < rangeCount; i++) {
+        ranges.push_back({count * i / rangeCount, count * (i + 1) / rangeCount});
+    }
+    return ranges;
+}
+
+// Interior angle of a triangle at corner
+float cornerAngle(const glm::vec3 &corner, const glm::vec3 &next, const glm::vec3 &previous) {
+    glm::vec3 a = next - corner;
+    glm::vec3 b = previous - corner;
+    float lengths = glm::length(a) * glm::length(b);
+    if (lengths == 0.f) {
+        return 0.f;
+    }
+    return std::acos(std::clamp(glm::dot(a, b) / lengths, -1.f, 1.f));
+}
+
+}
+
+void Mesh::calculateNormals(float creaseAngle) {
+    const size_t minRangeSize = 16384;
+    float creaseCosine = std::cos(glm::radians(creaseAngle));
+
+    // Unit face normals and corner angles, in parallel over faces
+    std::vector<glm::vec3> faceNormals(faces.size());
+    std::vector<glm::vec3> faceAngles(faces.size());
+    QtConcurrent::blockingMap(splitWork(faces.size(), minRangeSize), [&](const WorkRange &range) {
+        for (size_t f = range.begin; f < range.end; f++) {
+            const Face &face = faces[f];
+            glm::vec3 p0 = vertices[face.v[0]];
+            glm::vec3 p1 = vertices[face.v[1]];
+            glm::vec3 p2 = vertices[face.v[2]];
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(normal);
+            faceNormals[f] = length > 0.f ? normal / length : glm::vec3(0);
+            faceAngles[f] = glm::vec3(cornerAngle(p0, p1, p2), cornerAngle(p1, p2, p0), cornerAngle(p2, p0, p1));
+        }
+    });
+
+    // Vertex -> incident corner adjacency in compressed rows; a corner is face * 3 + k
+    std::vector<std::uint32_t> cornerOffsets(vertices.size() + 1, 0);
+    for (const Face &face : faces) {
+        for (int k = 0; k < 3; k++) {
+            cornerOffsets[face.v[k] + 1]++;
+        }
+    }
+    for (size_t v = 0; v < vertices.size(); v++) {
+        cornerOffsets[v + 1] += cornerOffsets[v];
+    }
+    std::vector<std::uint32_t> corners(faces.size() * 3);
+    std::vector<std::uint32_t> fill(cornerOffsets.begin(), cornerOffsets.end() - 1);
+    for (size_t f = 0; f < faces.size(); f++) {
+        for (int k = 0; k < 3; k++) {
+            corners[fill[faces[f].v[k]]++] = std::uint32_t(f * 3 + k);
+        }
     }
 
-    // Update the normal indices
-    for (size_t i = 0; i < faces.size(); ++i) {
-        // Push back the same normal for all three vertices of the face
-        normals.push_back(tempFaceNormals[i]);
-        normals.push_back(tempFaceNormals[i]);
-        normals.push_back(tempFaceNormals[i]);
+    // Per vertex, every corner averages the angle-weighted normals of the incident faces within the crease
+    // angle of its own face. Corners that end up with the same normal share one entry, so a smooth vertex
+    // stores a single normal and only creases split it. Each vertex range collects its own normals.
+    std::vector<WorkRange> vertexRanges = splitWork(vertices.size(), minRangeSize);
+    std::vector<std::vector<glm::vec3>> rangeNormals(vertexRanges.size());
+    std::vector<std::uint32_t> cornerNormals(faces.size() * 3);
+    QtConcurrent::blockingMap(vertexRanges, [&](const WorkRange &range) {
+        std::vector<glm::vec3> &localNormals = rangeNormals[&range - vertexRanges.data()];
+        for (size_t v = range.begin; v < range.end; v++) {
+            size_t vertexStart = localNormals.size();
+            for (std::uint32_t c = cornerOffsets[v]; c < cornerOffsets[v + 1]; c++) {
+                // Zero-area faces have no direction of their own and take the full average
+                glm::vec3 ownNormal = faceNormals[corners[c] / 3];
+                bool degenerate = ownNormal == glm::vec3(0);
+                glm::vec3 sum(0);
+                for (std::uint32_t other = cornerOffsets[v]; other < cornerOffsets[v + 1]; other++) {
+                    glm::vec3 otherNormal = faceNormals[corners[other] / 3];
+                    if (degenerate || glm::dot(ownNormal, otherNormal) >= creaseCosine) {
+                        sum += faceAngles[corners[other] / 3][corners[other] % 3] * otherNormal;
+                    }
+                }
+                float length = glm::length(sum);
+                glm::vec3 normal = length > 0.f ? sum / length : ownNormal;
+
+                size_t match = vertexStart;
+                while (match < localNormals.size() && localNormals[match] != normal) {
+                    match++;
+                }
+                if (match == localNormals.size()) {
+                    localNormals.push_back(normal);
+                }
+                cornerNormals[corners[c]] = std::uint32_t(match);
+            }
+        }
+    });
+
+    // Concatenate the per-range normals and rebase every corner's index
+    std::vector<std::uint32_t> rangeBases(vertexRanges.size(), 0);
+    size_t normalCount = 0;
+    for (size_t r = 0; r < vertexRanges.size(); r++) {
+        rangeBases[r] = std::uint32_t(normalCount);
+        normalCount += rangeNormals[r].size();
+    }
+    normals.clear();
+    normals.reserve(normalCount);
+    for (const std::vector<glm::vec3> &localNormals : rangeNormals) {
+        normals.insert(normals.end(), localNormals.begin(), localNormals.end());
+    }
 
-        // Update the face's normal indices
-        faces[i].vn[0] = i * 3;
-        faces[i].vn[1] = i * 3 + 1;
-        faces[i].vn[2] = i * 3 + 2;
+    for (size_t f = 0; f < faces.size(); f++) {
+        for (int k = 0; k < 3; k++) {
+            size_t range = 0;
+            while (size_t(faces[f].v[k]) >= vertexRanges[range].end) {
+                range++;
+            }
+            faces[f].vn[k] = int(rangeBases[range] + cornerNormals[f * 3 + k]);
+        }
     }
 }
 
 std::vector<float> Mesh::generateVertexData() {
     std::vector<float> vertexData;
+    vertexData.reserve(faces.size() * 3 * 8);
     for (const auto& face : faces) {
         for (int i = 0; i < 3; i++) {
             insertVec3(vertexData, vertices[face.v[i]]);
             insertVec3(vertexData, normals[face.vn[i]]);
-            insertVec2(vertexData, glm::vec2(0,0));
+            insertVec2(vertexData, face.vt[i] >= 0 ? texcoords[face.vt[i]] : glm::vec2(0,0));
         }
     }
     return vertexData;
 }
 
 
+
+void Mesh::generateIndexedData(std::vector<float> &vertexData, std::vector<std::uint32_t> &indices, std::vector<std::uint32_t> &lodIndexCounts) {
+    const int floatsPerVertex = 8;
+    vertexData = generateVertexData();
+    size_t cornerCount = vertexData.size() / floatsPerVertex;
+
+    indices = weldVertices(vertexData, floatsPerVertex);
+    size_t vertexCount = vertexData.size() / floatsPerVertex;
+
+    // Level 0 is the welded mesh itself. Every coarser level aims for half the triangles of the one before;
+    // levels that barely simplify (mostly seams and borders left) are not worth switching to.
+    std::vector<std::vector<std::uint32_t>> levels;
+    levels.push_back(std::move(indices));
+    if (levels.front().size() / 3 >= minLodTriangles) {
+        std::vector<size_t> targets;
+        for (size_t level = 1; level < maxLodLevels; level++) {
+            targets.push_back((levels.front().size() / 3 >> level) * 3);
+        }
+        for (std::vector<std::uint32_t> &level : simplifyMesh(vertexData, levels.front(), targets, floatsPerVertex)) {
+            if (level.size() * 4 <= levels.back().size() * 3) {
+                levels.push_back(std::move(level));
+            }
+        }
+    }
+
+    // Statistics are only gathered alongside the frame timings, since measuring ACMR simulates the cache twice
+    bool reportStats = settings.frameTimings;
+    float missRatioBefore = reportStats ? averageCacheMissRatio(levels.front(), vertexCount) : 0.f;
+    QtConcurrent::blockingMap(levels, [vertexCount](std::vector<std::uint32_t> &level) {
+        optimizeVertexCache(level, vertexCount);
+    });
+
+    // All levels share the vertices, which are ordered by first use in the full-detail level
+    indices.clear();
+    lodIndexCounts.clear();
+    for (const std::vector<std::uint32_t> &level : levels) {
+        indices.insert(indices.end(), level.begin(), level.end());
+        lodIndexCounts.push_back(std::uint32_t(level.size()));
+    }
+    optimizeVertexFetch(vertexData, indices, floatsPerVertex);
+
+    if (!reportStats) {
+        return;
+    }
+    float missRatioAfter = averageCacheMissRatio(levels.front(), vertexCount);
+    std::cout << "Welded mesh: " << cornerCount << " corners into " << vertexData.size() / floatsPerVertex
+              << " vertices, ACMR " << missRatioBefore << " -> " << missRatioAfter << ", LOD triangles";
+    for (std::uint32_t count : lodIndexCounts) {
+        std::cout << " " << count / 3;
+    }
+    std::cout << std::endl;
+}
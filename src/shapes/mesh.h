@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <glm/glm.hpp>
@@ -8,19 +9,37 @@
 class Face {
 public:
     int v[3]; // indices for vertices
-    int vn[3]; // indices for vertex normals
+    int vt[3]; // indices for texture coordinates, -1 when absent
+    int vn[3]; // indices for vertex normals, -1 when absent
 };
 
 class Mesh {
 public:
     std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> texcoords;
     std::vector<glm::vec3> normals;
     std::vector<Face> faces;
 
     Mesh() = default;
 
     std::vector<float> generateVertexData();
-    void calculateNormals();
+
+    // Welded unique vertices (same 8-float layout) plus a triangle index buffer, with triangles
+    // reordered for the post-transform vertex cache and vertices reordered for fetch locality.
+    // Meshes of at least minLodTriangles also get up to maxLodLevels - 1 simplified levels of detail:
+    // indices holds every level back to back, finest first, and lodIndexCounts the size of each.
+    void generateIndexedData(std::vector<float> &vertexData, std::vector<std::uint32_t> &indices, std::vector<std::uint32_t> &lodIndexCounts);
+
+    static const size_t maxLodLevels = 5;
+    static const size_t minLodTriangles = 4096;
+
+    // Angle-weighted smooth normals. Corners are only split where the dihedral angle between
+    // adjacent faces exceeds creaseAngle (in degrees), so 0 gives flat shading.
+    void calculateNormals(float creaseAngle);
 };
 
-Mesh loadMesh(const std::string& filePath);
+// Parses a Wavefront OBJ file. Supports v, vt, vn and faces in any of the v, v/vt, v//vn and v/vt/vn forms,
+// with negative (relative) indices; polygons with more than three corners are fan-triangulated.
+// Missing normals are generated with calculateNormals(creaseAngle).
+// Throws std::runtime_error when the file can't be opened or is malformed.
+Mesh loadMesh(const std::string& filePath, float creaseAngle);
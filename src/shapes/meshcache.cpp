@@ -0,0 +1,243 @@
+#include "meshcache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include "mesh.h"
+
+namespace {
+
+// Bumped whenever the on-disk layout or the processing applied by loadMesh changes
+const quint32 formatVersion = 5;
+const char magic[8] = {'M', 'E', 'S', 'H', 'B', 'I', 'N', '0'};
+
+// Fixed 128-byte header; the vertex and index blocks that follow stay 4-byte aligned
+struct MeshCacheHeader {
+    char magic[8];
+    quint32 formatVersion;
+    quint32 floatsPerVertex;
+    quint64 sourceSize;
+    qint64 sourceModified; // Milliseconds since epoch
+    quint64 vertexCount;
+    quint64 indexCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    quint64 checksum;
+    float creaseAngle; // Degrees, used when the source has no normals
+    quint32 lodCount;  // Levels of detail stored back to back in the index block, finest first
+    quint64 sourceHash; // Over the start and end of the source, see sourceHashOf
+    quint32 lodIndexCounts[Mesh::maxLodLevels];
+    char reserved[12];
+};
+static_assert(sizeof(MeshCacheHeader) == 128, "Mesh cache header must stay 128 bytes");
+
+const int floatsPerVertex = 8;
+
+// FNV-1a over 64-bit words, so validating a large entry stays close to memory bandwidth
+quint64 checksumOf(const uchar *bytes, qsizetype size) {
+    quint64 hash = 14695981039346656037ull;
+    qsizetype words = size / 8;
+    for (qsizetype i = 0; i < words; i++) {
+        quint64 word;
+        std::memcpy(&word, bytes + i * 8, 8);
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+    for (qsizetype i = words * 8; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Bytes hashed at each end of the source
+const qint64 sourceSampleBytes = 64 * 1024;
+
+// Catches a source rewritten in place with its size and modification time preserved, e.g. by a
+// checkout or a copy that keeps timestamps, without reading all of a large OBJ on every load.
+// The size is mixed in so the sampled ends alone can't collide for files of different lengths.
+bool sourceHashOf(const QString &path, quint64 &hash) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    qint64 size = file.size();
+    QByteArray sample = file.read(std::min(size, sourceSampleBytes));
+    if (size > sourceSampleBytes && file.seek(std::max(sourceSampleBytes, size - sourceSampleBytes))) {
+        sample.append(file.readAll());
+    }
+    sample.append(reinterpret_cast<const char *>(&size), sizeof(size));
+    hash = checksumOf(reinterpret_cast<const uchar *>(sample.constData()), sample.size());
+    return true;
+}
+
+}
+
+MeshCache::MeshCache()
+    : MeshCache(defaultDirectory())
+{
+}
+
+MeshCache::MeshCache(const QString &directory)
+    : m_directory(directory)
+{
+}
+
+MeshCache::~MeshCache()
+{
+    release();
+}
+
+QString MeshCache::defaultDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/meshes";
+}
+
+QString MeshCache::entryPath(const std::string &objPath) const {
+    QString absolutePath = QFileInfo(QString::fromStdString(objPath)).absoluteFilePath();
+    QByteArray key = QCryptographicHash::hash(absolutePath.toUtf8(), QCryptographicHash::Sha1);
+    return m_directory + "/" + QString::fromLatin1(key.toHex()) + ".mesh";
+}
+
+void MeshCache::release() {
+    if (m_mapping) {
+        m_file.unmap(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    m_vertices = {};
+    m_indices = {};
+    m_boundsMin = glm::vec3(0);
+    m_boundsMax = glm::vec3(0);
+    m_lodIndexCounts.clear();
+}
+
+bool MeshCache::load(const std::string &objPath, float creaseAngle) {
+    release();
+
+    QFileInfo source(QString::fromStdString(objPath));
+    QString path = entryPath(objPath);
+    m_file.setFileName(path);
+    if (!source.exists() || !m_file.exists() || !m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    qint64 fileSize = m_file.size();
+    m_mapping = fileSize >= qint64(sizeof(MeshCacheHeader)) ? m_file.map(0, fileSize) : nullptr;
+    if (!m_mapping) {
+        std::cerr << "Discarding unreadable mesh cache entry: " << path.toStdString() << std::endl;
+        release();
+        QFile::remove(path);
+        return false;
+    }
+
+    MeshCacheHeader header;
+    std::memcpy(&header, m_mapping, sizeof(header));
+    const uchar *payload = m_mapping + sizeof(header);
+    qint64 payloadSize = fileSize - qint64(sizeof(header));
+
+    // A changed source or crease angle just means the entry is out of date; it gets overwritten by the next store().
+    // The source hash is only read once the cheap checks pass.
+    quint64 sourceHash = 0;
+    if (header.sourceSize != quint64(source.size())
+        || header.sourceModified != source.lastModified().toMSecsSinceEpoch()
+        || header.creaseAngle != creaseAngle
+        || !sourceHashOf(source.absoluteFilePath(), sourceHash)
+        || header.sourceHash != sourceHash) {
+        release();
+        return false;
+    }
+
+    qint64 vertexBytes = qint64(header.vertexCount * floatsPerVertex * sizeof(float));
+    qint64 indexBytes = qint64(header.indexCount * sizeof(std::uint32_t));
+    quint64 lodIndexTotal = 0;
+    for (quint32 level = 0; level < std::min<quint32>(header.lodCount, Mesh::maxLodLevels); level++) {
+        lodIndexTotal += header.lodIndexCounts[level];
+    }
+    bool valid = std::memcmp(header.magic, magic, sizeof(magic)) == 0
+                 && header.formatVersion == formatVersion
+                 && header.floatsPerVertex == quint32(floatsPerVertex)
+                 && vertexBytes + indexBytes == payloadSize
+                 && header.lodCount <= Mesh::maxLodLevels
+                 && lodIndexTotal == header.indexCount
+                 && header.checksum == checksumOf(payload, payloadSize);
+    if (!valid) {
+        std::cerr << "Discarding invalid mesh cache entry: " << path.toStdString() << std::endl;
+        release();
+        QFile::remove(path);
+        return false;
+    }
+
+    m_vertices = std::span<const float>(reinterpret_cast<const float *>(payload), header.vertexCount * floatsPerVertex);
+    m_indices = std::span<const std::uint32_t>(reinterpret_cast<const std::uint32_t *>(payload + vertexBytes), header.indexCount);
+    m_boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    m_boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    m_lodIndexCounts.assign(header.lodIndexCounts, header.lodIndexCounts + header.lodCount);
+    return true;
+}
+
+bool MeshCache::store(const std::string &objPath, float creaseAngle, std::span<const float> vertexData,
+                      std::span<const std::uint32_t> indices, std::span<const std::uint32_t> lodIndexCounts) {
+    if (lodIndexCounts.size() > Mesh::maxLodLevels) {
+        std::cerr << "Too many mesh levels of detail to cache: " << lodIndexCounts.size() << std::endl;
+        return false;
+    }
+    if (!QDir().mkpath(m_directory)) {
+        std::cerr << "Failed to create mesh cache directory: " << m_directory.toStdString() << std::endl;
+        return false;
+    }
+
+    QFileInfo source(QString::fromStdString(objPath));
+
+    MeshCacheHeader header = {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.formatVersion = formatVersion;
+    header.floatsPerVertex = floatsPerVertex;
+    header.sourceSize = quint64(source.size());
+    header.sourceModified = source.lastModified().toMSecsSinceEpoch();
+    if (!sourceHashOf(source.absoluteFilePath(), header.sourceHash)) {
+        std::cerr << "Failed to read mesh for the cache: " << objPath << std::endl;
+        return false;
+    }
+    header.vertexCount = vertexData.size() / floatsPerVertex;
+    header.indexCount = indices.size();
+    header.creaseAngle = creaseAngle;
+    header.lodCount = quint32(lodIndexCounts.size());
+    std::copy(lodIndexCounts.begin(), lodIndexCounts.end(), header.lodIndexCounts);
+
+    glm::vec3 boundsMin(0);
+    glm::vec3 boundsMax(0);
+    for (size_t i = 0; i < header.vertexCount; i++) {
+        glm::vec3 position(vertexData[i * floatsPerVertex], vertexData[i * floatsPerVertex + 1], vertexData[i * floatsPerVertex + 2]);
+        boundsMin = i == 0 ? position : glm::min(boundsMin, position);
+        boundsMax = i == 0 ? position : glm::max(boundsMax, position);
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        header.boundsMin[axis] = boundsMin[axis];
+        header.boundsMax[axis] = boundsMax[axis];
+    }
+
+    // The checksum covers both blocks as they are laid out in the file
+    QByteArray payload;
+    payload.reserve(qsizetype(vertexData.size_bytes() + indices.size_bytes()));
+    payload.append(reinterpret_cast<const char *>(vertexData.data()), qsizetype(vertexData.size_bytes()));
+    payload.append(reinterpret_cast<const char *>(indices.data()), qsizetype(indices.size_bytes()));
+    header.checksum = checksumOf(reinterpret_cast<const uchar *>(payload.constData()), payload.size());
+
+    // QSaveFile renames into place on commit, so a concurrent reader never maps a half-written entry
+    QSaveFile file(entryPath(objPath));
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::cerr << "Failed to write mesh cache entry: " << file.fileName().toStdString() << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(payload);
+    return file.commit();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <QFile>
+#include <QString>
+
+// Persistent cache of processed OBJ meshes, so reloading a scene never re-parses text.
+// Each entry is a single binary file holding a fixed-size header (source size, modification time
+// and content hash, bounds, block sizes, checksum) followed by the interleaved vertex block (position, normal,
+// uv as floats) and a 32-bit index block holding every level of detail. A hit is memory-mapped and read in place. Entries are
+// named after a hash of the source path and go stale as soon as the OBJ's size, modification
+// time, or the hash over its first and last 64 KiB changes.
+class MeshCache
+{
+public:
+    MeshCache();
+    explicit MeshCache(const QString &directory);
+    ~MeshCache();
+
+    // Maps the entry for objPath processed with creaseAngle. Returns false on a miss, a stale entry,
+    // or one that fails validation; invalid entries are removed.
+    bool load(const std::string &objPath, float creaseAngle);
+
+    // Writes processed data for objPath. indices holds the levels of detail back to back with their sizes
+    // in lodIndexCounts, as produced by Mesh::generateIndexedData; both are empty for a flat triangle list.
+    bool store(const std::string &objPath, float creaseAngle, std::span<const float> vertexData,
+               std::span<const std::uint32_t> indices, std::span<const std::uint32_t> lodIndexCounts);
+
+    // Valid after a successful load() until release() or the next load()
+    std::span<const float> vertices() const { return m_vertices; }
+    std::span<const std::uint32_t> indices() const { return m_indices; }
+    glm::vec3 boundsMin() const { return m_boundsMin; }
+    glm::vec3 boundsMax() const { return m_boundsMax; }
+    const std::vector<std::uint32_t> &lodIndexCounts() const { return m_lodIndexCounts; }
+
+    // Unmaps the current entry
+    void release();
+
+    static QString defaultDirectory();
+
+private:
+    QString entryPath(const std::string &objPath) const;
+
+    QString m_directory;
+
+    QFile m_file;
+    uchar *m_mapping = nullptr;
+    std::span<const float> m_vertices;
+    std::span<const std::uint32_t> m_indices;
+    glm::vec3 m_boundsMin = glm::vec3(0);
+    glm::vec3 m_boundsMax = glm::vec3(0);
+    std::vector<std::uint32_t> m_lodIndexCounts;
+};
@@ -0,0 +1,207 @@
+#include "meshoptimizer.h"
+
+#include <cstring>
+
+namespace {
+
+const std::uint32_t emptySlot = 0xffffffffu;
+
+// Bit pattern of a float with -0 folded into 0, so both weld together
+std::uint32_t weldBits(float value) {
+    if (value == 0.f) {
+        return 0;
+    }
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+std::uint32_t hashVertex(const float *vertex, int floatsPerVertex) {
+    // FNV-1a over the folded bit patterns
+    std::uint32_t hash = 2166136261u;
+    for (int i = 0; i < floatsPerVertex; i++) {
+        hash ^= weldBits(vertex[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool sameVertex(const float *a, const float *b, int floatsPerVertex) {
+    for (int i = 0; i < floatsPerVertex; i++) {
+        if (weldBits(a[i]) != weldBits(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+std::vector<std::uint32_t> weldVertices(std::vector<float> &vertexData, int floatsPerVertex) {
+    size_t vertexCount = vertexData.size() / floatsPerVertex;
+
+    // Open-addressing table of unique vertex ids, kept at most half full
+    size_t capacity = 1;
+    while (capacity < vertexCount * 2) {
+        capacity *= 2;
+    }
+    std::vector<std::uint32_t> table(capacity, emptySlot);
+    size_t mask = capacity - 1;
+
+    std::vector<std::uint32_t> indices(vertexCount);
+    size_t uniqueCount = 0;
+    for (size_t i = 0; i < vertexCount; i++) {
+        const float *vertex = vertexData.data() + i * floatsPerVertex;
+        size_t slot = hashVertex(vertex, floatsPerVertex) & mask;
+        while (table[slot] != emptySlot
+               && !sameVertex(vertexData.data() + size_t(table[slot]) * floatsPerVertex, vertex, floatsPerVertex)) {
+            slot = (slot + 1) & mask;
+        }
+
+        if (table[slot] == emptySlot) {
+            // Unique vertices are compacted towards the front; the write never overtakes the read
+            table[slot] = std::uint32_t(uniqueCount);
+            if (uniqueCount != i) {
+                std::memmove(vertexData.data() + uniqueCount * floatsPerVertex, vertex, floatsPerVertex * sizeof(float));
+            }
+            uniqueCount++;
+        }
+        indices[i] = table[slot];
+    }
+
+    vertexData.resize(uniqueCount * floatsPerVertex);
+    vertexData.shrink_to_fit();
+    return indices;
+}
+
+void optimizeVertexCache(std::vector<std::uint32_t> &indices, size_t vertexCount, int cacheSize) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Vertex -> triangle adjacency in compressed rows
+    std::vector<std::uint32_t> live(vertexCount, 0);
+    for (std::uint32_t index : indices) {
+        live[index]++;
+    }
+    std::vector<std::uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + live[v];
+    }
+    std::vector<std::uint32_t> adjacency(indices.size());
+    std::vector<std::uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        adjacency[fill[indices[i]]++] = std::uint32_t(i / 3);
+    }
+
+    std::vector<int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<std::uint32_t> deadEnd;
+    std::vector<std::uint32_t> candidates;
+    std::vector<std::uint32_t> output;
+    output.reserve(indices.size());
+
+    int time = cacheSize + 1;
+    size_t cursor = 1;
+    long fanning = 0;
+    while (fanning >= 0) {
+        // Emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (std::uint32_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++) {
+            std::uint32_t triangle = adjacency[a];
+            if (emitted[triangle]) {
+                continue;
+            }
+            emitted[triangle] = true;
+            for (int corner = 0; corner < 3; corner++) {
+                std::uint32_t v = indices[triangle * 3 + corner];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time;
+                    time++;
+                }
+            }
+        }
+
+        // Prefer the candidate that will still be in the cache after its remaining triangles are emitted
+        long next = -1;
+        int bestPriority = -1;
+        for (std::uint32_t v : candidates) {
+            if (live[v] == 0) {
+                continue;
+            }
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * int(live[v]) <= cacheSize) {
+                priority = time - cacheTime[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        // Dead end: back up through recently used vertices, then scan forward for any live vertex
+        while (next < 0 && !deadEnd.empty()) {
+            std::uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0) {
+                next = v;
+            }
+        }
+        while (next < 0 && cursor < vertexCount) {
+            if (live[cursor] > 0) {
+                next = long(cursor);
+            }
+            cursor++;
+        }
+        fanning = next;
+    }
+
+    indices.swap(output);
+}
+
+void optimizeVertexFetch(std::vector<float> &vertexData, std::vector<std::uint32_t> &indices, int floatsPerVertex) {
+    size_t vertexCount = vertexData.size() / floatsPerVertex;
+    std::vector<std::uint32_t> remap(vertexCount, emptySlot);
+    std::vector<float> reordered(vertexData.size());
+
+    std::uint32_t nextVertex = 0;
+    for (std::uint32_t &index : indices) {
+        if (remap[index] == emptySlot) {
+            remap[index] = nextVertex;
+            std::memcpy(reordered.data() + size_t(nextVertex) * floatsPerVertex,
+                        vertexData.data() + size_t(index) * floatsPerVertex,
+                        floatsPerVertex * sizeof(float));
+            nextVertex++;
+        }
+        index = remap[index];
+    }
+
+    // Vertices no triangle references are dropped
+    reordered.resize(size_t(nextVertex) * floatsPerVertex);
+    vertexData.swap(reordered);
+}
+
+float averageCacheMissRatio(const std::vector<std::uint32_t> &indices, size_t vertexCount, int cacheSize) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return 0.f;
+    }
+
+    // FIFO cache: a vertex is resident while fewer than cacheSize misses happened since it was loaded
+    std::vector<size_t> loadedAt(vertexCount, 0);
+    std::vector<bool> everLoaded(vertexCount, false);
+    size_t misses = 0;
+    for (std::uint32_t index : indices) {
+        if (!everLoaded[index] || misses - loadedAt[index] >= size_t(cacheSize)) {
+            everLoaded[index] = true;
+            loadedAt[index] = misses;
+            misses++;
+        }
+    }
+    return float(misses) / float(triangleCount);
+}
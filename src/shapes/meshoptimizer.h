@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Index buffer generation and reordering for interleaved float vertex streams.
+// All functions work on triangle lists.
+
+// Merges bitwise-identical vertices (treating -0 and 0 as equal) of a flat triangle list in place
+// and returns the index buffer that reproduces the original triangles
+std::vector<std::uint32_t> weldVertices(std::vector<float> &vertexData, int floatsPerVertex);
+
+// Reorders triangles for post-transform vertex cache locality (Tipsify, Sander et al. 2007)
+void optimizeVertexCache(std::vector<std::uint32_t> &indices, size_t vertexCount, int cacheSize = 16);
+
+// Reorders vertices by first use in the index buffer, so vertex fetch walks memory mostly forward
+void optimizeVertexFetch(std::vector<float> &vertexData, std::vector<std::uint32_t> &indices, int floatsPerVertex);
+
+// Average cache miss ratio: transformed vertices per triangle for a FIFO cache of cacheSize entries.
+// 3 is the worst case; well-ordered regular meshes get close to 0.5.
+float averageCacheMissRatio(const std::vector<std::uint32_t> &indices, size_t vertexCount, int cacheSize = 16);
@@ -0,0 +1,320 @@
+#include "meshsimplifier.h"
+
+#include <algorithm>
+#include <cstring>
+#include <glm/glm.hpp>
+
+namespace {
+
+const std::uint32_t noVertex = 0xffffffffu;
+
+// Symmetric 4x4 matrix summing the squared distances to a set of planes; only the upper triangle is kept
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+
+    void addPlane(const glm::dvec3 &normal, double distance, double weight) {
+        a00 += weight * normal.x * normal.x;
+        a01 += weight * normal.x * normal.y;
+        a02 += weight * normal.x * normal.z;
+        a03 += weight * normal.x * distance;
+        a11 += weight * normal.y * normal.y;
+        a12 += weight * normal.y * normal.z;
+        a13 += weight * normal.y * distance;
+        a22 += weight * normal.z * normal.z;
+        a23 += weight * normal.z * distance;
+        a33 += weight * distance * distance;
+    }
+
+    void add(const Quadric &other) {
+        a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+        a11 += other.a11; a12 += other.a12; a13 += other.a13;
+        a22 += other.a22; a23 += other.a23;
+        a33 += other.a33;
+    }
+
+    double error(const glm::dvec3 &p) const {
+        return a00 * p.x * p.x + 2 * a01 * p.x * p.y + 2 * a02 * p.x * p.z + 2 * a03 * p.x
+               + a11 * p.y * p.y + 2 * a12 * p.y * p.z + 2 * a13 * p.y
+               + a22 * p.z * p.z + 2 * a23 * p.z
+               + a33;
+    }
+};
+
+// Moves the vertices of position id `from` onto position id `to`
+struct Collapse {
+    std::uint32_t from;
+    std::uint32_t to;
+    double cost;
+};
+
+std::uint32_t positionBits(float value) {
+    if (value == 0.f) {
+        return 0;
+    }
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Maps every vertex to the first vertex with the same position, which serves as the position id
+std::vector<std::uint32_t> positionIdsOf(const std::vector<float> &vertexData, int floatsPerVertex) {
+    size_t vertexCount = vertexData.size() / floatsPerVertex;
+    size_t capacity = 1;
+    while (capacity < vertexCount * 2) {
+        capacity *= 2;
+    }
+    std::vector<std::uint32_t> table(capacity, noVertex);
+    size_t mask = capacity - 1;
+
+    auto samePosition = [&](size_t a, size_t b) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (positionBits(vertexData[a * floatsPerVertex + axis]) != positionBits(vertexData[b * floatsPerVertex + axis])) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::vector<std::uint32_t> ids(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        std::uint32_t hash = 2166136261u;
+        for (int axis = 0; axis < 3; axis++) {
+            hash ^= positionBits(vertexData[v * floatsPerVertex + axis]);
+            hash *= 16777619u;
+        }
+        size_t slot = hash & mask;
+        while (table[slot] != noVertex && !samePosition(table[slot], v)) {
+            slot = (slot + 1) & mask;
+        }
+        if (table[slot] == noVertex) {
+            table[slot] = std::uint32_t(v);
+        }
+        ids[v] = table[slot];
+    }
+    return ids;
+}
+
+}
+
+std::vector<std::vector<std::uint32_t>> simplifyMesh(const std::vector<float> &vertexData, const std::vector<std::uint32_t> &indices,
+                                                     const std::vector<size_t> &targetIndexCounts, int floatsPerVertex) {
+    size_t vertexCount = vertexData.size() / floatsPerVertex;
+    std::vector<std::uint32_t> positionId = positionIdsOf(vertexData, floatsPerVertex);
+    auto position = [&](std::uint32_t vertex) {
+        const float *p = vertexData.data() + size_t(vertex) * floatsPerVertex;
+        return glm::dvec3(p[0], p[1], p[2]);
+    };
+
+    // Vertices of each position id, in compressed rows
+    std::vector<std::uint32_t> idOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        idOffsets[positionId[v] + 1]++;
+    }
+    for (size_t id = 0; id < vertexCount; id++) {
+        idOffsets[id + 1] += idOffsets[id];
+    }
+    std::vector<std::uint32_t> idVertices(vertexCount);
+    std::vector<std::uint32_t> fill(idOffsets.begin(), idOffsets.end() - 1);
+    for (size_t v = 0; v < vertexCount; v++) {
+        idVertices[fill[positionId[v]]++] = std::uint32_t(v);
+    }
+
+    // Seams: positions shared by several vertices. Borders and non-manifold edges: edges not used by exactly two triangles.
+    std::vector<bool> locked(vertexCount, false);
+    for (size_t id = 0; id < vertexCount; id++) {
+        locked[id] = idOffsets[id + 1] - idOffsets[id] > 1;
+    }
+    std::vector<std::uint64_t> edges;
+    edges.reserve(indices.size());
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            std::uint64_t a = positionId[indices[i + k]];
+            std::uint64_t b = positionId[indices[i + (k + 1) % 3]];
+            edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t run = 0; run < edges.size();) {
+        size_t end = run;
+        while (end < edges.size() && edges[end] == edges[run]) {
+            end++;
+        }
+        if (end - run != 2) {
+            locked[edges[run] >> 32] = true;
+            locked[edges[run] & 0xffffffffu] = true;
+        }
+        run = end;
+    }
+    edges = {};
+
+    // Area-weighted plane quadrics accumulated per position
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        glm::dvec3 p0 = position(indices[i]);
+        glm::dvec3 cross = glm::cross(position(indices[i + 1]) - p0, position(indices[i + 2]) - p0);
+        double length = glm::length(cross);
+        if (length == 0.0) {
+            continue;
+        }
+        glm::dvec3 normal = cross / length;
+        Quadric plane;
+        plane.addPlane(normal, -glm::dot(normal, p0), length * 0.5);
+        for (int k = 0; k < 3; k++) {
+            quadrics[positionId[indices[i + k]]].add(plane);
+        }
+    }
+
+    // Vertex of position `to` whose attributes are closest to vertex `from`, so normals and uvs carry over
+    auto closestVertex = [&](std::uint32_t from, std::uint32_t to) {
+        std::uint32_t best = to;
+        float bestDistance = -1.f;
+        for (std::uint32_t r = idOffsets[to]; r < idOffsets[to + 1]; r++) {
+            std::uint32_t candidate = idVertices[r];
+            float distance = 0.f;
+            for (int f = 3; f < floatsPerVertex; f++) {
+                float d = vertexData[size_t(candidate) * floatsPerVertex + f] - vertexData[size_t(from) * floatsPerVertex + f];
+                distance += d * d;
+            }
+            if (bestDistance < 0.f || distance < bestDistance) {
+                best = candidate;
+                bestDistance = distance;
+            }
+        }
+        return best;
+    };
+
+    std::vector<std::uint32_t> triangles = indices;
+    std::vector<std::uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<std::uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<bool> touched(vertexCount);
+    std::vector<std::uint32_t> collapseTo(vertexCount, noVertex);
+
+    std::vector<std::vector<std::uint32_t>> levels;
+    for (size_t target : targetIndexCounts) {
+        while (triangles.size() > target) {
+            // Position -> triangle adjacency for the current triangles
+            std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+            for (std::uint32_t v : triangles) {
+                adjacencyOffsets[positionId[v] + 1]++;
+            }
+            for (size_t id = 0; id < vertexCount; id++) {
+                adjacencyOffsets[id + 1] += adjacencyOffsets[id];
+            }
+            adjacency.resize(triangles.size());
+            fill.assign(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < triangles.size(); i++) {
+                adjacency[fill[positionId[triangles[i]]]++] = std::uint32_t(i / 3);
+            }
+
+            // The cheaper direction of every edge that has an unlocked end
+            collapses.clear();
+            for (size_t i = 0; i < triangles.size(); i += 3) {
+                for (int k = 0; k < 3; k++) {
+                    std::uint32_t a = positionId[triangles[i + k]];
+                    std::uint32_t b = positionId[triangles[i + (k + 1) % 3]];
+                    if (a > b || (locked[a] && locked[b])) {
+                        continue;
+                    }
+                    Quadric merged = quadrics[a];
+                    merged.add(quadrics[b]);
+                    double costAB = locked[a] ? -1.0 : merged.error(position(b));
+                    double costBA = locked[b] ? -1.0 : merged.error(position(a));
+                    if (costBA < 0.0 || (costAB >= 0.0 && costAB <= costBA)) {
+                        collapses.push_back({a, b, costAB});
+                    }
+                    else {
+                        collapses.push_back({b, a, costBA});
+                    }
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) {
+                return x.cost < y.cost;
+            });
+
+            // Greedily take the cheapest collapses whose neighbourhoods don't overlap,
+            // so every flip test below sees final positions
+            std::fill(touched.begin(), touched.end(), false);
+            size_t excessTriangles = (triangles.size() - target + 2) / 3;
+            size_t removedTriangles = 0;
+            for (const Collapse &collapse : collapses) {
+                if (touched[collapse.from] || touched[collapse.to]) {
+                    continue;
+                }
+
+                glm::dvec3 destination = position(collapse.to);
+                bool flips = false;
+                size_t shared = 0;
+                for (std::uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !flips; a++) {
+                    const std::uint32_t *triangle = triangles.data() + size_t(adjacency[a]) * 3;
+                    glm::dvec3 before[3];
+                    glm::dvec3 after[3];
+                    bool degenerates = false;
+                    for (int k = 0; k < 3; k++) {
+                        std::uint32_t id = positionId[triangle[k]];
+                        degenerates = degenerates || id == collapse.to;
+                        before[k] = position(id);
+                        after[k] = id == collapse.from ? destination : before[k];
+                    }
+                    if (degenerates) {
+                        shared++;
+                        continue;
+                    }
+                    glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                    glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                    double lengths = glm::length(normalBefore) * glm::length(normalAfter);
+                    flips = lengths == 0.0 || glm::dot(normalBefore, normalAfter) < 0.2 * lengths;
+                }
+                if (flips) {
+                    continue;
+                }
+
+                for (std::uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++) {
+                    const std::uint32_t *triangle = triangles.data() + size_t(adjacency[a]) * 3;
+                    for (int k = 0; k < 3; k++) {
+                        touched[positionId[triangle[k]]] = true;
+                    }
+                }
+                // Unlocked positions have a single vertex, so one target vertex serves all their corners
+                collapseTo[collapse.from] = closestVertex(idVertices[idOffsets[collapse.from]], collapse.to);
+                quadrics[collapse.to].add(quadrics[collapse.from]);
+
+                removedTriangles += shared;
+                if (removedTriangles >= excessTriangles) {
+                    break;
+                }
+            }
+            if (removedTriangles == 0) {
+                break;
+            }
+
+            // Redirect collapsed corners and drop the triangles that became degenerate
+            size_t kept = 0;
+            for (size_t i = 0; i < triangles.size(); i += 3) {
+                std::uint32_t corners[3];
+                for (int k = 0; k < 3; k++) {
+                    std::uint32_t v = triangles[i + k];
+                    corners[k] = collapseTo[positionId[v]] != noVertex ? collapseTo[positionId[v]] : v;
+                }
+                std::uint32_t id0 = positionId[corners[0]];
+                std::uint32_t id1 = positionId[corners[1]];
+                std::uint32_t id2 = positionId[corners[2]];
+                if (id0 == id1 || id1 == id2 || id0 == id2) {
+                    continue;
+                }
+                triangles[kept++] = corners[0];
+                triangles[kept++] = corners[1];
+                triangles[kept++] = corners[2];
+            }
+            triangles.resize(kept);
+            for (const Collapse &collapse : collapses) {
+                collapseTo[collapse.from] = noVertex;
+            }
+        }
+        levels.push_back(triangles);
+    }
+    return levels;
+}
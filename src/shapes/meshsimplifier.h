@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Quadric error metric edge-collapse simplification (Garland and Heckbert 1997) for indexed
+// triangle lists over interleaved float vertices whose first three floats are the position.
+//
+// Vertices are only ever collapsed onto one of their neighbours, so every result indexes the same
+// vertex buffer as the input and all levels of detail can share it. Vertices on open borders and
+// on attribute seams (one position with several normals or uvs) stay put, which keeps the
+// silhouette and the texture mapping intact.
+//
+// targetIndexCounts must be decreasing. One index buffer is returned per target, each simplified
+// further from the previous one; a level keeps more indices than its target when only locked
+// vertices or collapses that would flip triangles remain.
+std::vector<std::vector<std::uint32_t>> simplifyMesh(const std::vector<float> &vertexData, const std::vector<std::uint32_t> &indices,
+                                                     const std::vector<size_t> &targetIndexCounts, int floatsPerVertex);
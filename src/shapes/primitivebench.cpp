@@ -0,0 +1,123 @@
+#include "primitivebench.h"
+#include "primitivetables.h"
+#include "shapes/cube.h"
+#include "shapes/cone.h"
+#include "shapes/cylinder.h"
+#include "shapes/sphere.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+// Read after each timed loop so the copies into storage that's about to be freed aren't optimized away
+volatile float sink;
+
+struct BenchResult {
+    double generatorMs = 0;
+    double tableMs = 0;
+    float maxDifference = 0;
+    bool sizesMatch = true;
+};
+
+// Both sides end with the geometry in caller storage, which is what GeometryCache needs from them
+template <typename Shape, typename Configure, typename Lookup>
+BenchResult bench(int repetitions, Configure configure, Lookup lookup) {
+    BenchResult result;
+    Shape shape;
+    configure(shape);
+    PrimitiveTable table;
+    if (!lookup(table) || table.vertices.size() != shape.indexedVertexCount() * 8 || table.indices.size() != shape.indexedIndexCount()) {
+        result.sizesMatch = false;
+        return result;
+    }
+    std::vector<float> vertices(table.vertices.size());
+    std::vector<std::uint16_t> indices(table.indices.size());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; i++) {
+        Shape generator;
+        configure(generator);
+        generator.generateIndexedShape(vertices, indices);
+    }
+    result.generatorMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    sink = vertices.back() + indices.back();
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        result.maxDifference = std::max(result.maxDifference, std::abs(vertices[i] - table.vertices[i]));
+    }
+    if (!std::equal(indices.begin(), indices.end(), table.indices.begin())) {
+        result.sizesMatch = false;
+    }
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; i++) {
+        PrimitiveTable baked;
+        lookup(baked);
+        std::copy(baked.vertices.begin(), baked.vertices.end(), vertices.begin());
+        std::copy(baked.indices.begin(), baked.indices.end(), indices.begin());
+    }
+    result.tableMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    sink = vertices.back() + indices.back();
+    return result;
+}
+
+}
+
+int runPrimitiveBenchmark(int repetitions) {
+    repetitions = std::max(repetitions, 1);
+    // Tables have to match to within float rounding of the series approximations
+    const float tolerance = 1e-5f;
+    double generatorTotal = 0;
+    double tableTotal = 0;
+    int mismatches = 0;
+
+    std::printf("%-9s %3s %3s %13s %13s %8s %10s\n", "shape", "p1", "p2", "generator us", "table us", "speedup", "max diff");
+    auto report = [&](const char *name, int p1, int p2, const BenchResult &result) {
+        bool match = result.sizesMatch && result.maxDifference <= tolerance;
+        if (!match) {
+            mismatches++;
+        }
+        generatorTotal += result.generatorMs;
+        tableTotal += result.tableMs;
+        std::printf("%-9s %3d %3d %13.3f %13.3f %7.1fx %10.2e%s\n", name, p1, p2,
+                    1000.0 * result.generatorMs / repetitions, 1000.0 * result.tableMs / repetitions,
+                    result.tableMs > 0 ? result.generatorMs / result.tableMs : 0.0, result.maxDifference,
+                    match ? "" : "  MISMATCH");
+    };
+
+    for (int p1 = PrimitiveTables::minParam1; p1 <= PrimitiveTables::maxParam1; p1++) {
+        report("cube", p1, 0, bench<Cube>(repetitions,
+            [&](Cube &shape) { shape.updateParams(p1, false, 1.f, 1.f, QString()); },
+            [&](PrimitiveTable &table) { return PrimitiveTables::cube(p1, table); }));
+    }
+    for (int p1 = PrimitiveTables::minParam1; p1 <= PrimitiveTables::maxParam1; p1++) {
+        for (int p2 = PrimitiveTables::minParam2; p2 <= PrimitiveTables::maxParam2; p2++) {
+            report("cone", p1, p2, bench<Cone>(repetitions,
+                [&](Cone &shape) { shape.updateParams(p1, p2, false, 1.f, 1.f, QString()); },
+                [&](PrimitiveTable &table) { return PrimitiveTables::cone(p1, p2, table); }));
+            report("cylinder", p1, p2, bench<Cylinder>(repetitions,
+                [&](Cylinder &shape) { shape.updateParams(p1, p2, false, 1.f, 1.f, QString()); },
+                [&](PrimitiveTable &table) { return PrimitiveTables::cylinder(p1, p2, table); }));
+        }
+    }
+    // Single-row spheres have no triangles and aren't baked
+    for (int p1 = std::max(PrimitiveTables::minParam1, 2); p1 <= PrimitiveTables::maxParam1; p1++) {
+        for (int p2 = PrimitiveTables::minParam2; p2 <= PrimitiveTables::maxParam2; p2++) {
+            report("sphere", p1, p2, bench<Sphere>(repetitions,
+                [&](Sphere &shape) { shape.updateParams(p1, p2, false, 1.f, 1.f, QString()); },
+                [&](PrimitiveTable &table) { return PrimitiveTables::sphere(p1, p2, table); }));
+        }
+    }
+
+    std::printf("Total over %d repetitions: generators %.3f ms, tables %.3f ms (%.1fx)\n", repetitions,
+                generatorTotal, tableTotal, tableTotal > 0 ? generatorTotal / tableTotal : 0.0);
+    if (mismatches > 0) {
+        std::printf("%d baked tables differ from their generators\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
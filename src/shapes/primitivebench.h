@@ -0,0 +1,6 @@
+#pragma once
+
+// Times the baked PrimitiveTables against the runtime generateIndexedShape() generators over every
+// baked parameter combination, checks that both give the same geometry, and prints the results.
+// Returns the process exit code: nonzero if any table differs from its generator.
+int runPrimitiveBenchmark(int repetitions);
@@ -0,0 +1,389 @@
+#include "primitivetables.h"
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+// Everything below mirrors the generateIndexedShape() implementations for isTexture == false, but is evaluated
+// by the compiler. std::sin and friends aren't constexpr, so small series versions are used instead.
+namespace {
+
+constexpr double pi = 3.14159265358979323846;
+constexpr double radius = 0.5;
+
+constexpr double constSin(double x) {
+    while (x > pi) {
+        x -= 2 * pi;
+    }
+    while (x < -pi) {
+        x += 2 * pi;
+    }
+    // Taylor series; 12 terms are well below float precision on [-pi, pi]
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 12; n++) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double constCos(double x) {
+    return constSin(x + pi / 2);
+}
+
+constexpr double constSqrt(double x) {
+    if (x <= 0) {
+        return 0;
+    }
+    // Newton iterations from above converge monotonically
+    double root = x > 1 ? x : 1;
+    for (int i = 0; i < 64; i++) {
+        root = 0.5 * (root + x / root);
+    }
+    return root;
+}
+
+struct Vec3 {
+    double x, y, z;
+};
+
+constexpr Vec3 normalize(Vec3 v) {
+    double length = constSqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    return {v.x / length, v.y / length, v.z / length};
+}
+
+// Exact sizes, matching indexedVertexCount() and indexedIndexCount() of each shape
+constexpr std::size_t cubeVertexCount(int p1) { return 6 * (p1 + 1) * (p1 + 1); }
+constexpr std::size_t cubeIndexCount(int p1) { return 6 * 6 * p1 * p1; }
+constexpr std::size_t coneVertexCount(int p1, int p2) { return p2 + p1 * (p2 + 1) + (p1 + 1) * (p2 + 1); }
+constexpr std::size_t coneIndexCount(int p1, int p2) { return 3 * p2 * (2 * p1 - 1) * 2; }
+constexpr std::size_t cylinderVertexCount(int p1, int p2) { return 3 * (p1 + 1) * (p2 + 1); }
+constexpr std::size_t cylinderIndexCount(int p1, int p2) { return 6 * p1 * p2 + 2 * 3 * p2 * (2 * p1 - 1); }
+constexpr std::size_t sphereVertexCount(int p1, int p2) { return (p1 + 1) * (p2 + 1); }
+constexpr std::size_t sphereIndexCount(int p1, int p2) { return 6 * p2 * (p1 - 1); }
+
+template <std::size_t VertexCount, std::size_t IndexCount>
+struct BakedPrimitive {
+    std::array<float, VertexCount * 8> vertices{};
+    std::array<std::uint16_t, IndexCount> indices{};
+    std::size_t vertexSize = 0;
+    std::size_t indexSize = 0;
+
+    // Untextured primitives always get a zero uv
+    constexpr void write(Vec3 position, Vec3 normal) {
+        float values[8] = {float(position.x), float(position.y), float(position.z),
+                           float(normal.x), float(normal.y), float(normal.z), 0.f, 0.f};
+        for (float value : values) {
+            vertices[vertexSize++] = value;
+        }
+    }
+
+    constexpr std::uint16_t vertexCount() const {
+        return std::uint16_t(vertexSize / 8);
+    }
+
+    constexpr void triangle(int a, int b, int c) {
+        indices[indexSize++] = std::uint16_t(a);
+        indices[indexSize++] = std::uint16_t(b);
+        indices[indexSize++] = std::uint16_t(c);
+    }
+};
+
+template <int P1>
+constexpr auto makeCube() {
+    BakedPrimitive<cubeVertexCount(P1), cubeIndexCount(P1)> baked;
+
+    struct Face {
+        Vec3 origin;
+        Vec3 uAxis;
+        Vec3 vAxis;
+        Vec3 normal;
+    };
+    const Face faces[6] = {
+        {{-0.5, -0.5,  0.5}, { 1, 0,  0}, {0, 1,  0}, { 0,  0,  1}},
+        {{ 0.5, -0.5, -0.5}, {-1, 0,  0}, {0, 1,  0}, { 0,  0, -1}},
+        {{ 0.5, -0.5,  0.5}, { 0, 0, -1}, {0, 1,  0}, { 1,  0,  0}},
+        {{-0.5, -0.5, -0.5}, { 0, 0,  1}, {0, 1,  0}, {-1,  0,  0}},
+        {{-0.5,  0.5,  0.5}, { 1, 0,  0}, {0, 0, -1}, { 0,  1,  0}},
+        {{-0.5, -0.5, -0.5}, { 1, 0,  0}, {0, 0,  1}, { 0, -1,  0}},
+    };
+
+    double step = 1.0 / P1;
+    int columns = P1 + 1;
+    for (const Face &face : faces) {
+        int faceStart = baked.vertexCount();
+        for (int i = 0; i <= P1; i++) {
+            for (int j = 0; j <= P1; j++) {
+                double u = j * step;
+                double v = i * step;
+                baked.write({face.origin.x + face.uAxis.x * u + face.vAxis.x * v,
+                             face.origin.y + face.uAxis.y * u + face.vAxis.y * v,
+                             face.origin.z + face.uAxis.z * u + face.vAxis.z * v},
+                            face.normal);
+            }
+        }
+        for (int i = 0; i < P1; i++) {
+            for (int j = 0; j < P1; j++) {
+                int bottomLeft = faceStart + i * columns + j;
+                int bottomRight = bottomLeft + 1;
+                int topLeft = bottomLeft + columns;
+                int topRight = topLeft + 1;
+                baked.triangle(bottomLeft, bottomRight, topRight);
+                baked.triangle(bottomLeft, topRight, topLeft);
+            }
+        }
+    }
+    return baked;
+}
+
+constexpr Vec3 coneSideNormal(Vec3 position) {
+    Vec3 radialComponent = normalize({position.x, 0, position.z});
+    return normalize({radialComponent.x, 0.5, radialComponent.z});
+}
+
+template <int P1, int P2>
+constexpr auto makeCone() {
+    BakedPrimitive<coneVertexCount(P1, P2), coneIndexCount(P1, P2)> baked;
+
+    double thetaStep = 2 * pi / P2;
+    double yStep = 1.0 / P1;
+    double step = radius / P1;
+    int columns = P2 + 1;
+
+    int tipStart = baked.vertexCount();
+    for (int j = 0; j < P2; j++) {
+        double middleTheta = j * thetaStep + thetaStep / 2;
+        baked.write({0, 0.5, 0}, coneSideNormal({step * constSin(middleTheta), 0, step * constCos(middleTheta)}));
+    }
+
+    int sideStart = baked.vertexCount();
+    for (int i = 1; i <= P1; i++) {
+        for (int j = 0; j <= P2; j++) {
+            double theta = j * thetaStep;
+            Vec3 position = {i * step * constSin(theta), 0.5 - i * yStep, i * step * constCos(theta)};
+            baked.write(position, coneSideNormal(position));
+        }
+    }
+
+    int capStart = baked.vertexCount();
+    for (int i = 0; i <= P1; i++) {
+        for (int j = 0; j <= P2; j++) {
+            double theta = j * thetaStep;
+            baked.write({i * step * constSin(theta), -0.5, i * step * constCos(theta)}, {0, -1, 0});
+        }
+    }
+
+    for (int i = 0; i < P1; i++) {
+        for (int j = 0; j < P2; j++) {
+            int bottomLeft = sideStart + i * columns + j;
+            int bottomRight = bottomLeft + 1;
+            if (i == 0) {
+                baked.triangle(tipStart + j, bottomLeft, bottomRight);
+            }
+            else {
+                int topLeft = bottomLeft - columns;
+                int topRight = topLeft + 1;
+                baked.triangle(topLeft, bottomLeft, topRight);
+                baked.triangle(topRight, bottomLeft, bottomRight);
+            }
+
+            int topRight = capStart + i * columns + j;
+            int topLeft = topRight + 1;
+            bottomRight = topRight + columns;
+            bottomLeft = bottomRight + 1;
+            if (i > 0) {
+                baked.triangle(topLeft, bottomLeft, topRight);
+            }
+            baked.triangle(topRight, bottomLeft, bottomRight);
+        }
+    }
+    return baked;
+}
+
+template <int P1, int P2>
+constexpr auto makeCylinder() {
+    BakedPrimitive<cylinderVertexCount(P1, P2), cylinderIndexCount(P1, P2)> baked;
+
+    double thetaStep = 2 * pi / P2;
+    double yStep = 1.0 / P1;
+    double step = radius / P1;
+    int columns = P2 + 1;
+
+    int sideStart = baked.vertexCount();
+    for (int i = 0; i <= P1; i++) {
+        for (int j = 0; j <= P2; j++) {
+            double theta = j * thetaStep;
+            Vec3 position = {radius * constSin(theta), 0.5 - i * yStep, radius * constCos(theta)};
+            baked.write(position, normalize({position.x, 0, position.z}));
+        }
+    }
+
+    int topCapStart = baked.vertexCount();
+    for (int i = 0; i <= P1; i++) {
+        for (int j = 0; j <= P2; j++) {
+            double theta = j * thetaStep;
+            baked.write({i * step * constSin(theta), 0.5, i * step * constCos(theta)}, {0, 1, 0});
+        }
+    }
+
+    int bottomCapStart = baked.vertexCount();
+    for (int i = 0; i <= P1; i++) {
+        for (int j = 0; j <= P2; j++) {
+            double theta = j * thetaStep;
+            baked.write({i * step * constSin(theta), -0.5, i * step * constCos(theta)}, {0, -1, 0});
+        }
+    }
+
+    for (int i = 0; i < P1; i++) {
+        for (int j = 0; j < P2; j++) {
+            int topLeft = sideStart + i * columns + j;
+            int topRight = topLeft + 1;
+            int bottomLeft = topLeft + columns;
+            int bottomRight = bottomLeft + 1;
+            baked.triangle(topLeft, bottomLeft, bottomRight);
+            baked.triangle(topLeft, bottomRight, topRight);
+
+            topLeft = topCapStart + i * columns + j;
+            topRight = topLeft + 1;
+            bottomLeft = topLeft + columns;
+            bottomRight = bottomLeft + 1;
+            baked.triangle(topLeft, bottomLeft, bottomRight);
+            if (i > 0) {
+                baked.triangle(topLeft, bottomRight, topRight);
+            }
+
+            topRight = bottomCapStart + i * columns + j;
+            topLeft = topRight + 1;
+            bottomRight = topRight + columns;
+            bottomLeft = bottomRight + 1;
+            baked.triangle(topLeft, bottomLeft, bottomRight);
+            if (i > 0) {
+                baked.triangle(topLeft, bottomRight, topRight);
+            }
+        }
+    }
+    return baked;
+}
+
+template <int P1, int P2>
+constexpr auto makeSphere() {
+    BakedPrimitive<sphereVertexCount(P1, P2), sphereIndexCount(P1, P2)> baked;
+
+    double thetaStep = 2 * pi / P2;
+    double phiStep = pi / P1;
+    int columns = P2 + 1;
+
+    for (int i = 0; i <= P1; i++) {
+        double phi = i * phiStep;
+        for (int j = 0; j <= P2; j++) {
+            double theta = j * thetaStep;
+            Vec3 position = {radius * constSin(phi) * constSin(theta), radius * constCos(phi), radius * constSin(phi) * constCos(theta)};
+            baked.write(position, normalize(position));
+        }
+    }
+
+    for (int i = 0; i < P1; i++) {
+        for (int j = 0; j < P2; j++) {
+            int topLeft = i * columns + j;
+            int topRight = topLeft + 1;
+            int bottomLeft = topLeft + columns;
+            int bottomRight = bottomLeft + 1;
+            if (i < P1 - 1) {
+                baked.triangle(topLeft, bottomLeft, bottomRight);
+            }
+            if (i > 0) {
+                baked.triangle(topLeft, bottomRight, topRight);
+            }
+        }
+    }
+    return baked;
+}
+
+// One static instance per parameter combination, so the tables live in the binary's read-only data
+template <int P1>
+inline constexpr auto bakedCube = makeCube<P1>();
+template <int P1, int P2>
+inline constexpr auto bakedCone = makeCone<P1, P2>();
+template <int P1, int P2>
+inline constexpr auto bakedCylinder = makeCylinder<P1, P2>();
+template <int P1, int P2>
+inline constexpr auto bakedSphere = makeSphere<P1, P2>();
+
+template <typename Baked>
+constexpr PrimitiveTable viewOf(const Baked &baked) {
+    return {std::span<const float>(baked.vertices), std::span<const std::uint16_t>(baked.indices)};
+}
+
+constexpr int param1Count = PrimitiveTables::maxParam1 - PrimitiveTables::minParam1 + 1;
+constexpr int param2Count = PrimitiveTables::maxParam2 - PrimitiveTables::minParam2 + 1;
+
+// Tables indexed by (param1 - minParam1) * param2Count + (param2 - minParam2)
+template <std::size_t... I>
+constexpr std::array<PrimitiveTable, sizeof...(I)> cubeTables(std::index_sequence<I...>) {
+    return {viewOf(bakedCube<PrimitiveTables::minParam1 + int(I)>)...};
+}
+
+template <std::size_t... I>
+constexpr std::array<PrimitiveTable, sizeof...(I)> coneTables(std::index_sequence<I...>) {
+    return {viewOf(bakedCone<PrimitiveTables::minParam1 + int(I) / param2Count, PrimitiveTables::minParam2 + int(I) % param2Count>)...};
+}
+
+template <std::size_t... I>
+constexpr std::array<PrimitiveTable, sizeof...(I)> cylinderTables(std::index_sequence<I...>) {
+    return {viewOf(bakedCylinder<PrimitiveTables::minParam1 + int(I) / param2Count, PrimitiveTables::minParam2 + int(I) % param2Count>)...};
+}
+
+template <std::size_t... I>
+constexpr std::array<PrimitiveTable, sizeof...(I)> sphereTables(std::index_sequence<I...>) {
+    return {viewOf(bakedSphere<PrimitiveTables::minParam1 + int(I) / param2Count, PrimitiveTables::minParam2 + int(I) % param2Count>)...};
+}
+
+constexpr auto cubeTable = cubeTables(std::make_index_sequence<param1Count>());
+constexpr auto coneTable = coneTables(std::make_index_sequence<param1Count * param2Count>());
+constexpr auto cylinderTable = cylinderTables(std::make_index_sequence<param1Count * param2Count>());
+constexpr auto sphereTable = sphereTables(std::make_index_sequence<param1Count * param2Count>());
+
+bool inBakedRange(int param1, int param2) {
+    return param1 >= PrimitiveTables::minParam1 && param1 <= PrimitiveTables::maxParam1
+           && param2 >= PrimitiveTables::minParam2 && param2 <= PrimitiveTables::maxParam2;
+}
+
+int tableIndex(int param1, int param2) {
+    return (param1 - PrimitiveTables::minParam1) * param2Count + (param2 - PrimitiveTables::minParam2);
+}
+
+}
+
+bool PrimitiveTables::cube(int param1, PrimitiveTable &table) {
+    if (param1 < minParam1 || param1 > maxParam1) {
+        return false;
+    }
+    table = cubeTable[param1 - minParam1];
+    return true;
+}
+
+bool PrimitiveTables::cone(int param1, int param2, PrimitiveTable &table) {
+    if (!inBakedRange(param1, param2)) {
+        return false;
+    }
+    table = coneTable[tableIndex(param1, param2)];
+    return true;
+}
+
+bool PrimitiveTables::cylinder(int param1, int param2, PrimitiveTable &table) {
+    if (!inBakedRange(param1, param2)) {
+        return false;
+    }
+    table = cylinderTable[tableIndex(param1, param2)];
+    return true;
+}
+
+bool PrimitiveTables::sphere(int param1, int param2, PrimitiveTable &table) {
+    // A single-row sphere has no non-degenerate triangles; the caller never asks for one
+    if (param1 < 2 || !inBakedRange(param1, param2)) {
+        return false;
+    }
+    table = sphereTable[tableIndex(param1, param2)];
+    return true;
+}
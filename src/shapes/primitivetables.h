@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+// Read-only view of a baked indexed primitive, in the same layout generateIndexedShape() writes
+struct PrimitiveTable {
+    std::span<const float> vertices;         // position, normal, uv
+    std::span<const std::uint16_t> indices;
+};
+
+// Untextured unit primitives for the tessellation levels reachable from the UI are generated at compile time.
+// Each lookup returns false when the parameters fall outside the baked range, in which case the runtime generator
+// has to be used instead. Textured primitives are never baked since their uvs depend on the material's repeat.
+namespace PrimitiveTables {
+    const int minParam1 = 1;
+    const int maxParam1 = 6;
+    const int minParam2 = 3;
+    const int maxParam2 = 8;
+
+    bool cube(int param1, PrimitiveTable &table);
+    bool cone(int param1, int param2, PrimitiveTable &table);
+    bool cylinder(int param1, int param2, PrimitiveTable &table);
+    bool sphere(int param1, int param2, PrimitiveTable &table);
+}
@@ -5,14 +5,12 @@
 #include <algorithm>
 
 void Sphere::updateParams(int param1, int param2, bool isTexture, float repeatU, float repeatV, QString imgPath) {
-    m_vertexData = std::vector<float>();
     m_param1 = param1;
     m_param2 = param2;
     this->isTexture = isTexture;
     this->repeatU = repeatU;
     this->repeatV = repeatV;
     this->imgPath = imgPath;
-    setVertexData();
 }
 
 void Sphere::makeTile(glm::vec3 topLeft,
@@ -69,7 +67,7 @@ void Sphere::makeWedge(float currentTheta, float nextTheta) {
         glm::vec3 bottomLeft = {m_radius * glm::sin(nextPhi) * glm::sin(currentTheta), m_radius * glm::cos(nextPhi), m_radius * glm::sin(nextPhi) * glm::cos(currentTheta)};
         glm::vec3 bottomRight = {m_radius * glm::sin(nextPhi) * glm::sin(nextTheta), m_radius * glm::cos(nextPhi), m_radius * glm::sin(nextPhi) * glm::cos(nextTheta)};
 
-        std::vector<glm::vec2> tileTextureUV = calculateTileTextureUV(topLeft, topRight, bottomLeft, bottomRight);
+        std::array<glm::vec2, 4> tileTextureUV = calculateTileTextureUV(topLeft, topRight, bottomLeft, bottomRight);
         glm::vec2 topLeftTexture = tileTextureUV.at(0);
         glm::vec2 topRightTexture = tileTextureUV.at(1);
         glm::vec2 bottomLeftTexture = tileTextureUV.at(2);
@@ -80,11 +78,11 @@ void Sphere::makeWedge(float currentTheta, float nextTheta) {
 }
 
 // Compute texture UV coordinates
-std::vector<glm::vec2> Sphere::calculateTileTextureUV(glm::vec3 topLeft,
+std::array<glm::vec2, 4> Sphere::calculateTileTextureUV(glm::vec3 topLeft,
                                                       glm::vec3 topRight,
                                                       glm::vec3 bottomLeft,
                                                       glm::vec3 bottomRight) {
-    std::vector<glm::vec2> tileTextureUV;
+    std::array<glm::vec2, 4> tileTextureUV;
 
     glm::vec2 topLeftTexture;
     if (isTexture) {
@@ -93,7 +91,7 @@ std::vector<glm::vec2> Sphere::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         topLeftTexture = {0,0};
     }
-    tileTextureUV.push_back(topLeftTexture);
+    tileTextureUV[0] = topLeftTexture;
 
     glm::vec2 topRightTexture;
     if (isTexture) {
@@ -102,7 +100,7 @@ std::vector<glm::vec2> Sphere::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         topRightTexture = {0,0};
     }
-    tileTextureUV.push_back(topRightTexture);
+    tileTextureUV[1] = topRightTexture;
 
     glm::vec2 bottomLeftTexture;
     if (isTexture) {
@@ -111,7 +109,7 @@ std::vector<glm::vec2> Sphere::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         bottomLeftTexture = {0,0};
     }
-    tileTextureUV.push_back(bottomLeftTexture);
+    tileTextureUV[2] = bottomLeftTexture;
 
     glm::vec2 bottomRightTexture;
     if (isTexture) {
@@ -120,7 +118,7 @@ std::vector<glm::vec2> Sphere::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         bottomRightTexture = {0,0};
     }
-    tileTextureUV.push_back(bottomRightTexture);
+    tileTextureUV[3] = bottomRightTexture;
 
     return tileTextureUV;
 }
@@ -163,3 +161,48 @@ void Sphere::makeSphere() {
 void Sphere::setVertexData() {
     makeSphere();
 }
+
+size_t Sphere::indexedVertexCount() const {
+    return (m_param1 + 1) * (m_param2 + 1);
+}
+
+size_t Sphere::indexedIndexCount() const {
+    // Every row but the two touching a pole has two triangles per tile
+    return 6 * m_param2 * std::max(m_param1 - 1, 0);
+}
+
+void Sphere::generateIndexedShape(std::span<float> vertices, std::span<std::uint16_t> indices) {
+    VertexWriter vertexWriter(vertices);
+    IndexWriter indexWriter(indices);
+
+    float thetaStep = glm::radians(360.f / m_param2);
+    float phiStep = glm::radians(180.f / m_param1);
+    int columns = m_param2 + 1;
+
+    // One vertex per (phi, theta) grid point. The seam column is kept separate so it keeps its own texture coordinate
+    for (int i = 0; i <= m_param1; i++) {
+        float phi = i * phiStep;
+        for (int j = 0; j <= m_param2; j++) {
+            float theta = j * thetaStep;
+            glm::vec3 position = {m_radius * glm::sin(phi) * glm::sin(theta), m_radius * glm::cos(phi), m_radius * glm::sin(phi) * glm::cos(theta)};
+            vertexWriter.write(position, glm::normalize(position), isTexture ? sphereTexture(position, repeatU, repeatV) : glm::vec2(0, 0));
+        }
+    }
+
+    // Same winding as makeTile(); the zero-area triangle touching each pole is skipped
+    for (int i = 0; i < m_param1; i++) {
+        for (int j = 0; j < m_param2; j++) {
+            std::uint16_t topLeft = i * columns + j;
+            std::uint16_t topRight = topLeft + 1;
+            std::uint16_t bottomLeft = topLeft + columns;
+            std::uint16_t bottomRight = bottomLeft + 1;
+
+            if (i < m_param1 - 1) {
+                indexWriter.triangle(topLeft, bottomLeft, bottomRight);
+            }
+            if (i > 0) {
+                indexWriter.triangle(topLeft, bottomRight, topRight);
+            }
+        }
+    }
+}
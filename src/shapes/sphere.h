@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <span>
 #include <vector>
 #include <glm/glm.hpp>
 #include <iostream>
@@ -12,7 +14,19 @@ class Sphere
 {
 public:
     void updateParams(int param1, int param2, bool isTexture, float repeatU, float repeatV, QString imgPath);
-    std::vector<float> generateShape() { return m_vertexData; }
+    std::vector<float> generateShape() {
+        m_vertexData = std::vector<float>();
+        setVertexData();
+        return m_vertexData;
+    }
+
+    // Exact sizes of the indexed form, known before generating it
+    size_t indexedVertexCount() const;
+    size_t indexedIndexCount() const;
+
+    // Indexed form of generateShape(): unique vertices with the same 8-float layout plus a 16-bit triangle list.
+    // Writes straight into caller-provided storage of exactly indexedVertexCount() * 8 floats and indexedIndexCount() indices.
+    void generateIndexedShape(std::span<float> vertices, std::span<std::uint16_t> indices);
 
 private:
     void setVertexData();
@@ -27,7 +41,7 @@ private:
     void makeWedge(float currentTheta, float nextTheta);
     void makeSphere();
 
-    std::vector<glm::vec2> calculateTileTextureUV(glm::vec3 topLeft,
+    std::array<glm::vec2, 4> calculateTileTextureUV(glm::vec3 topLeft,
                                                   glm::vec3 topRight,
                                                   glm::vec3 bottomLeft,
                                                   glm::vec3 bottomRight);
@@ -38,7 +52,6 @@ private:
     int m_param1;
     int m_param2;
 
-    std::map<QString, ImageData> imageCache;
     bool isTexture;
     float repeatU;
     float repeatV;
@@ -3,13 +3,10 @@
 
 
 void Square::updateParams(bool isTexture, float repeatU, float repeatV, QString imgPath) {
-    m_vertexData = std::vector<float>();
-
     this->isTexture = isTexture;
     this->repeatU = repeatU;
     this->repeatV = repeatV;
     this->imgPath = imgPath;
-    setVertexData();
 }
 void Square::insertData(glm::vec3 vertexData,glm::vec3 normal,glm::vec2 texture){
     insertVec3(m_vertexData,(vertexData));
@@ -31,7 +28,7 @@ void Square::makeface(bool flag) {
             glm::vec3 topRight((-0.5 + (i + 1) * step), (0.5 - j * step), flag ? 0.01 : -0.01);
 
             // 计算纹理坐标
-            std::vector<glm::vec2> tileTextureUV = calculateTileTextureUV(topLeft, topRight, bottomLeft, bottomRight);
+            std::array<glm::vec2, 4> tileTextureUV = calculateTileTextureUV(topLeft, topRight, bottomLeft, bottomRight);
             glm::vec2 topLeftTexture = tileTextureUV.at(0);
             glm::vec2 topRightTexture = tileTextureUV.at(1);
             glm::vec2 bottomLeftTexture = tileTextureUV.at(2);
@@ -57,11 +54,11 @@ void Square::setVertexData(){
 }
 
 
-std::vector<glm::vec2> Square::calculateTileTextureUV(glm::vec3 topLeft,
+std::array<glm::vec2, 4> Square::calculateTileTextureUV(glm::vec3 topLeft,
                                                       glm::vec3 topRight,
                                                       glm::vec3 bottomLeft,
                                                       glm::vec3 bottomRight) {
-    std::vector<glm::vec2> tileTextureUV;
+    std::array<glm::vec2, 4> tileTextureUV;
 
     glm::vec2 topLeftTexture;
     if (isTexture) {
@@ -70,7 +67,7 @@ std::vector<glm::vec2> Square::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         topLeftTexture = {0,0};
     }
-    tileTextureUV.push_back(topLeftTexture);
+    tileTextureUV[0] = topLeftTexture;
 
     glm::vec2 topRightTexture;
     if (isTexture) {
@@ -79,7 +76,7 @@ std::vector<glm::vec2> Square::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         topRightTexture = {0,0};
     }
-    tileTextureUV.push_back(topRightTexture);
+    tileTextureUV[1] = topRightTexture;
 
     glm::vec2 bottomLeftTexture;
     if (isTexture) {
@@ -88,7 +85,7 @@ std::vector<glm::vec2> Square::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         bottomLeftTexture = {0,0};
     }
-    tileTextureUV.push_back(bottomLeftTexture);
+    tileTextureUV[2] = bottomLeftTexture;
 
     glm::vec2 bottomRightTexture;
     if (isTexture) {
@@ -97,7 +94,7 @@ std::vector<glm::vec2> Square::calculateTileTextureUV(glm::vec3 topLeft,
     else {
         bottomRightTexture = {0,0};
     }
-    tileTextureUV.push_back(bottomRightTexture);
+    tileTextureUV[3] = bottomRightTexture;
 
     return tileTextureUV;
 }
@@ -127,3 +124,47 @@ glm::vec2 Square::cubeTexture(glm::vec3 point, float repeatU, float repeatV) {
     return glm::vec2(u_prime, v_prime);
 }
 
+
+size_t Square::indexedVertexCount() const {
+    // Two faces of 5x5 grid points
+    return 2 * 5 * 5;
+}
+
+size_t Square::indexedIndexCount() const {
+    return 2 * 4 * 4 * 6;
+}
+
+void Square::generateIndexedShape(std::span<float> vertices, std::span<std::uint16_t> indices) {
+    VertexWriter vertexWriter(vertices);
+    IndexWriter indexWriter(indices);
+
+    int m = 4;
+    float step = 1.0f / m;
+    int rows = m + 1;
+
+    for (bool flag : {true, false}) {
+        std::uint16_t faceStart = vertexWriter.vertexCount();
+        glm::vec3 normal = flag ? glm::vec3(0, 0, 1) : glm::vec3(0, 0, -1);
+
+        // Vertex (i, j) is the top left corner of tile (i, j) in makeface()
+        for (int i = 0; i <= m; ++i) {
+            for (int j = 0; j <= m; ++j) {
+                glm::vec3 position((-0.5 + i * step), (0.5 - j * step), flag ? 0.01 : -0.01);
+                vertexWriter.write(position, normal, isTexture ? cubeTexture(position, repeatU, repeatV) : glm::vec2(0, 0));
+            }
+        }
+
+        // Same winding as makeface(), which uses it for both faces
+        for (int i = 0; i < m; ++i) {
+            for (int j = 0; j < m; ++j) {
+                std::uint16_t topLeft = faceStart + i * rows + j;
+                std::uint16_t bottomLeft = topLeft + 1;
+                std::uint16_t topRight = topLeft + rows;
+                std::uint16_t bottomRight = topRight + 1;
+
+                indexWriter.triangle(topLeft, bottomLeft, bottomRight);
+                indexWriter.triangle(topRight, topLeft, bottomRight);
+            }
+        }
+    }
+}
@@ -48,13 +48,21 @@ void addPointToVectorVec2(glm::vec2 point, std::vector<float>& vector) {
     vector.push_back(point.y);
 }
 
+bool TerrainGenerator::loadHeightMap(QString path) {
+    isLoaded = heightmapImage.load(path);
+    return isLoaded;
+}
+
 // Generates the geometry of the output triangle mesh
 std::vector<float> TerrainGenerator::generateTerrain(QString path, int bump) {
-    std::vector<float> verts;
-    verts.reserve(m_resolution * m_resolution * 6);
-
     // Load heightmap image
-    isLoaded = heightmapImage.load(path);
+    loadHeightMap(path);
+    return generateTerrain(bump);
+}
+
+std::vector<float> TerrainGenerator::generateTerrain(int bump) {
+    std::vector<float> verts;
+    verts.reserve((m_resolution - 1) * (m_resolution - 1) * 6 * 8);
 
     for(int x = 0; x < m_resolution - 1; x++) {
         for(int y = 0; y < m_resolution - 1; y++) {
@@ -14,6 +14,15 @@ public:
     int getResolution() { return m_resolution; };
     std::vector<float> generateTerrain(QString path, int bumpiness);
 
+    // Generates the terrain from the currently loaded heightmap
+    std::vector<float> generateTerrain(int bumpiness);
+
+    // Loads the heightmap used by getHeight(); falls back to pure Perlin noise when loading fails
+    bool loadHeightMap(QString path);
+
+    // Bump whenever the generated geometry changes so stale TerrainCache entries are rejected
+    static const int generatorVersion = 1;
+
     // Takes a normalized (x, y) position, in range [0,1)
     // Returns a height value, z, by sampling a noise function
     float getHeight(float x, float y, int bump);
@@ -0,0 +1,166 @@
+#include "terraincache.h"
+
+#include <cstring>
+#include <iostream>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include "terrain.h"
+
+namespace {
+
+// Bumped whenever the on-disk layout below changes
+const quint32 formatVersion = 1;
+const char magic[8] = {'T', 'E', 'R', 'R', 'A', 'I', 'N', '0'};
+
+// Fixed 64-byte header; the payload that follows stays 4-byte aligned for direct float access
+struct TerrainCacheHeader {
+    char magic[8];
+    quint32 formatVersion;
+    quint32 generatorVersion;
+    qint32 resolution;
+    qint32 bumpiness;
+    quint64 floatCount;
+    quint64 checksum;
+    char key[20];
+    char reserved[4];
+};
+static_assert(sizeof(TerrainCacheHeader) == 64, "Terrain cache header must stay 64 bytes");
+
+// FNV-1a over the payload, cheap enough to run on every load
+quint64 checksumOf(const uchar *bytes, qsizetype size) {
+    quint64 hash = 14695981039346656037ull;
+    for (qsizetype i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+}
+
+TerrainCache::TerrainCache()
+    : TerrainCache(defaultDirectory())
+{
+}
+
+TerrainCache::TerrainCache(const QString &directory)
+    : m_directory(directory)
+{
+}
+
+TerrainCache::~TerrainCache()
+{
+    release();
+}
+
+QString TerrainCache::defaultDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/terrain";
+}
+
+// Hashes the heightmap file content together with every input that affects the generated mesh.
+// A missing or unreadable heightmap hashes as empty content, matching the procedural fallback in TerrainGenerator.
+QByteArray TerrainCache::contentKey(const QString &heightMapPath, int bumpiness, int resolution) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    QFile heightMap(heightMapPath);
+    if (!heightMapPath.isEmpty() && heightMap.open(QIODevice::ReadOnly)) {
+        hash.addData(&heightMap);
+    }
+
+    const qint32 params[3] = {bumpiness, resolution, TerrainGenerator::generatorVersion};
+    hash.addData(QByteArrayView(reinterpret_cast<const char *>(params), sizeof(params)));
+    return hash.result();
+}
+
+QString TerrainCache::entryPath(const QByteArray &key) const {
+    return m_directory + "/" + QString::fromLatin1(key.toHex()) + ".terrain";
+}
+
+void TerrainCache::release() {
+    if (m_mapping) {
+        m_file.unmap(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    m_mapped = nullptr;
+    m_floatCount = 0;
+}
+
+bool TerrainCache::load(const QString &heightMapPath, int bumpiness, int resolution) {
+    release();
+
+    QByteArray key = contentKey(heightMapPath, bumpiness, resolution);
+    m_file.setFileName(entryPath(key));
+    if (!m_file.exists() || !m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    qint64 fileSize = m_file.size();
+    m_mapping = fileSize >= qint64(sizeof(TerrainCacheHeader)) ? m_file.map(0, fileSize) : nullptr;
+    if (!m_mapping) {
+        std::cerr << "Discarding unreadable terrain cache entry: " << m_file.fileName().toStdString() << std::endl;
+        release();
+        QFile::remove(entryPath(key));
+        return false;
+    }
+
+    TerrainCacheHeader header;
+    std::memcpy(&header, m_mapping, sizeof(header));
+    const uchar *payload = m_mapping + sizeof(header);
+    qint64 payloadSize = fileSize - qint64(sizeof(header));
+
+    bool valid = std::memcmp(header.magic, magic, sizeof(magic)) == 0
+                 && header.formatVersion == formatVersion
+                 && header.generatorVersion == quint32(TerrainGenerator::generatorVersion)
+                 && header.resolution == resolution
+                 && header.bumpiness == bumpiness
+                 && std::memcmp(header.key, key.constData(), sizeof(header.key)) == 0
+                 && qint64(header.floatCount * sizeof(float)) == payloadSize
+                 && header.checksum == checksumOf(payload, payloadSize);
+    if (!valid) {
+        std::cerr << "Discarding invalid terrain cache entry: " << m_file.fileName().toStdString() << std::endl;
+        release();
+        QFile::remove(entryPath(key));
+        return false;
+    }
+
+    m_mapped = reinterpret_cast<const float *>(payload);
+    m_floatCount = qsizetype(header.floatCount);
+    return true;
+}
+
+bool TerrainCache::store(const QString &heightMapPath, int bumpiness, int resolution, const std::vector<float> &vertexData) {
+    if (!QDir().mkpath(m_directory)) {
+        std::cerr << "Failed to create terrain cache directory: " << m_directory.toStdString() << std::endl;
+        return false;
+    }
+
+    QByteArray key = contentKey(heightMapPath, bumpiness, resolution);
+    const uchar *payload = reinterpret_cast<const uchar *>(vertexData.data());
+    qint64 payloadSize = qint64(vertexData.size() * sizeof(float));
+
+    TerrainCacheHeader header = {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.formatVersion = formatVersion;
+    header.generatorVersion = TerrainGenerator::generatorVersion;
+    header.resolution = resolution;
+    header.bumpiness = bumpiness;
+    header.floatCount = vertexData.size();
+    header.checksum = checksumOf(payload, payloadSize);
+    std::memcpy(header.key, key.constData(), sizeof(header.key));
+
+    // QSaveFile renames into place on commit, so a concurrent reader never maps a half-written entry
+    QSaveFile file(entryPath(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::cerr << "Failed to write terrain cache entry: " << file.fileName().toStdString() << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(payload), payloadSize);
+    return file.commit();
+}
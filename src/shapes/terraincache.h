@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+// Persistent cache of built terrain payloads.
+// Each entry is a single binary file holding a fixed-size header followed by the interleaved
+// terrain vertex stream (position, normal, uv), so a hit can be memory-mapped and handed
+// straight to glBufferData without any parsing or copying.
+class TerrainCache
+{
+public:
+    TerrainCache();
+    explicit TerrainCache(const QString &directory);
+    ~TerrainCache();
+
+    // Maps the entry for (heightmap content, bumpiness, resolution, generator version).
+    // Returns false on a miss or when the entry fails validation; invalid entries are removed.
+    bool load(const QString &heightMapPath, int bumpiness, int resolution);
+
+    // Writes a freshly generated payload for the given configuration
+    bool store(const QString &heightMapPath, int bumpiness, int resolution, const std::vector<float> &vertexData);
+
+    // Valid after a successful load() until release() or the next load()
+    const float *data() const { return m_mapped; }
+    qsizetype floatCount() const { return m_floatCount; }
+
+    // Unmaps the current entry
+    void release();
+
+    static QString defaultDirectory();
+
+private:
+    QByteArray contentKey(const QString &heightMapPath, int bumpiness, int resolution);
+    QString entryPath(const QByteArray &key) const;
+
+    QString m_directory;
+
+    QFile m_file;
+    uchar *m_mapping = nullptr;
+    const float *m_mapped = nullptr;
+    qsizetype m_floatCount = 0;
+};
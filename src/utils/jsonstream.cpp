@@ -0,0 +1,452 @@
+#include "jsonstream.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Deeper documents are rejected rather than risk overflowing the stack in skipValue
+const size_t maxDepth = 512;
+
+bool isNumberChar(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Parses the four hex digits at p, or returns -1
+int parseHex4(const char *p) {
+    int value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hexDigit(p[i]);
+        if (digit < 0) {
+            return -1;
+        }
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+void appendUtf8(std::string &value, unsigned int codePoint) {
+    if (codePoint < 0x80) {
+        value += char(codePoint);
+    }
+    else if (codePoint < 0x800) {
+        value += char(0xC0 | (codePoint >> 6));
+        value += char(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000) {
+        value += char(0xE0 | (codePoint >> 12));
+        value += char(0x80 | ((codePoint >> 6) & 0x3F));
+        value += char(0x80 | (codePoint & 0x3F));
+    }
+    else {
+        value += char(0xF0 | (codePoint >> 18));
+        value += char(0x80 | ((codePoint >> 12) & 0x3F));
+        value += char(0x80 | ((codePoint >> 6) & 0x3F));
+        value += char(0x80 | (codePoint & 0x3F));
+    }
+}
+
+}
+
+JsonStream::JsonStream(QIODevice &device, size_t blockSize)
+    : m_device(device),
+      m_blockSize(blockSize)
+{
+}
+
+bool JsonStream::fill(size_t count) {
+    if (m_end - m_pos >= count) {
+        return true;
+    }
+
+    // Slide the unread tail to the front so a token that straddles two blocks ends up contiguous
+    if (m_pos > 0) {
+        std::memmove(m_buffer.data(), m_buffer.data() + m_pos, m_end - m_pos);
+        m_bufferOffset += m_pos;
+        m_end -= m_pos;
+        m_pos = 0;
+    }
+    if (m_buffer.size() < std::max(count, m_blockSize)) {
+        m_buffer.resize(std::max(count, m_blockSize));
+    }
+
+    while (m_end < count && !m_eof) {
+        qint64 read = m_device.read(m_buffer.data() + m_end, qint64(m_buffer.size() - m_end));
+        if (read <= 0) {
+            m_eof = true;
+        }
+        else {
+            m_end += size_t(read);
+        }
+    }
+    return m_end >= count;
+}
+
+char JsonStream::skipWhitespace() {
+    while (true) {
+        while (m_pos < m_end) {
+            char c = m_buffer[m_pos];
+            if (c == '\n') {
+                m_line++;
+                m_lineStart = m_bufferOffset + qint64(m_pos) + 1;
+            }
+            else if (c != ' ' && c != '\t' && c != '\r') {
+                return c;
+            }
+            m_pos++;
+        }
+        if (!fill(1)) {
+            return 0;
+        }
+    }
+}
+
+bool JsonStream::expect(char c, const char *message) {
+    if (failed()) {
+        return false;
+    }
+    if (peekChar() != c) {
+        fail(message);
+        return false;
+    }
+    m_pos++;
+    return true;
+}
+
+void JsonStream::fail(const std::string &message) {
+    if (failed()) {
+        return;
+    }
+    qint64 column = m_bufferOffset + qint64(m_pos) - m_lineStart + 1;
+    m_error = "line " + std::to_string(m_line) + " col " + std::to_string(column) + ": " + message;
+}
+
+JsonStream::Kind JsonStream::peek() {
+    if (failed()) {
+        return Kind::Invalid;
+    }
+    switch (peekChar()) {
+    case '{':
+        return Kind::Object;
+    case '[':
+        return Kind::Array;
+    case '"':
+        return Kind::String;
+    case 't':
+    case 'f':
+        return Kind::Bool;
+    case 'n':
+        return Kind::Null;
+    case '-':
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+        return Kind::Number;
+    default:
+        return Kind::Invalid;
+    }
+}
+
+bool JsonStream::beginObject() {
+    if (!expect('{', "expected an object")) {
+        return false;
+    }
+    if (m_hasMembers.size() >= maxDepth) {
+        fail("document nested too deeply");
+        return false;
+    }
+    m_hasMembers.push_back(false);
+    return true;
+}
+
+bool JsonStream::nextKey(std::string &key) {
+    if (failed()) {
+        return false;
+    }
+    char c = peekChar();
+    if (c == '}') {
+        m_pos++;
+        m_hasMembers.pop_back();
+        return false;
+    }
+    if (m_hasMembers.back()) {
+        if (c != ',') {
+            fail("expected ',' or '}'");
+            return false;
+        }
+        m_pos++;
+    }
+    m_hasMembers.back() = true;
+    if (peekChar() != '"') {
+        fail("expected a field name");
+        return false;
+    }
+    return readString(key) && expect(':', "expected ':' after field name");
+}
+
+bool JsonStream::beginArray() {
+    if (!expect('[', "expected an array")) {
+        return false;
+    }
+    if (m_hasMembers.size() >= maxDepth) {
+        fail("document nested too deeply");
+        return false;
+    }
+    m_hasMembers.push_back(false);
+    return true;
+}
+
+bool JsonStream::nextElement() {
+    if (failed()) {
+        return false;
+    }
+    char c = peekChar();
+    if (c == ']') {
+        m_pos++;
+        m_hasMembers.pop_back();
+        return false;
+    }
+    if (m_hasMembers.back()) {
+        if (c != ',') {
+            fail("expected ',' or ']'");
+            return false;
+        }
+        m_pos++;
+    }
+    m_hasMembers.back() = true;
+    return true;
+}
+
+bool JsonStream::readNumber(double &value) {
+    if (failed()) {
+        return false;
+    }
+    char c = peekChar();
+    if (c != '-' && (c < '0' || c > '9')) {
+        fail("expected a number");
+        return false;
+    }
+
+    const char *first = m_buffer.data() + m_pos;
+    size_t length = 0;
+#if defined(__cpp_lib_to_chars)
+    // Numbers are short, so with enough input in the window the common case is parsed in place
+    // with no separate scan for its end
+    if (m_end - m_pos >= 64) {
+        auto [next, error] = std::from_chars(first, first + 64, value);
+        if (error == std::errc() && next < first + 64 && !isNumberChar(*next)) {
+            m_pos = size_t(next - m_buffer.data());
+            return true;
+        }
+    }
+#endif
+
+    // Find the end of the number, pulling in more input if it runs into the end of the window
+    while (true) {
+        while (m_pos + length < m_end && isNumberChar(m_buffer[m_pos + length])) {
+            length++;
+        }
+        if (m_pos + length < m_end || !fill(length + 1)) {
+            break;
+        }
+    }
+
+    first = m_buffer.data() + m_pos;
+#if defined(__cpp_lib_to_chars)
+    auto [next, error] = std::from_chars(first, first + length, value);
+    if (error != std::errc() || next != first + length) {
+        fail("invalid number");
+        return false;
+    }
+#else
+    // Floating-point from_chars is still missing from some standard libraries, so parse a bounded copy instead
+    char buffer[64];
+    if (length >= sizeof(buffer)) {
+        fail("invalid number");
+        return false;
+    }
+    std::memcpy(buffer, first, length);
+    buffer[length] = '\0';
+    char *parsedEnd;
+    value = std::strtod(buffer, &parsedEnd);
+    if (parsedEnd != buffer + length) {
+        fail("invalid number");
+        return false;
+    }
+#endif
+    m_pos += length;
+    return true;
+}
+
+bool JsonStream::readEscape(std::string &value) {
+    if (!fill(2)) {
+        fail("unterminated string");
+        return false;
+    }
+    char c = m_buffer[m_pos + 1];
+    switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+        value += c;
+        break;
+    case 'b':
+        value += '\b';
+        break;
+    case 'f':
+        value += '\f';
+        break;
+    case 'n':
+        value += '\n';
+        break;
+    case 'r':
+        value += '\r';
+        break;
+    case 't':
+        value += '\t';
+        break;
+    case 'u': {
+        int codePoint = fill(6) ? parseHex4(m_buffer.data() + m_pos + 2) : -1;
+        if (codePoint < 0) {
+            fail("invalid \\u escape");
+            return false;
+        }
+        m_pos += 6;
+
+        // Characters outside the basic plane come as a surrogate pair of escapes
+        if (codePoint >= 0xD800 && codePoint < 0xDC00) {
+            int low = fill(6) && m_buffer[m_pos] == '\\' && m_buffer[m_pos + 1] == 'u' ? parseHex4(m_buffer.data() + m_pos + 2) : -1;
+            if (low < 0xDC00 || low >= 0xE000) {
+                fail("unpaired surrogate in \\u escape");
+                return false;
+            }
+            m_pos += 6;
+            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+        }
+        appendUtf8(value, unsigned(codePoint));
+        return true;
+    }
+    default:
+        fail("invalid escape in string");
+        return false;
+    }
+    m_pos += 2;
+    return true;
+}
+
+bool JsonStream::readString(std::string &value) {
+    value.clear();
+    if (!expect('"', "expected a string")) {
+        return false;
+    }
+    while (true) {
+        // Copy runs of plain characters in one go
+        size_t start = m_pos;
+        while (m_pos < m_end) {
+            unsigned char c = m_buffer[m_pos];
+            if (c == '"' || c == '\\' || c < 0x20) {
+                break;
+            }
+            m_pos++;
+        }
+        value.append(m_buffer.data() + start, m_pos - start);
+
+        if (m_pos == m_end) {
+            if (!fill(1)) {
+                fail("unterminated string");
+                return false;
+            }
+            continue;
+        }
+        char c = m_buffer[m_pos];
+        if (c == '"') {
+            m_pos++;
+            return true;
+        }
+        if (c != '\\') {
+            fail("control character in string");
+            return false;
+        }
+        if (!readEscape(value)) {
+            return false;
+        }
+    }
+}
+
+bool JsonStream::readLiteral(const char *literal, size_t length) {
+    if (!fill(length) || std::memcmp(m_buffer.data() + m_pos, literal, length) != 0) {
+        fail("invalid literal");
+        return false;
+    }
+    m_pos += length;
+    return true;
+}
+
+bool JsonStream::readBool(bool &value) {
+    if (failed()) {
+        return false;
+    }
+    char c = peekChar();
+    if (c == 't') {
+        value = true;
+        return readLiteral("true", 4);
+    }
+    if (c == 'f') {
+        value = false;
+        return readLiteral("false", 5);
+    }
+    fail("expected true or false");
+    return false;
+}
+
+bool JsonStream::skipValue() {
+    switch (peek()) {
+    case Kind::Object:
+        if (!beginObject()) {
+            return false;
+        }
+        while (nextKey(m_scratch)) {
+            if (!skipValue()) {
+                return false;
+            }
+        }
+        return !failed();
+    case Kind::Array:
+        if (!beginArray()) {
+            return false;
+        }
+        while (nextElement()) {
+            if (!skipValue()) {
+                return false;
+            }
+        }
+        return !failed();
+    case Kind::String:
+        return readString(m_scratch);
+    case Kind::Number: {
+        double number;
+        return readNumber(number);
+    }
+    case Kind::Bool: {
+        bool boolean;
+        return readBool(boolean);
+    }
+    case Kind::Null:
+        return readLiteral("null", 4);
+    default:
+        fail(peekChar() == 0 ? "unexpected end of input" : "expected a value");
+        return false;
+    }
+}
+
+bool JsonStream::atEnd() {
+    return peekChar() == 0 && m_pos >= m_end;
+}
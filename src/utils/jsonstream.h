@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <QIODevice>
+
+// Pull parser that tokenizes JSON straight off a device through a fixed-size window, so callers
+// can build their own structures as values arrive instead of holding the whole document in memory.
+//
+// Reads report malformed input by returning false; the first error sticks, and every later call
+// fails too, so callers can check failed() once after a loop ends. Object and array iteration
+// returns false both at the closing bracket and on error.
+class JsonStream
+{
+public:
+    enum class Kind { Object, Array, String, Number, Bool, Null, Invalid };
+
+    explicit JsonStream(QIODevice &device, size_t blockSize = 1 << 20);
+
+    // Kind of the next value, without consuming it; Invalid at the end of input
+    Kind peek();
+
+    // Enters an object; nextKey then yields each field name, after which its value must be read or skipped
+    bool beginObject();
+    bool nextKey(std::string &key);
+
+    // Enters an array; nextElement returns true before each element, which must be read or skipped
+    bool beginArray();
+    bool nextElement();
+
+    bool readNumber(double &value);
+    bool readString(std::string &value);
+    bool readBool(bool &value);
+    bool skipValue();
+
+    // True when only whitespace remains
+    bool atEnd();
+
+    // Records an error at the current position, unless an earlier one was already recorded
+    void fail(const std::string &message);
+
+    bool failed() const { return !m_error.empty(); }
+    const std::string &error() const { return m_error; }
+
+private:
+    // Makes at least count bytes available from m_pos, short only at the end of input
+    bool fill(size_t count);
+    // Skips whitespace and returns the next byte without consuming it, or 0 at the end of input
+    char peekChar() {
+        if (m_pos < m_end && static_cast<unsigned char>(m_buffer[m_pos]) > ' ') {
+            return m_buffer[m_pos];
+        }
+        return skipWhitespace();
+    }
+    char skipWhitespace();
+    bool expect(char c, const char *message);
+    bool readLiteral(const char *literal, size_t length);
+    bool readEscape(std::string &value);
+
+    QIODevice &m_device;
+    std::vector<char> m_buffer;
+    size_t m_blockSize;
+    size_t m_pos = 0;
+    size_t m_end = 0;
+    bool m_eof = false;
+
+    // For error positions
+    qint64 m_bufferOffset = 0; // Of m_buffer[0] in the input
+    qint64 m_line = 1;
+    qint64 m_lineStart = 0;
+
+    std::vector<bool> m_hasMembers; // Per open container, whether a separator is due before the next member
+    std::string m_scratch;
+    std::string m_error;
+};
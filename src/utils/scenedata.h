@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory_resource>
 #include <vector>
 #include <string>
 
@@ -39,6 +40,8 @@ struct SceneGlobalData {
     float kd; // Diffuse term
     float ks; // Specular term
     float kt; // Transparency; used for extra credit (refraction)
+
+    bool operator==(const SceneGlobalData &other) const = default;
 };
 
 // Struct which contains raw parsed data fro a single light
@@ -71,6 +74,8 @@ struct SceneLightData {
     float angle;    // Only applicable to spot lights, in RADIANS
 
     float width, height; // No longer supported (area lights)
+
+    bool operator==(const SceneLightData &other) const = default;
 };
 
 // Struct which contains data for the camera of a scene
@@ -83,6 +88,8 @@ struct SceneCameraData {
 
     float aperture;    // Only applicable for depth of field
     float focalLength; // Only applicable for depth of field
+
+    bool operator==(const SceneCameraData &other) const = default;
 };
 
 // Struct which contains data for texture mapping files
@@ -102,6 +109,8 @@ struct SceneFileMap {
         repeatV = 0.0f;
         filename = std::string();
     }
+
+    bool operator==(const SceneFileMap &other) const = default;
 };
 
 // Struct which contains data for a material (e.g. one which might be assigned to an object)
@@ -140,6 +149,8 @@ struct SceneMaterial {
         cEmissive = glm::vec4(0);
         bumpMap.clear();
     }
+
+    bool operator==(const SceneMaterial &other) const = default;
 };
 
 // Struct which contains data for a single primitive in a scene
@@ -147,6 +158,8 @@ struct ScenePrimitive {
     PrimitiveType type;
     SceneMaterial material;
     std::string meshfile; // Used for triangle meshes
+
+    bool operator==(const ScenePrimitive &other) const = default;
 };
 
 // Struct which contains data for a transformation.
@@ -161,9 +174,13 @@ struct SceneTransformation {
 };
 
 // Struct which represents a node in the scene graph/tree, to be parsed by the student's `SceneParser`.
+// The ScenefileReader places nodes, the objects they point to and these lists in its arena.
 struct SceneNode {
-    std::vector<SceneTransformation*> transformations; // Note the order of transformations described in lab 5
-    std::vector<ScenePrimitive*> primitives;
-    std::vector<SceneLight*> lights;
-    std::vector<SceneNode*> children;
+    explicit SceneNode(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : transformations(resource), primitives(resource), lights(resource), children(resource) {}
+
+    std::pmr::vector<SceneTransformation*> transformations; // Note the order of transformations described in lab 5
+    std::pmr::vector<ScenePrimitive*> primitives;
+    std::pmr::vector<SceneLight*> lights;
+    std::pmr::vector<SceneNode*> children;
 };
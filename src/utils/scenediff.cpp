@@ -0,0 +1,92 @@
+#include "scenediff.h"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+namespace {
+
+void combine(size_t &seed, size_t value) {
+    seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+// Hashes the fields that usually tell shapes apart; operator== settles the rest
+size_t hashShape(const RenderShapeData &shape) {
+    size_t seed = 0;
+    combine(seed, std::hash<int>()(static_cast<int>(shape.primitive.type)));
+    combine(seed, std::hash<std::string>()(shape.primitive.meshfile));
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            combine(seed, std::hash<float>()(shape.ctm[column][row]));
+        }
+    }
+    combine(seed, hashMaterial(shape.primitive.material));
+    return seed;
+}
+
+}
+
+size_t hashMaterial(const SceneMaterial &material) {
+    size_t seed = 0;
+    for (int channel = 0; channel < 4; channel++) {
+        combine(seed, std::hash<float>()(material.cAmbient[channel]));
+        combine(seed, std::hash<float>()(material.cDiffuse[channel]));
+        combine(seed, std::hash<float>()(material.cSpecular[channel]));
+    }
+    combine(seed, std::hash<float>()(material.shininess));
+    combine(seed, std::hash<std::string>()(material.textureMap.filename));
+    return seed;
+}
+
+SceneDiff diffScenes(const RenderData &before, const RenderData &after) {
+    SceneDiff diff;
+    diff.globalDataChanged = !(before.globalData == after.globalData);
+    diff.cameraChanged = !(before.cameraData == after.cameraData);
+    diff.lightsChanged = before.lights != after.lights;
+
+    // Identical shapes at any position match each other; buckets hold old indices in file order
+    std::unordered_map<size_t, std::vector<size_t>> oldShapes;
+    oldShapes.reserve(before.shapes.size());
+    for (size_t i = 0; i < before.shapes.size(); i++) {
+        oldShapes[hashShape(before.shapes[i])].push_back(i);
+    }
+
+    std::vector<bool> oldMatched(before.shapes.size(), false);
+    diff.previousShapes.assign(after.shapes.size(), SceneDiff::noShape);
+    std::vector<size_t> unmatchedNew;
+    for (size_t i = 0; i < after.shapes.size(); i++) {
+        auto bucket = oldShapes.find(hashShape(after.shapes[i]));
+        bool matched = false;
+        if (bucket != oldShapes.end()) {
+            std::vector<size_t> &candidates = bucket->second;
+            auto same = std::find_if(candidates.begin(), candidates.end(), [&](size_t old) {
+                return before.shapes[old] == after.shapes[i];
+            });
+            if (same != candidates.end()) {
+                oldMatched[*same] = true;
+                diff.previousShapes[i] = *same;
+                candidates.erase(same);
+                matched = true;
+            }
+        }
+        if (!matched) {
+            unmatchedNew.push_back(i);
+        }
+    }
+
+    std::vector<size_t> unmatchedOld;
+    for (size_t i = 0; i < before.shapes.size(); i++) {
+        if (!oldMatched[i]) {
+            unmatchedOld.push_back(i);
+        }
+    }
+
+    size_t paired = std::min(unmatchedNew.size(), unmatchedOld.size());
+    for (size_t i = 0; i < paired; i++) {
+        diff.previousShapes[unmatchedNew[i]] = unmatchedOld[i];
+    }
+    diff.modifiedShapes.assign(unmatchedNew.begin(), unmatchedNew.begin() + paired);
+    diff.addedShapes.assign(unmatchedNew.begin() + paired, unmatchedNew.end());
+    diff.removedShapes.assign(unmatchedOld.begin() + paired, unmatchedOld.end());
+    return diff;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "sceneparser.h"
+
+// What changed between two parses of a scene file. Shapes are matched by content rather than by
+// position, so inserting a node early in the file doesn't make every later shape look modified.
+struct SceneDiff {
+    bool globalDataChanged = false;
+    bool cameraChanged = false;
+    bool lightsChanged = false;
+
+    std::vector<size_t> addedShapes;    // Indices into the new shapes
+    std::vector<size_t> removedShapes;  // Indices into the old shapes
+    std::vector<size_t> modifiedShapes; // Indices into the new shapes that took the place of an old one
+    std::vector<size_t> previousShapes; // Per new shape, the old shape it matched or replaced; noShape if added
+
+    static const size_t noShape = size_t(-1);
+
+    bool shapesChanged() const { return !addedShapes.empty() || !removedShapes.empty() || !modifiedShapes.empty(); }
+    bool empty() const { return !globalDataChanged && !cameraChanged && !lightsChanged && !shapesChanged(); }
+};
+
+// Hashes the material fields the renderer uses; equal materials hash equal, operator== settles collisions
+size_t hashMaterial(const SceneMaterial &material);
+
+// Unmatched old and new shapes are paired up in file order as modifications; the rest are additions or removals
+SceneDiff diffScenes(const RenderData &before, const RenderData &after);
@@ -3,13 +3,16 @@
 
 #include "glm/gtc/type_ptr.hpp"
 
+#include <array>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <iterator>
 #include <filesystem>
+#include <string_view>
 
 #include <QFile>
-#include <QJsonArray>
 
 #define ERROR_AT(e) "error at line " << e.lineNumber() << " col " << e.columnNumber() << ": "
 #define PARSE_ERROR(e) std::cout << ERROR_AT(e) << "could not parse <" << e.tagName().toStdString() \
@@ -18,38 +21,196 @@
                                          << e.tagName().toStdString() << ">" << std::endl;
 
 // Students, please ignore this file.
-ScenefileReader::ScenefileReader(const std::string &name) {
+
+namespace {
+
+// Size of the first arena block; the resource grows later ones geometrically
+const size_t initialArenaSize = 64 * 1024;
+
+// The fields an object accepts, looked up as each key streams in. The first requiredCount are required.
+template <size_t N>
+struct FieldTable {
+    std::array<std::string_view, N> names;
+    size_t requiredCount;
+    const char *objectName;
+};
+
+// Which fields of a FieldTable one object has supplied so far
+template <size_t N>
+class FieldSet {
+public:
+    explicit FieldSet(const FieldTable<N> &table) : m_table(table) {}
+
+    // Index of key in the table, or -1 after printing why the object can't have it
+    int accept(std::string_view key) {
+        for (size_t i = 0; i < N; i++) {
+            if (m_table.names[i] == key) {
+                if (has(i)) {
+                    std::cout << "duplicate field \"" << key << "\" on " << m_table.objectName << " object" << std::endl;
+                    return -1;
+                }
+                m_seen |= 1u << i;
+                return int(i);
+            }
+        }
+        std::cout << "unknown field \"" << key << "\" on " << m_table.objectName << " object" << std::endl;
+        return -1;
+    }
+
+    bool has(size_t field) const { return m_seen & (1u << field); }
+
+    // Prints the first missing required field, if any
+    bool complete() const {
+        for (size_t i = 0; i < m_table.requiredCount; i++) {
+            if (!has(i)) {
+                std::cout << "missing required field \"" << m_table.names[i] << "\" on " << m_table.objectName << " object" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static_assert(N <= 32);
+    const FieldTable<N> &m_table;
+    std::uint32_t m_seen = 0;
+};
+
+enum RootField { RootGlobalData, RootCameraData, RootName, RootGroups, RootTemplateGroups };
+constexpr FieldTable<5> rootFields = {{"globalData", "cameraData", "name", "groups", "templateGroups"}, 2, "root"};
+
+enum GlobalDataField { GlobalAmbientCoeff, GlobalDiffuseCoeff, GlobalSpecularCoeff, GlobalTransparentCoeff };
+constexpr FieldTable<4> globalDataFields = {{"ambientCoeff", "diffuseCoeff", "specularCoeff", "transparentCoeff"}, 3, "globalData"};
+
+enum CameraField { CameraPosition, CameraUp, CameraHeightAngle, CameraAperture, CameraFocalLength, CameraLook, CameraFocus };
+constexpr FieldTable<7> cameraFields = {{"position", "up", "heightAngle", "aperture", "focalLength", "look", "focus"}, 3, "cameraData"};
+
+enum LightField { LightTypeField, LightColor, LightName, LightAttenuationCoeff, LightDirection, LightPenumbra, LightAngle };
+constexpr FieldTable<7> lightFields = {{"type", "color", "name", "attenuationCoeff", "direction", "penumbra", "angle"}, 2, "light"};
+
+// Templates are groups whose name is required, which parseTemplateGroupData checks itself
+enum GroupField { GroupName, GroupTranslate, GroupRotate, GroupScale, GroupMatrix, GroupLights, GroupPrimitives, GroupGroups };
+constexpr FieldTable<8> groupFields = {{"name", "translate", "rotate", "scale", "matrix", "lights", "primitives", "groups"}, 0, "group"};
+constexpr FieldTable<8> templateGroupFields = {groupFields.names, 0, "templateGroup"};
+
+enum PrimitiveField {
+    PrimitiveTypeField, PrimitiveMeshFile, PrimitiveAmbient, PrimitiveDiffuse, PrimitiveSpecular, PrimitiveReflective,
+    PrimitiveTransparent, PrimitiveShininess, PrimitiveIor, PrimitiveBlend, PrimitiveTextureFile, PrimitiveTextureU,
+    PrimitiveTextureV, PrimitiveBumpMapFile, PrimitiveBumpMapU, PrimitiveBumpMapV
+};
+constexpr FieldTable<16> primitiveFields = {
+    {"type", "meshFile", "ambient", "diffuse", "specular", "reflective", "transparent", "shininess", "ior",
+     "blend", "textureFile", "textureU", "textureV", "bumpMapFile", "bumpMapU", "bumpMapV"}, 1, "primitive"};
+
+// Prints that object.field isn't of the expected type, unless the JSON itself is malformed there,
+// in which case the stream records the error instead. Always returns false.
+bool wrongType(JsonStream &json, const char *object, const char *field, const char *expected) {
+    if (json.peek() == JsonStream::Kind::Invalid) {
+        json.fail("expected a value");
+    }
+    else {
+        std::cout << object << " " << field << " must be " << expected << std::endl;
+    }
+    return false;
+}
+
+bool readNumber(JsonStream &json, const char *object, const char *field, double &value) {
+    if (json.peek() != JsonStream::Kind::Number) {
+        return wrongType(json, object, field, "a floating-point value");
+    }
+    return json.readNumber(value);
+}
+
+bool readString(JsonStream &json, const char *object, const char *field, std::string &value) {
+    if (json.peek() != JsonStream::Kind::String) {
+        return wrongType(json, object, field, "of type string");
+    }
+    return json.readString(value);
+}
+
+// Reads an array of exactly size numbers
+bool readVector(JsonStream &json, const char *object, const char *field, double *values, int size) {
+    if (json.peek() != JsonStream::Kind::Array) {
+        return wrongType(json, object, field, "of type array");
+    }
+    json.beginArray();
+    int count = 0;
+    while (json.nextElement()) {
+        if (json.peek() != JsonStream::Kind::Number) {
+            return wrongType(json, object, field, "an array of floating-point values");
+        }
+        double value;
+        if (!json.readNumber(value)) {
+            return false;
+        }
+        if (count < size) {
+            values[count] = value;
+        }
+        count++;
+    }
+    if (json.failed()) {
+        return false;
+    }
+    if (count != size) {
+        std::cout << object << " " << field << " must have " << size << " elements" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Reads a 4x4 array of rows into a column-major matrix
+bool readMatrix(JsonStream &json, float *matrix) {
+    if (json.peek() != JsonStream::Kind::Array) {
+        return wrongType(json, "group", "matrix", "of type array of array");
+    }
+    json.beginArray();
+    int row = 0;
+    while (json.nextElement()) {
+        double values[4];
+        if (row == 4 || !readVector(json, "group", "matrix row", values, 4)) {
+            if (row == 4) {
+                std::cout << "group matrix must be 4x4" << std::endl;
+            }
+            return false;
+        }
+        for (int col = 0; col < 4; col++) {
+            matrix[col * 4 + row] = float(values[col]);
+        }
+        row++;
+    }
+    if (json.failed()) {
+        return false;
+    }
+    if (row != 4) {
+        std::cout << "group matrix must be 4x4" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+ScenefileReader::ScenefileReader(const std::string &name)
+    : m_arena(initialArenaSize),
+      m_primitives(&m_arena)
+{
     file_name = name;
 
     memset(&m_cameraData, 0, sizeof(SceneCameraData));
     memset(&m_globalData, 0, sizeof(SceneGlobalData));
 
-    m_root = new SceneNode;
+    m_root = create<SceneNode>(&m_arena);
 
     m_templates.clear();
-    m_nodes.clear();
-
-    m_nodes.push_back(m_root);
 }
 
 ScenefileReader::~ScenefileReader() {
-    // Delete all Scene Nodes
-    for (unsigned int node = 0; node < m_nodes.size(); node++) {
-        for (size_t i = 0; i < (m_nodes[node])->transformations.size(); i++)
-        {
-            delete (m_nodes[node])->transformations[i];
-        }
-        for (size_t i = 0; i < (m_nodes[node])->primitives.size(); i++)
-        {
-            delete (m_nodes[node])->primitives[i];
-        }
-        (m_nodes[node])->transformations.clear();
-        (m_nodes[node])->primitives.clear();
-        (m_nodes[node])->children.clear();
-        delete m_nodes[node];
+    // Nodes, transformations and lights hold nothing outside the arena, so only the primitives need
+    // their destructors run; the arena's own destructor then returns every block in one go
+    for (ScenePrimitive *primitive : m_primitives) {
+        primitive->~ScenePrimitive();
     }
-
-    m_nodes.clear();
+    m_primitives.clear();
     m_templates.clear();
 }
 
@@ -67,301 +228,215 @@ SceneNode *ScenefileReader::getRootNode() const {
 
 // This is where it all goes down...
 bool ScenefileReader::readJSON() {
-    // Read the file
+    // Open the file; it is read in blocks as the parse goes, never all at once
     QFile file(file_name.c_str());
     if (!file.open(QFile::ReadOnly)) {
         std::cout << "could not open " << file_name << std::endl;
         return false;
     }
 
-    // Load the JSON document
-    QByteArray fileContents = file.readAll();
-    QJsonParseError jsonError;
-    QJsonDocument doc = QJsonDocument::fromJson(fileContents, &jsonError);
-    if (doc.isNull()) {
-        std::cout << "could not parse " << file_name << std::endl;
-        std::cout << "parse error at line " << jsonError.offset << ": "
-                  << jsonError.errorString().toStdString() << std::endl;
-        return false;
-    }
-    file.close();
+    // Paths in the file are relative to the directory above the one holding it
+    m_basePath = std::filesystem::path(file_name).parent_path().parent_path();
 
-    if (!doc.isObject()) {
-        std::cout << "document is not an object" << std::endl;
+    JsonStream json(file);
+    if (!parseSceneFile(json)) {
+        if (json.failed()) {
+            std::cout << "could not parse " << file_name << std::endl;
+            std::cout << "parse error at " << json.error() << std::endl;
+        }
         return false;
     }
+    file.close();
 
-    // Get the root element
-    QJsonObject scenefile = doc.object();
+    std::cout << "Finished reading " << file_name << std::endl;
+    return true;
+}
 
-    if (!scenefile.contains("globalData")) {
-        std::cout << "missing required field \"globalData\" on root object" << std::endl;
-        return false;
-    }
-    if (!scenefile.contains("cameraData")) {
-        std::cout << "missing required field \"cameraData\" on root object" << std::endl;
+/**
+ * Parse the root object, in whatever order its fields come.
+ */
+bool ScenefileReader::parseSceneFile(JsonStream &json) {
+    if (json.peek() != JsonStream::Kind::Object) {
+        if (json.peek() == JsonStream::Kind::Invalid) {
+            json.fail("expected a value");
+        }
+        else {
+            std::cout << "document is not an object" << std::endl;
+        }
         return false;
     }
 
-    QStringList requiredFields = {"globalData", "cameraData"};
-    QStringList optionalFields = {"name", "groups", "templateGroups"};
-    // If other fields are present, raise an error
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto &field : scenefile.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on root object" << std::endl;
+    m_templateReferences.clear();
+    m_templatesRead = false;
+
+    json.beginObject();
+    FieldSet fields(rootFields);
+    std::string key;
+    while (json.nextKey(key)) {
+        switch (fields.accept(key)) {
+        case RootGlobalData:
+            if (!parseGlobalData(json)) {
+                std::cout << "could not parse \"globalData\"" << std::endl;
+                return false;
+            }
+            break;
+        case RootCameraData:
+            if (!parseCameraData(json)) {
+                std::cout << "could not parse \"cameraData\"" << std::endl;
+                return false;
+            }
+            break;
+        case RootName:
+            if (!json.skipValue()) {
+                return false;
+            }
+            break;
+        case RootGroups:
+            if (!parseGroups(json, m_root, false)) {
+                return false;
+            }
+            break;
+        case RootTemplateGroups:
+            if (!parseTemplateGroups(json)) {
+                return false;
+            }
+            m_templatesRead = true;
+            break;
+        default:
             return false;
         }
     }
-
-    // Parse the global data
-    if (!parseGlobalData(scenefile["globalData"].toObject())) {
-        std::cout << "could not parse \"globalData\"" << std::endl;
-        return false;
+    if (!json.failed() && !json.atEnd()) {
+        json.fail("unexpected data after the root object");
     }
-
-    // Parse the camera data
-    if (!parseCameraData(scenefile["cameraData"].toObject())) {
-        std::cout << "could not parse \"cameraData\"" << std::endl;
+    if (json.failed() || !fields.complete()) {
         return false;
     }
 
-    // Parse the template groups
-    if (scenefile.contains("templateGroups")) {
-        if (!parseTemplateGroups(scenefile["templateGroups"])) {
-            return false;
-        }
-    }
-
-    // Parse the groups
-    if (scenefile.contains("groups")) {
-        if (!parseGroups(scenefile["groups"], m_root)) {
-            return false;
+    // A named group in the main tree that shares a template's name stands for that template
+    for (const TemplateReference &reference : m_templateReferences) {
+        auto found = m_templates.find(reference.name);
+        if (found != m_templates.end()) {
+            reference.parent->children[reference.child] = found->second;
         }
     }
+    m_templateReferences.clear();
 
-    std::cout << "Finished reading " << file_name << std::endl;
     return true;
 }
 
 /**
  * Parse a globalData field and fill in m_globalData.
  */
-bool ScenefileReader::parseGlobalData(const QJsonObject &globalData) {
-    QStringList requiredFields = {"ambientCoeff", "diffuseCoeff", "specularCoeff"};
-    QStringList optionalFields = {"transparentCoeff"};
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto field : globalData.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on globalData object" << std::endl;
-            return false;
-        }
-    }
-    for (auto field : requiredFields) {
-        if (!globalData.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on globalData object" << std::endl;
-            return false;
-        }
+bool ScenefileReader::parseGlobalData(JsonStream &json) {
+    if (json.peek() != JsonStream::Kind::Object) {
+        return wrongType(json, "root", "globalData", "of type object");
     }
 
-    // Parse the global data
-    if (globalData["ambientCoeff"].isDouble()) {
-        m_globalData.ka = globalData["ambientCoeff"].toDouble();
-    }
-    else {
-        std::cout << "globalData ambientCoeff must be a floating-point value" << std::endl;
-        return false;
-    }
-    if (globalData["diffuseCoeff"].isDouble()) {
-        m_globalData.kd = globalData["diffuseCoeff"].toDouble();
-    }
-    else {
-        std::cout << "globalData diffuseCoeff must be a floating-point value" << std::endl;
-        return false;
-    }
-    if (globalData["specularCoeff"].isDouble()) {
-        m_globalData.ks = globalData["specularCoeff"].toDouble();
-    }
-    else {
-        std::cout << "globalData specularCoeff must be a floating-point value" << std::endl;
-        return false;
-    }
-    if (globalData.contains("transparentCoeff")) {
-        if (globalData["transparentCoeff"].isDouble()) {
-            m_globalData.kt = globalData["transparentCoeff"].toDouble();
-        }
-        else {
-            std::cout << "globalData transparentCoeff must be a floating-point value" << std::endl;
+    float *coefficients[] = {&m_globalData.ka, &m_globalData.kd, &m_globalData.ks, &m_globalData.kt};
+    static_assert(std::size(coefficients) == globalDataFields.names.size());
+
+    json.beginObject();
+    FieldSet fields(globalDataFields);
+    std::string key;
+    while (json.nextKey(key)) {
+        int field = fields.accept(key);
+        double value;
+        if (field < 0 || !readNumber(json, "globalData", globalDataFields.names[field].data(), value)) {
             return false;
         }
+        *coefficients[field] = value;
     }
 
-    return true;
+    return !json.failed() && fields.complete();
 }
 
 /**
  * Parse a Light and add a new CS123SceneLightData to m_lights.
  */
-bool ScenefileReader::parseLightData(const QJsonObject &lightData, SceneNode *node) {
-    QStringList requiredFields = {"type", "color"};
-    QStringList optionalFields = {"name", "attenuationCoeff", "direction", "penumbra", "angle"};
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto &field : lightData.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on light object" << std::endl;
-            return false;
-        }
-    }
-    for (auto &field : requiredFields) {
-        if (!lightData.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on light object" << std::endl;
-            return false;
-        }
+bool ScenefileReader::parseLightData(JsonStream &json, SceneNode *node) {
+    if (json.peek() != JsonStream::Kind::Object) {
+        return wrongType(json, "light", "item", "of type object");
+    }
+
+    // Which of these apply depends on the type, which may come last
+    std::string lightType;
+    double color[3], attenuation[3], direction[3];
+    double penumbra = 0, angle = 0;
+
+    json.beginObject();
+    FieldSet fields(lightFields);
+    std::string key;
+    while (json.nextKey(key)) {
+        bool read = false;
+        switch (fields.accept(key)) {
+        case LightTypeField:
+            read = readString(json, "light", "type", lightType);
+            break;
+        case LightColor:
+            read = readVector(json, "light", "color", color, 3);
+            break;
+        case LightName:
+            read = json.skipValue();
+            break;
+        case LightAttenuationCoeff:
+            read = readVector(json, "light", "attenuationCoeff", attenuation, 3);
+            break;
+        case LightDirection:
+            read = readVector(json, "light", "direction", direction, 3);
+            break;
+        case LightPenumbra:
+            read = readNumber(json, "light", "penumbra", penumbra);
+            break;
+        case LightAngle:
+            read = readNumber(json, "light", "angle", angle);
+            break;
+        }
+        if (!read) {
+            return false;
+        }
+    }
+    if (json.failed() || !fields.complete()) {
+        return false;
     }
 
     // Create a default light
-    SceneLight *light = new SceneLight();
+    SceneLight *light = create<SceneLight>();
     memset(light, 0, sizeof(SceneLight));
     node->lights.push_back(light);
 
     light->dir = glm::vec4(0.f, 0.f, 0.f, 0.f);
     light->function = glm::vec3(1, 0, 0);
+    light->color = glm::vec4(color[0], color[1], color[2], 0.f);
 
-    // parse the color
-    if (!lightData["color"].isArray()) {
-        std::cout << "light color must be of type array" << std::endl;
-        return false;
-    }
-    QJsonArray colorArray = lightData["color"].toArray();
-    if (colorArray.size() != 3) {
-        std::cout << "light color must be of size 3" << std::endl;
-        return false;
-    }
-    if (!colorArray[0].isDouble() || !colorArray[1].isDouble() || !colorArray[2].isDouble()) {
-        std::cout << "light color must contain floating-point values" << std::endl;
-        return false;
-    }
-    light->color.r = colorArray[0].toDouble();
-    light->color.g = colorArray[1].toDouble();
-    light->color.b = colorArray[2].toDouble();
-
-    // parse the type
-    if (!lightData["type"].isString()) {
-        std::cout << "light type must be of type string" << std::endl;
-        return false;
-    }
-    std::string lightType = lightData["type"].toString().toStdString();
-
-    // parse directional light
     if (lightType == "directional") {
         light->type = LightType::LIGHT_DIRECTIONAL;
-
-        // parse direction
-        if (!lightData.contains("direction")) {
+        if (!fields.has(LightDirection)) {
             std::cout << "directional light must contain field \"direction\"" << std::endl;
             return false;
         }
-        if (!lightData["direction"].isArray()) {
-            std::cout << "directional light direction must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray directionArray = lightData["direction"].toArray();
-        if (directionArray.size() != 3) {
-            std::cout << "directional light direction must be of size 3" << std::endl;
-            return false;
-        }
-        if (!directionArray[0].isDouble() || !directionArray[1].isDouble() || !directionArray[2].isDouble()) {
-            std::cout << "directional light direction must contain floating-point values" << std::endl;
-            return false;
-        }
-        light->dir.x = directionArray[0].toDouble();
-        light->dir.y = directionArray[1].toDouble();
-        light->dir.z = directionArray[2].toDouble();
+        light->dir = glm::vec4(direction[0], direction[1], direction[2], 0.f);
     }
     else if (lightType == "point") {
         light->type = LightType::LIGHT_POINT;
-
-        // parse the attenuation coefficient
-        if (!lightData.contains("attenuationCoeff")) {
+        if (!fields.has(LightAttenuationCoeff)) {
             std::cout << "point light must contain field \"attenuationCoeff\"" << std::endl;
             return false;
         }
-        if (!lightData["attenuationCoeff"].isArray()) {
-            std::cout << "point light attenuationCoeff must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray attenuationArray = lightData["attenuationCoeff"].toArray();
-        if (attenuationArray.size() != 3) {
-            std::cout << "point light attenuationCoeff must be of size 3" << std::endl;
-            return false;
-        }
-        if (!attenuationArray[0].isDouble() || !attenuationArray[1].isDouble() || !attenuationArray[2].isDouble()) {
-            std::cout << "ppoint light attenuationCoeff must contain floating-point values" << std::endl;
-            return false;
-        }
-        light->function.x = attenuationArray[0].toDouble();
-        light->function.y = attenuationArray[1].toDouble();
-        light->function.z = attenuationArray[2].toDouble();
+        light->function = glm::vec3(attenuation[0], attenuation[1], attenuation[2]);
     }
     else if (lightType == "spot") {
-        QStringList pointRequiredFields = {"direction", "penumbra", "angle", "attenuationCoeff"};
-        for (auto &field : pointRequiredFields) {
-            if (!lightData.contains(field)) {
-                std::cout << "missing required field \"" << field.toStdString() << "\" on spotlight object" << std::endl;
+        for (LightField field : {LightDirection, LightPenumbra, LightAngle, LightAttenuationCoeff}) {
+            if (!fields.has(field)) {
+                std::cout << "missing required field \"" << lightFields.names[field] << "\" on spotlight object" << std::endl;
                 return false;
             }
         }
         light->type = LightType::LIGHT_SPOT;
-
-        // parse direction
-        if (!lightData["direction"].isArray()) {
-            std::cout << "spotlight direction must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray directionArray = lightData["direction"].toArray();
-        if (directionArray.size() != 3) {
-            std::cout << "spotlight direction must be of size 3" << std::endl;
-            return false;
-        }
-        if (!directionArray[0].isDouble() || !directionArray[1].isDouble() || !directionArray[2].isDouble()) {
-            std::cout << "spotlight direction must contain floating-point values" << std::endl;
-            return false;
-        }
-        light->dir.x = directionArray[0].toDouble();
-        light->dir.y = directionArray[1].toDouble();
-        light->dir.z = directionArray[2].toDouble();
-
-        // parse attenuation coefficient
-        if (!lightData["attenuationCoeff"].isArray()) {
-            std::cout << "spotlight attenuationCoeff must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray attenuationArray = lightData["attenuationCoeff"].toArray();
-        if (attenuationArray.size() != 3) {
-            std::cout << "spotlight attenuationCoeff must be of size 3" << std::endl;
-            return false;
-        }
-        if (!attenuationArray[0].isDouble() || !attenuationArray[1].isDouble() || !attenuationArray[2].isDouble()) {
-            std::cout << "spotlight direction must contain floating-point values" << std::endl;
-            return false;
-        }
-        light->function.x = attenuationArray[0].toDouble();
-        light->function.y = attenuationArray[1].toDouble();
-        light->function.z = attenuationArray[2].toDouble();
-
-        // parse penumbra
-        if (!lightData["penumbra"].isDouble()) {
-            std::cout << "spotlight penumbra must be of type float" << std::endl;
-            return false;
-        }
-        light->penumbra = lightData["penumbra"].toDouble() * M_PI / 180.f;
-
-        // parse angle
-        if (!lightData["angle"].isDouble()) {
-            std::cout << "spotlight angle must be of type float" << std::endl;
-            return false;
-        }
-        light->angle = lightData["angle"].toDouble() * M_PI / 180.f;
+        light->dir = glm::vec4(direction[0], direction[1], direction[2], 0.f);
+        light->function = glm::vec3(attenuation[0], attenuation[1], attenuation[2]);
+        light->penumbra = penumbra * M_PI / 180.f;
+        light->angle = angle * M_PI / 180.f;
     }
     else {
         std::cout << "unknown light type \"" << lightType << "\"" << std::endl;
@@ -374,464 +449,255 @@ bool ScenefileReader::parseLightData(const QJsonObject &lightData, SceneNode *no
 /**
  * Parse cameraData and fill in m_cameraData.
  */
-bool ScenefileReader::parseCameraData(const QJsonObject &cameradata) {
-    QStringList requiredFields = {"position", "up", "heightAngle"};
-    QStringList optionalFields = {"aperture", "focalLength", "look", "focus"};
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto &field : cameradata.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on cameraData object" << std::endl;
-            return false;
-        }
-    }
-    for (auto &field : requiredFields) {
-        if (!cameradata.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on cameraData object" << std::endl;
-            return false;
-        }
+bool ScenefileReader::parseCameraData(JsonStream &json) {
+    if (json.peek() != JsonStream::Kind::Object) {
+        return wrongType(json, "root", "cameraData", "of type object");
+    }
+
+    double position[3], up[3], look[3];
+    double heightAngle = 0, aperture = 0, focalLength = 0;
+
+    json.beginObject();
+    FieldSet fields(cameraFields);
+    std::string key;
+    while (json.nextKey(key)) {
+        bool read = false;
+        switch (fields.accept(key)) {
+        case CameraPosition:
+            read = readVector(json, "cameraData", "position", position, 3);
+            break;
+        case CameraUp:
+            read = readVector(json, "cameraData", "up", up, 3);
+            break;
+        case CameraHeightAngle:
+            read = readNumber(json, "cameraData", "heightAngle", heightAngle);
+            break;
+        case CameraAperture:
+            read = readNumber(json, "cameraData", "aperture", aperture);
+            break;
+        case CameraFocalLength:
+            read = readNumber(json, "cameraData", "focalLength", focalLength);
+            break;
+        case CameraLook:
+            read = readVector(json, "cameraData", "look", look, 3);
+            break;
+        case CameraFocus:
+            read = readVector(json, "cameraData", "focus", look, 3);
+            break;
+        }
+        if (!read) {
+            return false;
+        }
+    }
+    if (json.failed() || !fields.complete()) {
+        return false;
     }
 
     // Must have either look or focus, but not both
-    if (cameradata.contains("look") && cameradata.contains("focus")) {
+    if (fields.has(CameraLook) && fields.has(CameraFocus)) {
         std::cout << "cameraData cannot contain both \"look\" and \"focus\"" << std::endl;
         return false;
     }
 
-    // Parse the camera data
-    if (cameradata["position"].isArray()) {
-        QJsonArray position = cameradata["position"].toArray();
-        if (position.size() != 3) {
-            std::cout << "cameraData position must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!position[0].isDouble() || !position[1].isDouble() || !position[2].isDouble()) {
-            std::cout << "cameraData position must be a floating-point value" << std::endl;
-            return false;
-        }
-        m_cameraData.pos.x = position[0].toDouble();
-        m_cameraData.pos.y = position[1].toDouble();
-        m_cameraData.pos.z = position[2].toDouble();
-        m_cameraData.pos.w = 1.f;
-    }
-    else {
-        std::cout << "cameraData position must be an array" << std::endl;
-        return false;
-    }
+    m_cameraData.pos = glm::vec4(position[0], position[1], position[2], 1.f);
+    m_cameraData.up = glm::vec4(up[0], up[1], up[2], 0.f);
+    m_cameraData.heightAngle = heightAngle * M_PI / 180.f;
+    m_cameraData.aperture = aperture;
+    m_cameraData.focalLength = focalLength;
 
-    if (cameradata["up"].isArray()) {
-        QJsonArray up = cameradata["up"].toArray();
-        if (up.size() != 3) {
-            std::cout << "cameraData up must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!up[0].isDouble() || !up[1].isDouble() || !up[2].isDouble()) {
-            std::cout << "cameraData up must be a floating-point value" << std::endl;
-            return false;
-        }
-        m_cameraData.up.x = up[0].toDouble();
-        m_cameraData.up.y = up[1].toDouble();
-        m_cameraData.up.z = up[2].toDouble();
-        m_cameraData.up.w = 0.f;
+    // Convert the focus point into a look vector from the camera position to that focus point
+    if (fields.has(CameraLook)) {
+        m_cameraData.look = glm::vec4(look[0], look[1], look[2], 0.f);
     }
-    else {
-        std::cout << "cameraData up must be an array" << std::endl;
-        return false;
-    }
-
-    if (cameradata["heightAngle"].isDouble()) {
-        m_cameraData.heightAngle = cameradata["heightAngle"].toDouble() * M_PI / 180.f;
-    }
-    else {
-        std::cout << "cameraData heightAngle must be a floating-point value" << std::endl;
-        return false;
-    }
-
-    if (cameradata.contains("aperture")) {
-        if (cameradata["aperture"].isDouble()) {
-            m_cameraData.aperture = cameradata["aperture"].toDouble();
-        }
-        else {
-            std::cout << "cameraData aperture must be a floating-point value" << std::endl;
-            return false;
-        }
-    }
-
-    if (cameradata.contains("focalLength")) {
-        if (cameradata["focalLength"].isDouble()) {
-            m_cameraData.focalLength = cameradata["focalLength"].toDouble();
-        }
-        else {
-            std::cout << "cameraData focalLength must be a floating-point value" << std::endl;
-            return false;
-        }
-    }
-
-    // Parse the look or focus
-    // if the focus is specified, we will convert it to a look vector later
-    if (cameradata.contains("look")) {
-        if (cameradata["look"].isArray()) {
-            QJsonArray look = cameradata["look"].toArray();
-            if (look.size() != 3) {
-                std::cout << "cameraData look must have 3 elements" << std::endl;
-                return false;
-            }
-            if (!look[0].isDouble() || !look[1].isDouble() || !look[2].isDouble()) {
-                std::cout << "cameraData look must be a floating-point value" << std::endl;
-                return false;
-            }
-            m_cameraData.look.x = look[0].toDouble();
-            m_cameraData.look.y = look[1].toDouble();
-            m_cameraData.look.z = look[2].toDouble();
-            m_cameraData.look.w = 0.f;
-        }
-        else {
-            std::cout << "cameraData look must be an array" << std::endl;
-            return false;
-        }
-    }
-    else if (cameradata.contains("focus")) {
-        if (cameradata["focus"].isArray()) {
-            QJsonArray focus = cameradata["focus"].toArray();
-            if (focus.size() != 3) {
-                std::cout << "cameraData focus must have 3 elements" << std::endl;
-                return false;
-            }
-            if (!focus[0].isDouble() || !focus[1].isDouble() || !focus[2].isDouble()) {
-                std::cout << "cameraData focus must be a floating-point value" << std::endl;
-                return false;
-            }
-            m_cameraData.look.x = focus[0].toDouble();
-            m_cameraData.look.y = focus[1].toDouble();
-            m_cameraData.look.z = focus[2].toDouble();
-            m_cameraData.look.w = 1.f;
-        }
-        else {
-            std::cout << "cameraData focus must be an array" << std::endl;
-            return false;
-        }
-    }
-
-    // Convert the focus point (stored in the look vector) into a
-    // look vector from the camera position to that focus point.
-    if (cameradata.contains("focus")) {
-        m_cameraData.look -= m_cameraData.pos;
+    else if (fields.has(CameraFocus)) {
+        m_cameraData.look = glm::vec4(look[0], look[1], look[2], 1.f) - m_cameraData.pos;
     }
 
     return true;
 }
 
-bool ScenefileReader::parseTemplateGroups(const QJsonValue &templateGroups) {
-    if (!templateGroups.isArray()) {
-        std::cout << "templateGroups must be an array" << std::endl;
-        return false;
+bool ScenefileReader::parseTemplateGroups(JsonStream &json) {
+    if (json.peek() != JsonStream::Kind::Array) {
+        return wrongType(json, "root", "templateGroups", "an array");
     }
 
-    QJsonArray templateGroupsArray = templateGroups.toArray();
-    for (auto templateGroup : templateGroupsArray) {
-        if (!templateGroup.isObject()) {
-            std::cout << "templateGroup items must be of type object" << std::endl;
-            return false;
-        }
-
-        if (!parseTemplateGroupData(templateGroup.toObject())) {
+    json.beginArray();
+    while (json.nextElement()) {
+        if (!parseTemplateGroupData(json)) {
             return false;
         }
     }
 
-    return true;
+    return !json.failed();
 }
 
-bool ScenefileReader::parseTemplateGroupData(const QJsonObject &templateGroup) {
-    QStringList requiredFields = {"name"};
-    QStringList optionalFields = {"translate", "rotate", "scale", "matrix", "lights", "primitives", "groups"};
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto &field : templateGroup.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on templateGroup object" << std::endl;
-            return false;
-        }
+bool ScenefileReader::parseTemplateGroupData(JsonStream &json) {
+    if (json.peek() != JsonStream::Kind::Object) {
+        return wrongType(json, "templateGroup", "items", "of type object");
     }
 
-    for (auto &field : requiredFields) {
-        if (!templateGroup.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on templateGroup object" << std::endl;
-            return false;
-        }
+    // Registered only once complete, so a template can use earlier templates but never itself
+    SceneNode *templateNode = create<SceneNode>(&m_arena);
+    std::optional<std::string> name;
+    if (!parseGroupData(json, templateNode, "templateGroup", name, true)) {
+        return false;
     }
-
-    if (!templateGroup["name"].isString()) {
-        std::cout << "templateGroup name must be a string" << std::endl;
+    if (!name) {
+        std::cout << "missing required field \"name\" on templateGroup object" << std::endl;
+        return false;
     }
-    if (m_templates.contains(templateGroup["name"].toString().toStdString())) {
+    if (m_templates.contains(*name)) {
         std::cout << "templateGroups cannot have the same" << std::endl;
     }
+    m_templates[*name] = templateNode;
 
-    SceneNode *templateNode = new SceneNode;
-    m_nodes.push_back(templateNode);
-    m_templates[templateGroup["name"].toString().toStdString()] = templateNode;
-
-    return parseGroupData(templateGroup, templateNode);
+    return true;
 }
 
 /**
- * Parse a group object and create a new CS123SceneNode in m_nodes.
- * NAME OF NODE CANNOT REFERENCE TEMPLATE NODE
+ * Parse a group object into node, creating its children in the arena as they arrive.
+ * Transformations are applied in the order translate, rotate, scale, matrix, whatever the order of the keys.
  */
-bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node) {
-    QStringList optionalFields = {"name", "translate", "rotate", "scale", "matrix", "lights", "primitives", "groups"};
-    QStringList allFields = optionalFields;
-    for (auto &field : object.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on group object" << std::endl;
-            return false;
-        }
-    }
-
-    // parse translation if defined
-    if (object.contains("translate")) {
-        if (!object["translate"].isArray()) {
-            std::cout << "group translate must be of type array" << std::endl;
-            return false;
-        }
-
-        QJsonArray translateArray = object["translate"].toArray();
-        if (translateArray.size() != 3) {
-            std::cout << "group translate must have 3 elements" << std::endl;
-            return false;
+bool ScenefileReader::parseGroupData(JsonStream &json, SceneNode *node, const char *objectName, std::optional<std::string> &name, bool inTemplate) {
+    double translate[3], rotate[4], scale[3];
+    glm::mat4 matrix;
+
+    json.beginObject();
+    FieldSet fields(std::strcmp(objectName, "templateGroup") == 0 ? templateGroupFields : groupFields);
+    std::string key;
+    while (json.nextKey(key)) {
+        bool read = false;
+        switch (fields.accept(key)) {
+        case GroupName:
+            read = readString(json, objectName, "name", name.emplace());
+            break;
+        case GroupTranslate:
+            read = readVector(json, objectName, "translate", translate, 3);
+            break;
+        case GroupRotate:
+            read = readVector(json, objectName, "rotate", rotate, 4);
+            break;
+        case GroupScale:
+            read = readVector(json, objectName, "scale", scale, 3);
+            break;
+        case GroupMatrix:
+            read = readMatrix(json, glm::value_ptr(matrix));
+            break;
+        case GroupLights:
+            if (json.peek() != JsonStream::Kind::Array) {
+                return wrongType(json, objectName, "lights", "of type array");
+            }
+            json.beginArray();
+            while (json.nextElement()) {
+                if (!parseLightData(json, node)) {
+                    return false;
+                }
+            }
+            read = !json.failed();
+            break;
+        case GroupPrimitives:
+            if (json.peek() != JsonStream::Kind::Array) {
+                return wrongType(json, objectName, "primitives", "of type array");
+            }
+            json.beginArray();
+            while (json.nextElement()) {
+                if (!parsePrimitive(json, node)) {
+                    return false;
+                }
+            }
+            read = !json.failed();
+            break;
+        case GroupGroups:
+            read = parseGroups(json, node, inTemplate);
+            break;
         }
-        if (!translateArray[0].isDouble() || !translateArray[1].isDouble() || !translateArray[2].isDouble()) {
-            std::cout << "group translate must contain floating-point values" << std::endl;
+        if (!read) {
             return false;
         }
+    }
+    if (json.failed()) {
+        return false;
+    }
 
-        SceneTransformation *translation = new SceneTransformation();
+    if (fields.has(GroupTranslate)) {
+        SceneTransformation *translation = create<SceneTransformation>();
         translation->type = TransformationType::TRANSFORMATION_TRANSLATE;
-        translation->translate.x = translateArray[0].toDouble();
-        translation->translate.y = translateArray[1].toDouble();
-        translation->translate.z = translateArray[2].toDouble();
-
+        translation->translate = glm::vec3(translate[0], translate[1], translate[2]);
         node->transformations.push_back(translation);
     }
 
-    // parse rotation if defined
-    if (object.contains("rotate")) {
-        if (!object["rotate"].isArray()) {
-            std::cout << "group rotate must be of type array" << std::endl;
-            return false;
-        }
-
-        QJsonArray rotateArray = object["rotate"].toArray();
-        if (rotateArray.size() != 4) {
-            std::cout << "group rotate must have 4 elements" << std::endl;
-            return false;
-        }
-        if (!rotateArray[0].isDouble() || !rotateArray[1].isDouble() || !rotateArray[2].isDouble() || !rotateArray[3].isDouble()) {
-            std::cout << "group rotate must contain floating-point values" << std::endl;
-            return false;
-        }
-
-        SceneTransformation *rotation = new SceneTransformation();
+    if (fields.has(GroupRotate)) {
+        SceneTransformation *rotation = create<SceneTransformation>();
         rotation->type = TransformationType::TRANSFORMATION_ROTATE;
-        rotation->rotate.x = rotateArray[0].toDouble();
-        rotation->rotate.y = rotateArray[1].toDouble();
-        rotation->rotate.z = rotateArray[2].toDouble();
-        rotation->angle = rotateArray[3].toDouble() * M_PI / 180.f;
-
+        rotation->rotate = glm::vec3(rotate[0], rotate[1], rotate[2]);
+        rotation->angle = rotate[3] * M_PI / 180.f;
         node->transformations.push_back(rotation);
     }
 
-    // parse scale if defined
-    if (object.contains("scale")) {
-        if (!object["scale"].isArray()) {
-            std::cout << "group scale must be of type array" << std::endl;
-            return false;
-        }
-
-        QJsonArray scaleArray = object["scale"].toArray();
-        if (scaleArray.size() != 3) {
-            std::cout << "group scale must have 3 elements" << std::endl;
-            return false;
-        }
-        if (!scaleArray[0].isDouble() || !scaleArray[1].isDouble() || !scaleArray[2].isDouble()) {
-            std::cout << "group scale must contain floating-point values" << std::endl;
-            return false;
-        }
-
-        SceneTransformation *scale = new SceneTransformation();
-        scale->type = TransformationType::TRANSFORMATION_SCALE;
-        scale->scale.x = scaleArray[0].toDouble();
-        scale->scale.y = scaleArray[1].toDouble();
-        scale->scale.z = scaleArray[2].toDouble();
-
-        node->transformations.push_back(scale);
+    if (fields.has(GroupScale)) {
+        SceneTransformation *scaling = create<SceneTransformation>();
+        scaling->type = TransformationType::TRANSFORMATION_SCALE;
+        scaling->scale = glm::vec3(scale[0], scale[1], scale[2]);
+        node->transformations.push_back(scaling);
     }
 
-    // parse matrix if defined
-    if (object.contains("matrix")) {
-        if (!object["matrix"].isArray()) {
-            std::cout << "group matrix must be of type array of array" << std::endl;
-            return false;
-        }
-
-        QJsonArray matrixArray = object["matrix"].toArray();
-        if (matrixArray.size() != 4) {
-            std::cout << "group matrix must be 4x4" << std::endl;
-            return false;
-        }
-
-        SceneTransformation *matrixTransformation = new SceneTransformation();
+    if (fields.has(GroupMatrix)) {
+        SceneTransformation *matrixTransformation = create<SceneTransformation>();
         matrixTransformation->type = TransformationType::TRANSFORMATION_MATRIX;
-
-        float *matrixPtr = glm::value_ptr(matrixTransformation->matrix);
-        int rowIndex = 0;
-        for (auto row : matrixArray) {
-            if (!row.isArray()) {
-                std::cout << "group matrix must be of type array of array" << std::endl;
-                return false;
-            }
-
-            QJsonArray rowArray = row.toArray();
-            if (rowArray.size() != 4) {
-                std::cout << "group matrix must be 4x4" << std::endl;
-                return false;
-            }
-
-            int colIndex = 0;
-            for (auto val : rowArray) {
-                if (!val.isDouble()) {
-                    std::cout << "group matrix must contain all floating-point values" << std::endl;
-                    return false;
-                }
-
-                // fill in column-wise
-                matrixPtr[colIndex * 4 + rowIndex] = (float)val.toDouble();
-                colIndex++;
-            }
-            rowIndex++;
-        }
-
+        matrixTransformation->matrix = matrix;
         node->transformations.push_back(matrixTransformation);
     }
 
-    // parse lights if any
-    if (object.contains("lights")) {
-        if (!object["lights"].isArray()) {
-            std::cout << "group lights must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray lightsArray = object["lights"].toArray();
-        for (auto light : lightsArray) {
-            if (!light.isObject()) {
-                std::cout << "light must be of type object" << std::endl;
-                return false;
-            }
+    return true;
+}
 
-            if (!parseLightData(light.toObject(), node)) {
-                return false;
-            }
-        }
+bool ScenefileReader::parseGroups(JsonStream &json, SceneNode *parent, bool inTemplate) {
+    if (json.peek() != JsonStream::Kind::Array) {
+        return wrongType(json, "group", "groups", "of type array");
     }
 
-    // parse primitives if any
-    if (object.contains("primitives")) {
-        if (!object["primitives"].isArray()) {
-            std::cout << "group primitives must be of type array" << std::endl;
-            return false;
+    json.beginArray();
+    while (json.nextElement()) {
+        if (json.peek() != JsonStream::Kind::Object) {
+            return wrongType(json, "group", "items", "of type object");
         }
-        QJsonArray primitivesArray = object["primitives"].toArray();
-        for (auto primitive : primitivesArray) {
-            if (!primitive.isObject()) {
-                std::cout << "primitive must be of type object" << std::endl;
-                return false;
-            }
 
-            if (!parsePrimitive(primitive.toObject(), node)) {
-                return false;
-            }
-        }
-    }
-
-    // parse children groups if any
-    if (object.contains("groups")) {
-        if (!parseGroups(object["groups"], node)) {
-            return false;
-        }
-    }
-
-    return true;
-}
-
-bool ScenefileReader::parseGroups(const QJsonValue &groups, SceneNode *parent) {
-    if (!groups.isArray()) {
-        std::cout << "groups must be of type array" << std::endl;
-        return false;
-    }
+        SceneNode *node = create<SceneNode>(&m_arena);
+        parent->children.push_back(node);
+        size_t child = parent->children.size() - 1;
 
-    QJsonArray groupsArray = groups.toArray();
-    for (auto group : groupsArray) {
-        if (!group.isObject()) {
-            std::cout << "group items must be of type object" << std::endl;
+        std::optional<std::string> name;
+        if (!parseGroupData(json, node, "group", name, inTemplate)) {
             return false;
         }
 
-        QJsonObject groupData = group.toObject();
-        if (groupData.contains("name")) {
-            if (!groupData["name"].isString()) {
-                std::cout << "group name must be of type string" << std::endl;
-                return false;
+        // A group named after a template is a reference to it. Inside a template only the templates
+        // already read count, which keeps references acyclic; the main tree sees every template, so
+        // until templateGroups has gone by its names wait for the end of the file.
+        if (name) {
+            if (!inTemplate && !m_templatesRead) {
+                m_templateReferences.push_back({parent, child, std::move(*name)});
             }
-
-            // if its a reference to a template group append it
-            std::string groupName = groupData["name"].toString().toStdString();
-            if (m_templates.contains(groupName)) {
-                parent->children.push_back(m_templates[groupName]);
-                continue;
+            else if (auto found = m_templates.find(*name); found != m_templates.end()) {
+                parent->children[child] = found->second;
             }
         }
-
-        SceneNode *node = new SceneNode;
-        m_nodes.push_back(node);
-        parent->children.push_back(node);
-
-        if (!parseGroupData(group.toObject(), node)) {
-            return false;
-        }
     }
 
-    return true;
+    return !json.failed();
 }
 
 /**
- * Parse an <object type="primitive"> tag into node.
+ * Parse a primitive object into node.
  */
-bool ScenefileReader::parsePrimitive(const QJsonObject &prim, SceneNode *node) {
-    QStringList requiredFields = {"type"};
-    QStringList optionalFields = {
-        "meshFile", "ambient", "diffuse", "specular", "reflective", "transparent", "shininess", "ior",
-        "blend", "textureFile", "textureU", "textureV", "bumpMapFile", "bumpMapU", "bumpMapV"};
-
-    QStringList allFields = requiredFields + optionalFields;
-    for (auto field : prim.keys()) {
-        if (!allFields.contains(field)) {
-            std::cout << "unknown field \"" << field.toStdString() << "\" on primitive object" << std::endl;
-            return false;
-        }
-    }
-    for (auto field : requiredFields) {
-        if (!prim.contains(field)) {
-            std::cout << "missing required field \"" << field.toStdString() << "\" on primitive object" << std::endl;
-            return false;
-        }
+bool ScenefileReader::parsePrimitive(JsonStream &json, SceneNode *node) {
+    if (json.peek() != JsonStream::Kind::Object) {
+        return wrongType(json, "primitive", "item", "of type object");
     }
 
-    if (!prim["type"].isString()) {
-        std::cout << "primitive type must be of type string" << std::endl;
-        return false;
-    }
-    std::string primType = prim["type"].toString().toStdString();
-
     // Default primitive
-    ScenePrimitive *primitive = new ScenePrimitive();
+    ScenePrimitive *primitive = create<ScenePrimitive>();
+    m_primitives.push_back(primitive);
     SceneMaterial &mat = primitive->material;
     mat.clear();
     primitive->type = PrimitiveType::PRIMITIVE_CUBE;
@@ -840,7 +706,88 @@ bool ScenefileReader::parsePrimitive(const QJsonObject &prim, SceneNode *node) {
     mat.cDiffuse.r = mat.cDiffuse.g = mat.cDiffuse.b = 1;
     node->primitives.push_back(primitive);
 
-    std::filesystem::path basepath = std::filesystem::path(file_name).parent_path().parent_path();
+    // Paths and repeats only make sense once the whole object is known
+    std::string primType, meshFile, textureFile, bumpMapFile;
+    double textureU = 1, textureV = 1, bumpMapU = 1, bumpMapV = 1;
+
+    // Repeats that aren't numbers fall back to 1
+    auto readRepeat = [&json](double &repeat) {
+        return json.peek() == JsonStream::Kind::Number ? json.readNumber(repeat) : json.skipValue();
+    };
+
+    json.beginObject();
+    FieldSet fields(primitiveFields);
+    std::string key;
+    while (json.nextKey(key)) {
+        bool read = false;
+        double color[3] = {};
+        double value = 0;
+        switch (fields.accept(key)) {
+        case PrimitiveTypeField:
+            read = readString(json, "primitive", "type", primType);
+            break;
+        case PrimitiveMeshFile:
+            read = readString(json, "primitive", "meshFile", meshFile);
+            break;
+        case PrimitiveAmbient:
+            read = readVector(json, "primitive", "ambient", color, 3);
+            mat.cAmbient = glm::vec4(color[0], color[1], color[2], mat.cAmbient.a);
+            break;
+        case PrimitiveDiffuse:
+            read = readVector(json, "primitive", "diffuse", color, 3);
+            mat.cDiffuse = glm::vec4(color[0], color[1], color[2], mat.cDiffuse.a);
+            break;
+        case PrimitiveSpecular:
+            read = readVector(json, "primitive", "specular", color, 3);
+            mat.cSpecular = glm::vec4(color[0], color[1], color[2], mat.cSpecular.a);
+            break;
+        case PrimitiveReflective:
+            read = readVector(json, "primitive", "reflective", color, 3);
+            mat.cReflective = glm::vec4(color[0], color[1], color[2], mat.cReflective.a);
+            break;
+        case PrimitiveTransparent:
+            read = readVector(json, "primitive", "transparent", color, 3);
+            mat.cTransparent = glm::vec4(color[0], color[1], color[2], mat.cTransparent.a);
+            break;
+        case PrimitiveShininess:
+            read = readNumber(json, "primitive", "shininess", value);
+            mat.shininess = float(value);
+            break;
+        case PrimitiveIor:
+            read = readNumber(json, "primitive", "ior", value);
+            mat.ior = float(value);
+            break;
+        case PrimitiveBlend:
+            read = readNumber(json, "primitive", "blend", value);
+            mat.blend = float(value);
+            break;
+        case PrimitiveTextureFile:
+            read = readString(json, "primitive", "textureFile", textureFile);
+            break;
+        case PrimitiveBumpMapFile:
+            read = readString(json, "primitive", "bumpMapFile", bumpMapFile);
+            break;
+        case PrimitiveTextureU:
+            read = readRepeat(textureU);
+            break;
+        case PrimitiveTextureV:
+            read = readRepeat(textureV);
+            break;
+        case PrimitiveBumpMapU:
+            read = readRepeat(bumpMapU);
+            break;
+        case PrimitiveBumpMapV:
+            read = readRepeat(bumpMapV);
+            break;
+        }
+        if (!read) {
+            return false;
+        }
+    }
+    if (json.failed() || !fields.complete()) {
+        return false;
+    }
+
     if (primType == "sphere")
         primitive->type = PrimitiveType::PRIMITIVE_SPHERE;
     else if (primType == "cube")
@@ -851,178 +798,28 @@ bool ScenefileReader::parsePrimitive(const QJsonObject &prim, SceneNode *node) {
         primitive->type = PrimitiveType::PRIMITIVE_CONE;
     else if (primType == "mesh") {
         primitive->type = PrimitiveType::PRIMITIVE_MESH;
-        if (!prim.contains("meshFile")) {
+        if (!fields.has(PrimitiveMeshFile)) {
             std::cout << "primitive type mesh must contain field meshFile" << std::endl;
             return false;
         }
-        if (!prim["meshFile"].isString()) {
-            std::cout << "primitive meshFile must be of type string" << std::endl;
-            return false;
-        }
-
-        std::filesystem::path relativePath(prim["meshFile"].toString().toStdString());
-        primitive->meshfile = (basepath / relativePath).string();
+        primitive->meshfile = (m_basePath / std::filesystem::path(meshFile)).string();
     }
     else {
         std::cout << "unknown primitive type \"" << primType << "\"" << std::endl;
         return false;
     }
 
-    if (prim.contains("ambient")) {
-        if (!prim["ambient"].isArray()) {
-            std::cout << "primitive ambient must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray ambientArray = prim["ambient"].toArray();
-        if (ambientArray.size() != 3) {
-            std::cout << "primitive ambient array must be of size 3" << std::endl;
-            return false;
-        }
-
-        for (int i = 0; i < 3; i++) {
-            if (!ambientArray[i].isDouble()) {
-                std::cout << "primitive ambient must contain floating-point values" << std::endl;
-                return false;
-            }
-
-            mat.cAmbient[i] = ambientArray[i].toDouble();
-        }
-    }
-
-    if (prim.contains("diffuse")) {
-        if (!prim["diffuse"].isArray()) {
-            std::cout << "primitive diffuse must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray diffuseArray = prim["diffuse"].toArray();
-        if (diffuseArray.size() != 3) {
-            std::cout << "primitive diffuse array must be of size 3" << std::endl;
-            return false;
-        }
-
-        for (int i = 0; i < 3; i++) {
-            if (!diffuseArray[i].isDouble()) {
-                std::cout << "primitive diffuse must contain floating-point values" << std::endl;
-                return false;
-            }
-
-            mat.cDiffuse[i] = diffuseArray[i].toDouble();
-        }
-    }
-
-    if (prim.contains("specular")) {
-        if (!prim["specular"].isArray()) {
-            std::cout << "primitive specular must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray specularArray = prim["specular"].toArray();
-        if (specularArray.size() != 3) {
-            std::cout << "primitive specular array must be of size 3" << std::endl;
-            return false;
-        }
-
-        for (int i = 0; i < 3; i++) {
-            if (!specularArray[i].isDouble()) {
-                std::cout << "primitive specular must contain floating-point values" << std::endl;
-                return false;
-            }
-
-            mat.cSpecular[i] = specularArray[i].toDouble();
-        }
-    }
-
-    if (prim.contains("reflective")) {
-        if (!prim["reflective"].isArray()) {
-            std::cout << "primitive reflective must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray reflectiveArray = prim["reflective"].toArray();
-        if (reflectiveArray.size() != 3) {
-            std::cout << "primitive reflective array must be of size 3" << std::endl;
-            return false;
-        }
-
-        for (int i = 0; i < 3; i++) {
-            if (!reflectiveArray[i].isDouble()) {
-                std::cout << "primitive reflective must contain floating-point values" << std::endl;
-                return false;
-            }
-
-            mat.cReflective[i] = reflectiveArray[i].toDouble();
-        }
-    }
-
-    if (prim.contains("transparent")) {
-        if (!prim["transparent"].isArray()) {
-            std::cout << "primitive transparent must be of type array" << std::endl;
-            return false;
-        }
-        QJsonArray transparentArray = prim["transparent"].toArray();
-        if (transparentArray.size() != 3) {
-            std::cout << "primitive transparent array must be of size 3" << std::endl;
-            return false;
-        }
-
-        for (int i = 0; i < 3; i++) {
-            if (!transparentArray[i].isDouble()) {
-                std::cout << "primitive transparent must contain floating-point values" << std::endl;
-                return false;
-            }
-
-            mat.cTransparent[i] = transparentArray[i].toDouble();
-        }
-    }
-
-    if (prim.contains("shininess")) {
-        if (!prim["shininess"].isDouble()) {
-            std::cout << "primitive shininess must be of type float" << std::endl;
-            return false;
-        }
-
-        mat.shininess = (float) prim["shininess"].toDouble();
-    }
-
-    if (prim.contains("ior")) {
-        if (!prim["ior"].isDouble()) {
-            std::cout << "primitive ior must be of type float" << std::endl;
-            return false;
-        }
-
-        mat.ior = (float) prim["ior"].toDouble();
-    }
-
-    if (prim.contains("blend")) {
-        if (!prim["blend"].isDouble()) {
-            std::cout << "primitive blend must be of type float" << std::endl;
-            return false;
-        }
-
-        mat.blend = (float)prim["blend"].toDouble();
-    }
-
-    if (prim.contains("textureFile")) {
-        if (!prim["textureFile"].isString()) {
-            std::cout << "primitive textureFile must be of type string" << std::endl;
-            return false;
-        }
-        std::filesystem::path fileRelativePath(prim["textureFile"].toString().toStdString());
-
-        mat.textureMap.filename = (basepath / fileRelativePath).string();
-        mat.textureMap.repeatU = prim.contains("textureU") && prim["textureU"].isDouble() ? prim["textureU"].toDouble() : 1;
-        mat.textureMap.repeatV = prim.contains("textureV") && prim["textureV"].isDouble() ? prim["textureV"].toDouble() : 1;
+    if (fields.has(PrimitiveTextureFile)) {
+        mat.textureMap.filename = (m_basePath / std::filesystem::path(textureFile)).string();
+        mat.textureMap.repeatU = textureU;
+        mat.textureMap.repeatV = textureV;
         mat.textureMap.isUsed = true;
     }
 
-    if (prim.contains("bumpMapFile")) {
-        if (!prim["bumpMapFile"].isString()) {
-            std::cout << "primitive bumpMapFile must be of type string" << std::endl;
-            return false;
-        }
-        std::filesystem::path fileRelativePath(prim["bumpMapFile"].toString().toStdString());
-
-        mat.bumpMap.filename = (basepath / fileRelativePath).string();
-        mat.bumpMap.repeatU = prim.contains("bumpMapU") && prim["bumpMapU"].isDouble() ? prim["bumpMapU"].toDouble() : 1;
-        mat.bumpMap.repeatV = prim.contains("bumpMapV") && prim["bumpMapV"].isDouble() ? prim["bumpMapV"].toDouble() : 1;
+    if (fields.has(PrimitiveBumpMapFile)) {
+        mat.bumpMap.filename = (m_basePath / std::filesystem::path(bumpMapFile)).string();
+        mat.bumpMap.repeatU = bumpMapU;
+        mat.bumpMap.repeatV = bumpMapV;
         mat.bumpMap.isUsed = true;
     }
 
@@ -1,12 +1,16 @@
 #pragma once
 
 #include "scenedata.h"
+#include "jsonstream.h"
 
-#include <vector>
+#include <filesystem>
 #include <map>
-
-#include <QJsonDocument>
-#include <QJsonObject>
+#include <memory_resource>
+#include <new>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
 
 // This class parses the scene graph specified by the CS123 Xml file format.
 class ScenefileReader {
@@ -14,9 +18,12 @@ public:
     // Create a ScenefileReader, passing it the scene file.
     ScenefileReader(const std::string &filename);
 
-    // Clean up all data for the scene
+    // Clean up all data for the scene; the scene graph goes away with the arena in one release
     ~ScenefileReader();
 
+    ScenefileReader(const ScenefileReader &) = delete;
+    ScenefileReader &operator=(const ScenefileReader &) = delete;
+
     // Parse the XML scene file. Returns false if scene is invalid.
     bool readJSON();
 
@@ -29,22 +36,47 @@ public:
 private:
     // The filename should be contained within this parser implementation.
     // If you want to parse a new file, instantiate a different parser.
-    bool parseGlobalData(const QJsonObject &globaldata);
-    bool parseCameraData(const QJsonObject &cameradata);
-    bool parseTemplateGroups(const QJsonValue &templateGroups);
-    bool parseTemplateGroupData(const QJsonObject &templateGroup);
-    bool parseGroups(const QJsonValue &groups, SceneNode *parent);
-    bool parseGroupData(const QJsonObject &object, SceneNode *node);
-    bool parsePrimitive(const QJsonObject &prim, SceneNode *node);
-    bool parseLightData(const QJsonObject &lightData, SceneNode *node);
+    //
+    // Each one reads a single value from the stream, building scene objects as fields arrive and
+    // checking the cross-field rules once the object closes
+    bool parseSceneFile(JsonStream &json);
+    bool parseGlobalData(JsonStream &json);
+    bool parseCameraData(JsonStream &json);
+    bool parseTemplateGroups(JsonStream &json);
+    bool parseTemplateGroupData(JsonStream &json);
+    bool parseGroups(JsonStream &json, SceneNode *parent, bool inTemplate);
+    bool parseGroupData(JsonStream &json, SceneNode *node, const char *objectName, std::optional<std::string> &name, bool inTemplate);
+    bool parsePrimitive(JsonStream &json, SceneNode *node);
+    bool parseLightData(JsonStream &json, SceneNode *node);
+
+    // A named group in the main tree. Templates may come later in the file than the groups that
+    // use them, so these are matched against the templates once the whole file has been read.
+    struct TemplateReference {
+        SceneNode *parent;
+        size_t child;
+        std::string name;
+    };
+
+    // Constructs a scene graph object in the arena
+    template <typename T, typename... Args>
+    T *create(Args &&...args) {
+        return new (m_arena.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
 
     std::string file_name;
+    std::filesystem::path m_basePath;
+
+    // Every node, transformation, primitive and light, and every node's lists, are bump-allocated
+    // from here: parsing allocates a few geometrically growing blocks and teardown frees them at once
+    std::pmr::monotonic_buffer_resource m_arena;
+    std::pmr::vector<ScenePrimitive *> m_primitives; // Their strings own heap memory, so they are destroyed explicitly
 
     mutable std::map<std::string, SceneNode *> m_templates;
+    std::vector<TemplateReference> m_templateReferences;
+    bool m_templatesRead = false;
 
     SceneGlobalData m_globalData;
     SceneCameraData m_cameraData;
 
     SceneNode *m_root;
-    std::vector<SceneNode *> m_nodes;
 };